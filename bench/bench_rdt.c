@@ -0,0 +1,393 @@
+// Suíte de benchmarks do RDT em loopback: o servidor (rdt_server_run) e o remetente (o mesmo
+// caminho de client_rdt) rodam no mesmo processo, ligados pelo proxy de impair.c, que
+// emula os cenários do README (banda de ida e volta, perda, atraso). Cada cenário é repetido
+// em cada modo de janela e timeout; a saída tem uma linha JSON por combinação, com goodput,
+// razão de retransmissão e os percentis 50 e 99 do tempo de conclusão.
+// Compilação: make bench (ou gcc -O2 -pthread -I. bench/bench_rdt.c bench/impair.c rdt.c rdt_cc.c rdt_uring.c rdt_fec.c rdt_log.c rdt_resume.c rdt_compress.c rdt_delta.c rdt_server.c -lm -o bench_rdt)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+#include "rdt.h"
+#include "rdt_cc.h"
+#include "rdt_compress.h"
+#include "rdt_server.h"
+#include "impair.h"
+
+#define DEFAULT_PORT    47100       // Porta do servidor
+#define DEFAULT_RUNS    5           // Execuções por combinação
+#define DEFAULT_BYTES   (256 << 10) // Tamanho do arquivo transferido
+#define DEFAULT_SCALE   1000        // Multiplicador das bandas do README (Kbps → Mbps)
+#define DEFAULT_LOSS    0.03        // Perda dos cenários do README
+#define DEFAULT_DELAY   0.01        // Atraso de cada sentido (s)
+#define MAX_RUNS        1000
+#define BENCH_FILE      "bench.bin" // Nome do arquivo no PKT_START (gravado em receive/)
+
+// Cenários do README: bandas de ida (upstream) e volta (downstream) em Kbps.
+typedef struct {
+    const char *name;
+    double up_kbps;
+    double down_kbps;
+} scenario;
+
+static const scenario scenarios[] = {
+    {"10u/10d", 10, 10},
+    {"50u/10d", 50, 10},
+    {"50u/2d", 50, 2},
+    {"5u/50d", 5, 50},
+    {"50u/50d", 50, 50},
+};
+
+// Modos de janela e timeout (figuras 2 a 9 do README).
+typedef struct {
+    const char *name;
+    int dynamic_window;
+    int dynamic_timeout;
+} mode;
+
+static const mode modes[] = {
+    {"dynamic", TRUE, TRUE},
+    {"static-window", FALSE, TRUE},
+    {"static-timeout", TRUE, FALSE},
+    {"static", FALSE, FALSE},
+};
+
+// Opções da linha de comando.
+typedef struct {
+    int runs;
+    long bytes;
+    double scale;
+    impair_link link;       // Perda, corrupção, reordenação, atraso e fila (a banda vem do cenário)
+    const char *only_scenarios; // Lista separada por vírgulas (NULL = todos)
+    const char *only_modes;
+    int port;
+    unsigned seed;
+    int verbose;
+    int compress;           // Arquivo de texto enviado com compressão (compress_enabled)
+} options;
+
+// Resultado de uma execução.
+typedef struct {
+    int ok;                 // Transferência concluída e arquivo recebido íntegro
+    const char *failed;     // Etapa que falhou (NULL = nenhuma)
+    double elapsed;         // Tempo de conclusão (s)
+    impair_stats up, down;  // Contadores do proxy
+    rdt_stats tx;           // Contadores do remetente
+} run_result;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Uso: %s [opções]\n"
+            "  -n execuções    execuções por combinação (padrão %d)\n"
+            "  -b bytes        tamanho do arquivo (padrão %d)\n"
+            "  -x escala       multiplicador das bandas do README em Kbps (padrão %d; 100000 = Gbps)\n"
+            "  -l perda        probabilidade de perda em cada sentido (padrão %.2f)\n"
+            "  -c corrupção    probabilidade de inverter um bit (padrão 0)\n"
+            "  -r reordenação  probabilidade de reordenar um datagrama (padrão 0)\n"
+            "  -d atraso       atraso de cada sentido em ms (padrão %.0f)\n"
+            "  -q fila         fila do enlace em bytes (padrão 0 = ilimitada)\n"
+            "  -s cenários     cenários separados por vírgula (ex.: 50u/10d,5u/50d)\n"
+            "  -m modos        modos separados por vírgula (dynamic, static-window, static-timeout, static)\n"
+            "  -T timeout      timeout estático em segundos (padrão o do protocolo)\n"
+            "  -a algoritmo    controle de congestionamento (aimd, cubic ou bbr)\n"
+            "  -p porta        porta do servidor (padrão %d)\n"
+            "  -S semente      semente do proxy (padrão 1)\n"
+            "  -t prefixo      grava o trace de eventos de cada conexão em prefixo.<porta>-<porta>\n"
+            "  -v              mantém as mensagens do protocolo na saída de erro (-vv: uma por pacote)\n"
+            "  -z              arquivo de texto (linhas de log) enviado com compressão LZ4\n",
+            prog, DEFAULT_RUNS, DEFAULT_BYTES, DEFAULT_SCALE, DEFAULT_LOSS, DEFAULT_DELAY * 1000, DEFAULT_PORT);
+    exit(EXIT_FAILURE);
+}
+
+// Retorna TRUE se name está na lista separada por vírgulas (ou se a lista for NULL).
+static int selected(const char *list, const char *name) {
+    if (!list)
+        return TRUE;
+    size_t len = strlen(name);
+    for (const char *p = list; *p; ) {
+        const char *end = strchr(p, ',');
+        size_t n = end ? (size_t)(end - p) : strlen(p);
+        if (n == len && strncmp(p, name, len) == 0)
+            return TRUE;
+        if (!end)
+            break;
+        p = end + 1;
+    }
+    return FALSE;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Percentil p (0 a 1) de n valores ordenados, pelo método do posto mais próximo.
+static double percentile(const double *v, int n, double p) {
+    int i = (int)ceil(p * n) - 1;
+    return v[i < 0 ? 0 : i];
+}
+
+// Confere o arquivo gravado pelo servidor. O FIN é confirmado antes de o servidor fechar o
+// arquivo, então o tamanho final pode demorar um pouco a aparecer.
+static int verify(const char *data, long bytes) {
+    const char *path = "receive/" BENCH_FILE;
+    struct stat st;
+    for (int i = 0; i < 200 && (stat(path, &st) < 0 || st.st_size != bytes); i++)
+        usleep(10000);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return FALSE;
+    char *buf = malloc(bytes);
+    long got = 0;
+    while (buf && got < bytes) {
+        ssize_t n = read(fd, buf + got, bytes - got);
+        if (n <= 0)
+            break;
+        got += n;
+    }
+    int ok = buf && got == bytes && memcmp(buf, data, bytes) == 0;
+    free(buf);
+    close(fd);
+    unlink(path);
+    return ok;
+}
+
+// Transfere data uma vez pelo proxy com os enlaces up e down.
+static void run_once(const options *o, const impair_link *up, const impair_link *down, unsigned seed,
+                     const char *data, run_result *res) {
+    memset(res, 0, sizeof(*res));
+    res->failed = "proxy";
+    impair *im = impair_open(o->port, up, down, seed);
+    if (!im)
+        return;
+    struct sockaddr_in dst; // Porta do proxy
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(impair_port(im));
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    file_meta meta;
+    memset(&meta, 0, sizeof(meta));
+    strcpy(meta.filename, BENCH_FILE);
+    meta.fileSize = meta.length = o->bytes;
+    meta.stripe_count = 1;
+
+    double t0 = now_sec();
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    res->failed = "socket";
+    if (sockfd >= 0) {
+        rdt_conn conn;
+        rdt_conn_init(&conn, sockfd, &dst);
+        res->failed = "start";
+        if (rdt_start(&conn, &meta) == SUCCESS) {
+            rdt_stream *s = rdt_stream_open(&conn);
+            res->failed = "stream";
+            if (s && conn.compress_enabled) { // Quadros da thread de compressão, como em client_rdt
+                rdt_zpipe *z = rdt_zpipe_open(-1, data, 0, o->bytes, conn.compress_level);
+                char *frame;
+                int n = ERROR;
+                while (z && (n = rdt_zpipe_next(z, &frame)) > 0 && rdt_stream_write(s, frame, n) >= 0)
+                    ;
+                rdt_zpipe_close(z, NULL);
+                if (n == 0)
+                    res->failed = NULL;
+            } else if (s && rdt_stream_write_zc(s, data, o->bytes) == SUCCESS) {
+                res->failed = NULL;
+            }
+            if (s && rdt_stream_close(s) < 0 && !res->failed)
+                res->failed = "close";
+        }
+        rdt_stats_get(&conn, &res->tx);
+        close(sockfd);
+    }
+    res->elapsed = now_sec() - t0;
+    impair_close(im, &res->up, &res->down);
+    if (!verify(data, o->bytes) && !res->failed)
+        res->failed = "verify";
+    res->ok = !res->failed;
+}
+
+// Executa as o->runs transferências de uma combinação e imprime a linha JSON do resultado.
+static void run_config(FILE *out, const options *o, const scenario *sc, const mode *md, const char *data) {
+    impair_link up = o->link, down = o->link;
+    up.rate = sc->up_kbps * 1000 * o->scale;
+    down.rate = sc->down_kbps * 1000 * o->scale;
+    dynamic_window_enabled = md->dynamic_window;
+    dynamic_timeout_enabled = md->dynamic_timeout;
+
+    double times[MAX_RUNS]; // Tempos das execuções bem-sucedidas
+    int ok = 0;
+    long data_pkts = 0, data_unique = 0, lost = 0, corrupted = 0, queue_drops = 0;
+    long timeouts = 0, fast_retx = 0;
+    for (int i = 0; i < o->runs; i++) {
+        run_result res;
+        run_once(o, &up, &down, o->seed + i, data, &res);
+        fprintf(stderr, "bench_rdt: %s %s execução %d: %s%s%s em %.2f s\n", sc->name, md->name, i + 1,
+                res.ok ? "ok" : "FALHA (", res.ok ? "" : res.failed, res.ok ? "" : ")", res.elapsed);
+        data_pkts += res.up.data_pkts;
+        data_unique += res.up.data_unique;
+        lost += res.up.lost + res.down.lost;
+        corrupted += res.up.corrupted + res.down.corrupted;
+        queue_drops += res.up.queue_drops + res.down.queue_drops;
+        timeouts += res.tx.timeouts;
+        fast_retx += res.tx.fast_retransmits;
+        if (res.ok)
+            times[ok++] = res.elapsed;
+    }
+    qsort(times, ok, sizeof(double), cmp_double);
+    double p50 = ok ? percentile(times, ok, 0.5) : 0, p99 = ok ? percentile(times, ok, 0.99) : 0;
+    fprintf(out, "{\"scenario\":\"%s\",\"mode\":\"%s\",\"up_bps\":%.0f,\"down_bps\":%.0f,"
+            "\"loss\":%g,\"corrupt\":%g,\"reorder\":%g,\"delay_ms\":%g,\"queue_bytes\":%ld,"
+            "\"bytes\":%ld,\"runs\":%d,\"failures\":%d,\"goodput_mbps_p50\":%.3f,"
+            "\"time_p50_s\":%.3f,\"time_p99_s\":%.3f,\"retx_ratio\":%.4f,"
+            "\"data_pkts\":%ld,\"lost\":%ld,\"corrupted\":%ld,\"queue_drops\":%ld,"
+            "\"timeouts\":%ld,\"fast_retransmits\":%ld,\"compress\":%s}\n",
+            sc->name, md->name, up.rate, down.rate, o->link.loss, o->link.corrupt, o->link.reorder,
+            o->link.delay * 1000, o->link.queue_bytes, o->bytes, o->runs, o->runs - ok,
+            p50 > 0 ? o->bytes * 8 / p50 / 1e6 : 0, p50, p99,
+            data_unique ? (double)(data_pkts - data_unique) / data_unique : 0,
+            data_pkts, lost, corrupted, queue_drops, timeouts, fast_retx, o->compress ? "true" : "false");
+    fflush(out);
+}
+
+static void *server_main(void *arg) {
+    rdt_server_run(*(int *)arg, 1);
+    fprintf(stderr, "bench_rdt: O servidor terminou.\n");
+    exit(EXIT_FAILURE);
+}
+
+// Confere se a porta está livre: o servidor usa SO_REUSEPORT e se juntaria a outro processo.
+static int port_free(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
+    int ok = fd >= 0 && bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    if (fd >= 0)
+        close(fd);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    options o = {
+        .runs = DEFAULT_RUNS, .bytes = DEFAULT_BYTES, .scale = DEFAULT_SCALE,
+        .link = {.loss = DEFAULT_LOSS, .delay = DEFAULT_DELAY}, .port = DEFAULT_PORT, .seed = 1,
+    };
+    int opt;
+    while ((opt = getopt(argc, argv, "n:b:x:l:c:r:d:q:s:m:T:a:p:S:t:vz")) != -1) {
+        switch (opt) {
+        case 'n': o.runs = atoi(optarg); break;
+        case 'b': o.bytes = atol(optarg); break;
+        case 'x': o.scale = atof(optarg); break;
+        case 'l': o.link.loss = atof(optarg); break;
+        case 'c': o.link.corrupt = atof(optarg); break;
+        case 'r': o.link.reorder = atof(optarg); break;
+        case 'd': o.link.delay = atof(optarg) / 1000; break;
+        case 'q': o.link.queue_bytes = atol(optarg); break;
+        case 's': o.only_scenarios = optarg; break;
+        case 'm': o.only_modes = optarg; break;
+        case 'T': {
+            double t = atof(optarg);
+            current_timeout_sec = (int)t;
+            current_timeout_usec = (int)((t - (int)t) * 1000000);
+            break;
+        }
+        case 'a':
+            if (rdt_cc_select(optarg) < 0)
+                return EXIT_FAILURE;
+            break;
+        case 'p': o.port = atoi(optarg); break;
+        case 'S': o.seed = (unsigned)atol(optarg); break;
+        case 't': trace_path = optarg; break;
+        case 'v':
+            o.verbose = TRUE;
+            log_level = log_level < RDT_LOG_DEBUG ? RDT_LOG_DEBUG : RDT_LOG_TRACE;
+            break;
+        case 'z':
+            o.compress = compress_enabled = TRUE;
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc || o.runs < 1 || o.runs > MAX_RUNS || o.bytes < 1 || o.scale <= 0)
+        usage(argv[0]);
+    if (!port_free(o.port)) {
+        fprintf(stderr, "bench_rdt: Porta %d em uso (use -p).\n", o.port);
+        return EXIT_FAILURE;
+    }
+
+    // Arquivo de origem com conteúdo pseudoaleatório, para que a verificação detecte trocas
+    // de posição; o servidor grava em receive/ de um diretório temporário. Com -z, linhas de
+    // log com campos pseudoaleatórios, que comprimem como os logs reais.
+    char *data = malloc(o.bytes);
+    char dir[] = "/tmp/rdt_bench.XXXXXX";
+    if (!data || !mkdtemp(dir) || chdir(dir) < 0 || mkdir("receive", 0755) < 0) {
+        perror("bench_rdt: preparação");
+        return EXIT_FAILURE;
+    }
+    uint32_t x = 2463534242u;
+    for (long i = 0; i < o.bytes && !o.compress; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        data[i] = (char)x;
+    }
+    for (long i = 0, line = 0; i < o.bytes && o.compress; line++) {
+        char buf[160]; // Linha de log
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        int n = snprintf(buf, sizeof(buf), "2026-10-17T%02ld:%02ld:%02ld.%03uZ INFO req=%ld user=u%u bytes=%u status=%d path=/api/v1/items/%u\n",
+                         line / 3600000 % 24, line / 60000 % 60, line / 1000 % 60, x % 1000, line, x % 997,
+                         x % 65536, x % 50 ? 200 : 404, x % 4093);
+        memcpy(data + i, buf, n < o.bytes - i ? n : o.bytes - i);
+        i += n;
+    }
+
+    // As mensagens do protocolo (uma por pacote) vão para /dev/null; os resultados, para a
+    // saída original.
+    FILE *out = fdopen(dup(STDOUT_FILENO), "w");
+    int sink = o.verbose ? STDERR_FILENO : open("/dev/null", O_WRONLY);
+    if (!out || sink < 0 || dup2(sink, STDOUT_FILENO) < 0) {
+        perror("bench_rdt: stdout");
+        return EXIT_FAILURE;
+    }
+
+    pthread_t server;
+    if (pthread_create(&server, NULL, server_main, &o.port) != 0) {
+        fprintf(stderr, "bench_rdt: pthread_create falhou.\n");
+        return EXIT_FAILURE;
+    }
+    pthread_detach(server);
+    usleep(100000); // O servidor abre o socket
+
+    for (size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        if (!selected(o.only_scenarios, scenarios[s].name))
+            continue;
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            if (selected(o.only_modes, modes[m].name))
+                run_config(out, &o, &scenarios[s], &modes[m], data);
+        }
+    }
+
+    fclose(out);
+    rmdir("receive");
+    if (chdir("/") == 0)
+        rmdir(dir);
+    free(data);
+    return 0;
+}
@@ -0,0 +1,295 @@
+#define _GNU_SOURCE // ppoll
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "rdt.h"
+#include "impair.h"
+
+#define MAX_DATAGRAM   65536   // Maior datagrama repassado (inclui os coalescidos por GSO)
+#define SOCK_BUF_SIZE  (8 << 20) // Buffers dos sockets do proxy
+#define REORDER_DELAY  0.005   // Atraso extra de um datagrama reordenado (s)
+#define MAX_WAIT       0.05    // Espera máxima, para atender o pedido de encerramento (s)
+#define MAX_SEEN_SEQ   (1 << 26) // Maior número de sequência acompanhado para as retransmissões
+
+// Datagrama na fila de entrega, ordenada pelo instante de entrega.
+typedef struct {
+    double t;           // Instante de entrega
+    long n;             // Ordem de chegada (desempate)
+    int dir;            // 0 = ida, 1 = volta
+    int len;            // Tamanho
+    char *data;         // Conteúdo
+} qentry;
+
+// Estado de um sentido do enlace.
+typedef struct {
+    impair_link cfg;    // Parâmetros
+    impair_stats st;    // Contadores
+    double last_dep;    // Fim da transmissão do último datagrama aceito na fila do enlace
+} link_state;
+
+struct impair {
+    int front;                  // Socket onde o cliente envia
+    int back;                   // Socket que fala com o servidor
+    struct sockaddr_in server;  // Endereço do servidor
+    struct sockaddr_in client;  // Endereço do cliente (aprendido no primeiro datagrama)
+    int have_client;
+    link_state links[2];        // Ida e volta
+    qentry *heap;               // Fila de entrega (heap mínimo)
+    int nheap, cap;
+    long seq_in;                // Datagramas aceitos até agora
+    uint64_t rng;               // Estado do gerador aleatório (xorshift64*)
+    uint8_t *seen;              // Bitmap dos números de sequência de dados já vistos
+    long seen_bits;
+    volatile int stop;          // Pedido de encerramento
+    pthread_t thread;
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Número aleatório uniforme em [0, 1).
+static double rnd(impair *im) {
+    im->rng ^= im->rng >> 12;
+    im->rng ^= im->rng << 25;
+    im->rng ^= im->rng >> 27;
+    return (double)((im->rng * 0x2545F4914F6CDD1DULL) >> 11) / (double)(1ULL << 53);
+}
+
+static int qless(const qentry *a, const qentry *b) {
+    return a->t < b->t || (a->t == b->t && a->n < b->n);
+}
+
+static int heap_push(impair *im, qentry e) {
+    if (im->nheap == im->cap) {
+        int cap = im->cap ? 2 * im->cap : 1024;
+        qentry *h = realloc(im->heap, cap * sizeof(qentry));
+        if (!h)
+            return ERROR;
+        im->heap = h;
+        im->cap = cap;
+    }
+    int i = im->nheap++;
+    while (i > 0 && qless(&e, &im->heap[(i - 1) / 2])) { // Sobe até a posição
+        im->heap[i] = im->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    im->heap[i] = e;
+    return SUCCESS;
+}
+
+static qentry heap_pop(impair *im) {
+    qentry top = im->heap[0];
+    qentry last = im->heap[--im->nheap];
+    int i = 0;
+    while (2 * i + 1 < im->nheap) { // Desce o último até a posição
+        int c = 2 * i + 1;
+        if (c + 1 < im->nheap && qless(&im->heap[c + 1], &im->heap[c]))
+            c++;
+        if (!qless(&im->heap[c], &last))
+            break;
+        im->heap[i] = im->heap[c];
+        i = c;
+    }
+    if (im->nheap > 0)
+        im->heap[i] = last;
+    return top;
+}
+
+// Conta os PKT_DATA do sentido de ida e os números de sequência distintos entre eles.
+static void count_data(impair *im, impair_stats *st, const char *data, int len) {
+    if (len < (int)sizeof(hdr))
+        return;
+    const pkt *p = (const pkt *)data;
+    if (p->h.pkt_type != PKT_DATA)
+        return;
+    st->data_pkts++;
+    hseq_t seq = pkt_seq(p);
+    if (seq >= MAX_SEEN_SEQ) { // Fora do bitmap: conta como novo
+        st->data_unique++;
+        return;
+    }
+    if ((long)seq >= im->seen_bits) {
+        long bits = im->seen_bits ? im->seen_bits : 1 << 16;
+        while (bits <= (long)seq)
+            bits *= 2;
+        uint8_t *seen = realloc(im->seen, bits / 8);
+        if (!seen)
+            return;
+        memset(seen + im->seen_bits / 8, 0, (bits - im->seen_bits) / 8);
+        im->seen = seen;
+        im->seen_bits = bits;
+    }
+    if (!(im->seen[seq / 8] & (1 << (seq % 8)))) {
+        im->seen[seq / 8] |= 1 << (seq % 8);
+        st->data_unique++;
+    }
+}
+
+// Aplica as perturbações do sentido dir a um datagrama recebido e o coloca na fila de entrega.
+static void admit(impair *im, int dir, const char *data, int len, double now) {
+    link_state *l = &im->links[dir];
+    l->st.packets++;
+    l->st.bytes += len;
+    if (dir == 0)
+        count_data(im, &l->st, data, len);
+    if (rnd(im) < l->cfg.loss) {
+        l->st.lost++;
+        return;
+    }
+    double t = now; // Fim da transmissão no enlace
+    if (l->cfg.rate > 0) {
+        // Fila FIFO na entrada do enlace: o que já aguarda ocupa (last_dep - now) * rate bits.
+        if (l->cfg.queue_bytes > 0 && (l->last_dep - now) * l->cfg.rate / 8 > l->cfg.queue_bytes) {
+            l->st.queue_drops++;
+            return;
+        }
+        t = (l->last_dep > now ? l->last_dep : now) + len * 8.0 / l->cfg.rate;
+        l->last_dep = t;
+    }
+    qentry e = {.t = t + l->cfg.delay, .n = im->seq_in++, .dir = dir, .len = len};
+    if (rnd(im) < l->cfg.reorder) {
+        e.t += REORDER_DELAY;
+        l->st.reordered++;
+    }
+    e.data = malloc(len);
+    if (!e.data)
+        return;
+    memcpy(e.data, data, len);
+    if (rnd(im) < l->cfg.corrupt) {
+        int bit = (int)(rnd(im) * len * 8);
+        e.data[bit / 8] ^= 1 << (bit % 8);
+        l->st.corrupted++;
+    }
+    if (heap_push(im, e) < 0)
+        free(e.data);
+}
+
+// Drena a fila do socket de um sentido.
+static void drain(impair *im, int dir, char *buf) {
+    int fd = dir == 0 ? im->front : im->back;
+    while (1) {
+        struct sockaddr_in src;
+        socklen_t slen = sizeof(src);
+        ssize_t n = recvfrom(fd, buf, MAX_DATAGRAM, MSG_DONTWAIT, (struct sockaddr *)&src, &slen);
+        if (n < 0)
+            return;
+        if (dir == 0) { // O cliente é quem envia para a porta do proxy
+            im->client = src;
+            im->have_client = TRUE;
+        }
+        admit(im, dir, buf, (int)n, now_sec());
+    }
+}
+
+static void *impair_main(void *arg) {
+    impair *im = arg;
+    char *buf = malloc(MAX_DATAGRAM);
+    if (!buf)
+        return NULL;
+    struct pollfd fds[2] = {{.fd = im->front, .events = POLLIN}, {.fd = im->back, .events = POLLIN}};
+    while (!im->stop) {
+        double now = now_sec();
+        while (im->nheap > 0 && im->heap[0].t <= now) { // Entrega os datagramas vencidos
+            qentry e = heap_pop(im);
+            if (e.dir == 0)
+                sendto(im->back, e.data, e.len, 0, (struct sockaddr *)&im->server, sizeof(im->server));
+            else if (im->have_client)
+                sendto(im->front, e.data, e.len, 0, (struct sockaddr *)&im->client, sizeof(im->client));
+            free(e.data);
+        }
+        double wait = im->nheap > 0 ? im->heap[0].t - now : MAX_WAIT;
+        if (wait > MAX_WAIT)
+            wait = MAX_WAIT;
+        struct timespec ts = {.tv_sec = (time_t)wait, .tv_nsec = (long)((wait - (time_t)wait) * 1e9)};
+        if (ppoll(fds, 2, &ts, NULL) <= 0)
+            continue;
+        if (fds[0].revents & POLLIN)
+            drain(im, 0, buf);
+        if (fds[1].revents & POLLIN)
+            drain(im, 1, buf);
+    }
+    free(buf);
+    return NULL;
+}
+
+// Cria um socket UDP em 127.0.0.1 na porta port (0 = escolhida pelo kernel).
+static int open_socket(int port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        perror("impair: socket");
+        return ERROR;
+    }
+    int size = SOCK_BUF_SIZE;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("impair: bind");
+        close(fd);
+        return ERROR;
+    }
+    return fd;
+}
+
+impair *impair_open(int dst_port, const impair_link *up, const impair_link *down, unsigned seed) {
+    impair *im = calloc(1, sizeof(impair));
+    if (!im) {
+        perror("impair: calloc");
+        return NULL;
+    }
+    im->links[0].cfg = *up;
+    im->links[1].cfg = *down;
+    im->rng = 0x9E3779B97F4A7C15ULL * (seed + 1); // Nunca zero
+    im->server.sin_family = AF_INET;
+    im->server.sin_port = htons(dst_port);
+    im->server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    im->front = open_socket(0);
+    im->back = open_socket(0);
+    if (im->front < 0 || im->back < 0 || pthread_create(&im->thread, NULL, impair_main, im) != 0) {
+        if (im->front >= 0)
+            close(im->front);
+        if (im->back >= 0)
+            close(im->back);
+        free(im);
+        return NULL;
+    }
+    return im;
+}
+
+int impair_port(impair *im) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    if (getsockname(im->front, (struct sockaddr *)&addr, &len) < 0)
+        return ERROR;
+    return ntohs(addr.sin_port);
+}
+
+void impair_close(impair *im, impair_stats *up, impair_stats *down) {
+    im->stop = TRUE;
+    pthread_join(im->thread, NULL);
+    if (up)
+        *up = im->links[0].st;
+    if (down)
+        *down = im->links[1].st;
+    while (im->nheap > 0)
+        free(heap_pop(im).data);
+    free(im->heap);
+    free(im->seen);
+    close(im->front);
+    close(im->back);
+    free(im);
+}
@@ -0,0 +1,43 @@
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+// Proxy UDP de emulação de enlace para os benchmarks em loopback.
+// O cliente envia para a porta do proxy, que repassa cada datagrama ao servidor (sentido de
+// ida) e as respostas do servidor ao cliente (sentido de volta), aplicando em cada sentido
+// perda, corrupção, reordenação, atraso e limite de banda com fila finita. O proxy roda em
+// uma thread própria e usa um gerador aleatório com semente, de modo que a mesma semente
+// reproduz as mesmas decisões para a mesma sequência de datagramas.
+
+// Parâmetros de um sentido do enlace.
+typedef struct {
+    double rate;        // Banda (bit/s, 0 = ilimitada)
+    double loss;        // Probabilidade de descarte de cada datagrama
+    double corrupt;     // Probabilidade de inverter um bit do datagrama
+    double reorder;     // Probabilidade de atrasar o datagrama além dos seguintes
+    double delay;       // Atraso de propagação (s)
+    long queue_bytes;   // Fila do enlace: descarta o que não couber (bytes, 0 = ilimitada)
+} impair_link;
+
+// Contadores de um sentido do enlace.
+typedef struct {
+    long packets;       // Datagramas recebidos do remetente
+    long bytes;         // Bytes recebidos do remetente
+    long lost;          // Descartados pela perda aleatória
+    long queue_drops;   // Descartados por falta de espaço na fila
+    long corrupted;     // Entregues com um bit invertido
+    long reordered;     // Entregues fora de ordem
+    long data_pkts;     // Pacotes PKT_DATA (transmissões e retransmissões)
+    long data_unique;   // Números de sequência distintos entre os PKT_DATA
+} impair_stats;
+
+typedef struct impair impair;
+
+// Cria o proxy entre uma porta local livre e o servidor em 127.0.0.1:dst_port e inicia a sua
+// thread. up é o sentido cliente → servidor; down, o de volta. Retorna NULL em caso de erro.
+impair *impair_open(int dst_port, const impair_link *up, const impair_link *down, unsigned seed);
+// Porta local à qual o cliente deve enviar.
+int impair_port(impair *im);
+// Encerra a thread, descarta os datagramas ainda na fila e copia os contadores (se não NULL).
+void impair_close(impair *im, impair_stats *up, impair_stats *down);
+
+#endif
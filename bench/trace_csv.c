@@ -0,0 +1,52 @@
+// Converte os arquivos de trace gravados com trace_path (rdt_log.h) para CSV, um evento por
+// linha, com o instante relativo ao primeiro evento de cada arquivo.
+// Compilação: make bench (ou gcc -O2 -I. bench/trace_csv.c -o trace_csv)
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "rdt_log.h"
+
+static const char *type_name(int type) {
+    static const char *names[] = {"?", "send", "retx", "ack", "dupack", "timeout", "fast_retx", "rtt", "recv", "ack_sent"};
+    return type > 0 && type < (int)(sizeof(names) / sizeof(names[0])) ? names[type] : names[0];
+}
+
+// Escreve os eventos de um arquivo. Retorna 0 ou -1.
+static int convert(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    rdt_trace_hdr h;
+    if (fread(&h, sizeof(h), 1, f) != 1 || memcmp(h.magic, RDT_TRACE_MAGIC, sizeof(h.magic)) != 0 || h.version != 1) {
+        fprintf(stderr, "%s: não é um trace do RDT.\n", path);
+        fclose(f);
+        return -1;
+    }
+    if (h.dropped)
+        fprintf(stderr, "%s: %llu eventos mais antigos perdidos no anel.\n", path, (unsigned long long)h.dropped);
+    rdt_event e;
+    uint64_t t0 = 0; // Instante do primeiro evento
+    for (uint32_t i = 0; i < h.count && fread(&e, sizeof(e), 1, f) == 1; i++) {
+        if (i == 0)
+            t0 = e.t_ns;
+        printf("%s,%.6f,%s,%u,%u,%.3f,%.3f\n", path, (e.t_ns - t0) / 1e9, type_name(e.type), e.seq, e.cwnd,
+               e.rto_us / 1e3, e.rtt_us / 1e3);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Uso: %s <trace>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    int rv = EXIT_SUCCESS;
+    printf("file,t_s,event,seq,cwnd,rto_ms,rtt_ms\n");
+    for (int i = 1; i < argc; i++)
+        if (convert(argv[i]) < 0)
+            rv = EXIT_FAILURE;
+    return rv;
+}
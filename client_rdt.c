@@ -1,26 +1,245 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include "rdt.h"
+#include "rdt_cc.h"
+#include "rdt_resume.h"
+#include "rdt_compress.h"
+#include "rdt_delta.h"
 
 #define MAX_DATA_SIZE 65536  // Limita o tamanho do bloco a 64KB
+#define MAX_STREAMS   16     // Máximo de fluxos paralelos
+#define STRIPE_ALIGN  4096   // Alinhamento dos intervalos de cada fluxo
+
+// Flag para ativar o envio sem cópia.
+// 1 = o arquivo é mapeado com mmap e os pacotes apontam para o mapeamento (rdt_stream_write_zc);
+// nenhum byte do payload é copiado no espaço do usuário, nem nas retransmissões.
+// 0 = o arquivo é lido em blocos de 64KB (pread) e cada segmento é copiado para o buffer do fluxo.
+int zero_copy_enabled = TRUE;
+
+// Intervalo do arquivo enviado por um fluxo (socket, conexão e thread próprios).
+typedef struct {
+    int fd;                         // Arquivo de origem (lido com pread)
+    const char *map;                // Arquivo mapeado (envio sem cópia) ou NULL
+    struct sockaddr_in dest_addr;   // Endereço do servidor
+    file_meta meta;                 // Metadados enviados no PKT_START deste fluxo
+    const rdt_range *runs;          // Retomada: intervalos do arquivo a enviar (NULL = todo o intervalo do fluxo)
+    int nruns;
+    int delta_block;                // Envio por diferença: bloco das assinaturas (0 = arquivo inteiro)
+    uint64_t delta_digest;          // Hash do arquivo, conferido pelo servidor
+    int rv;                         // Resultado do envio
+} stripe;
+
+// Envia o intervalo do arquivo em quadros comprimidos pela thread de compressão, que lê e
+// comprime os próximos quadros enquanto o fluxo envia os anteriores. Retorna os bytes do
+// arquivo enviados.
+static long send_compressed(rdt_stream *stream, stripe *st, file_meta *meta, int level) {
+    rdt_zpipe *z = rdt_zpipe_open(st->fd, st->map, meta->offset, meta->length, level); // Compressor
+    if (!z)
+        return 0;
+    char *frame; // Próximo quadro
+    int n;
+    while ((n = rdt_zpipe_next(z, &frame)) > 0) {
+        if (rdt_stream_write(stream, frame, n) < 0) { // Envia o quadro
+            perror("client: rdt_stream_write");
+            break;
+        }
+    }
+    rdt_zstats zs; // Totais da compressão
+    rdt_zpipe_close(z, &zs);
+    RDT_LOG(RDT_LOG_INFO, "client: Fluxo %d comprimido: %ld de %ld bytes (%.1f%%), %ld de %ld quadros sem compressão.\n",
+            meta->stripe_index + 1, zs.frame_bytes, zs.raw_bytes, zs.raw_bytes ? 100.0 * zs.frame_bytes / zs.raw_bytes : 100.0,
+            zs.stored, zs.frames);
+    return n == 0 ? zs.raw_bytes : 0;
+}
+
+// Saída do codificador do envio por diferença: entrega as instruções ao fluxo, em quadros
+// comprimidos se a compressão foi aceita.
+typedef struct {
+    rdt_stream *stream;
+    char *frame;                    // Quadro da compressão (NULL = sem compressão)
+    int level;
+    long frame_bytes;               // Bytes dos quadros enviados
+} delta_out;
+
+static int delta_write(void *arg, const char *buf, int len) {
+    delta_out *o = arg;
+    if (o->frame) { // Cada trecho de instruções (até DELTA_CHUNK = Z_FRAME bytes) vira um quadro
+        len = rdt_z_frame(buf, len, o->frame, o->level, TRUE);
+        buf = o->frame;
+        o->frame_bytes += len;
+    }
+    if (rdt_stream_write(o->stream, (void *)buf, len) < 0) {
+        perror("client: rdt_stream_write");
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+// Envia o arquivo como instruções do envio por diferença contra a cópia do servidor (nsigs
+// assinaturas, base_size bytes): trechos literais e referências aos blocos que o servidor já
+// tem. Retorna os bytes do arquivo enviados.
+static long send_delta(rdt_stream *stream, stripe *st, file_meta *meta, rdt_conn *c,
+                       const delta_sig *sigs, long nsigs, long base_size) {
+    delta_out o = {stream, NULL, c->compress_level, 0};
+    if (c->compress_enabled && !(o.frame = malloc(Z_FRAME_MAX))) {
+        perror("client: malloc");
+        return 0;
+    }
+    rdt_dstats ds; // Totais da codificação
+    int rv = rdt_delta_encode(st->map, meta->length, sigs, nsigs, st->delta_block, base_size, delta_write, &o, &ds);
+    free(o.frame);
+    RDT_LOG(RDT_LOG_INFO, "client: Envio por diferença: %ld bytes literais, %ld bytes copiados da cópia do servidor "
+            "(%ld instruções de cópia), %ld bytes no fluxo%s.\n", ds.literal_bytes, ds.copied_bytes, ds.copies,
+            c->compress_enabled ? o.frame_bytes : ds.stream_bytes, c->compress_enabled ? " depois da compressão" : "");
+    return rv == SUCCESS ? meta->length : 0;
+}
+
+// Envia o intervalo [meta->offset, meta->offset + meta->length) do arquivo em uma conexão própria.
+static int send_range(stripe *st, file_meta *meta) {
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0); // Cria o socket
+    if (sockfd < 0) { // Verifica erros
+        perror("client: socket");
+        return ERROR;
+    }
+    
+    rdt_conn conn; // Contexto da conexão
+    rdt_conn_init(&conn, sockfd, &st->dest_addr);
+    conn.delta_enabled = st->delta_block > 0;
+    conn.delta_block = st->delta_block;
+    conn.delta_digest = st->delta_digest;
+    printf("client: Iniciando fluxo %d de %d (bytes %ld a %ld).\n", meta->stripe_index + 1, meta->stripe_count,
+           meta->offset, meta->offset + meta->length - 1); // Exibe informações
+    if (rdt_start(&conn, meta) < 0) { // Envia o PKT_START e aguarda o ACK
+        fprintf(stderr, "client: Servidor não confirmou o PKT_START.\n");
+        close(sockfd);
+        return ERROR;
+    }
+    
+    // Envio por diferença aceito: consulta na conexão as assinaturas da cópia do servidor, antes
+    // do fluxo de envio. Sem resposta, as instruções levam o arquivo inteiro como literais.
+    delta_sig *sigs = NULL; // Assinaturas da cópia do servidor
+    long nsigs = 0, base_size = 0; // Assinaturas e tamanho da cópia
+    if (conn.delta_enabled) {
+        nsigs = rdt_delta_fetch(&conn, conn.delta_block, &sigs, &base_size);
+        if (nsigs < 0) {
+            fprintf(stderr, "client: Assinaturas indisponíveis, enviando o arquivo inteiro.\n");
+            nsigs = base_size = 0;
+        } else {
+            printf("client: %ld assinaturas da cópia do servidor (%ld bytes, blocos de %d bytes).\n",
+                   nsigs, base_size, conn.delta_block);
+        }
+    }
+    rdt_stream *stream = rdt_stream_open(&conn); // Abre o fluxo de envio
+    if (!stream) {
+        free(sigs);
+        close(sockfd);
+        return ERROR;
+    }
+    
+    long sent = 0; // Bytes do intervalo já entregues ao fluxo
+    char *buffer = NULL; // Buffer para armazenar os dados lidos
+    if (conn.delta_enabled) { // Envio por diferença aceito pelo receptor
+        sent = send_delta(stream, st, meta, &conn, sigs, nsigs, base_size);
+    } else if (conn.compress_enabled) { // Compressão aceita pelo receptor
+        sent = send_compressed(stream, st, meta, conn.compress_level);
+    } else if (st->map) { // Envio sem cópia: o intervalo inteiro é entregue ao fluxo de uma vez
+        if (rdt_stream_write_zc(stream, st->map + meta->offset, meta->length) < 0)
+            perror("client: rdt_stream_write_zc");
+        else
+            sent = meta->length;
+    } else {
+        buffer = malloc(MAX_DATA_SIZE);
+    }
+    
+    // Loop para ler o bloco de dados e enviar ao servidor; a janela continua aberta entre os blocos
+    while (buffer && sent < meta->length) {
+        long want = meta->length - sent; // Bytes restantes do intervalo
+        ssize_t bytesRead = pread(st->fd, buffer, want < MAX_DATA_SIZE ? want : MAX_DATA_SIZE, meta->offset + sent); // Lê o bloco de dados
+        if (bytesRead <= 0) {
+            perror("client: pread");
+            break;
+        }
+        if (rdt_stream_write(stream, buffer, bytesRead) < 0) { // Envia o bloco de dados
+            perror("client: rdt_stream_write");
+            break;
+        }
+        sent += bytesRead;
+    }
+    free(buffer);
+    free(sigs);
+    
+    int rv = ERROR; // Resultado do envio
+    if (sent < meta->length) {
+        rdt_stream_close(stream);
+    } else if (rdt_stream_close(stream) < 0) { // Aguarda os ACKs pendentes e fecha a conexão
+        perror("client: rdt_stream_close");
+    } else {
+        rv = SUCCESS;
+    }
+    if (RDT_LOG_INFO <= log_level) {
+        char prefix[64]; // Origem da linha
+        snprintf(prefix, sizeof(prefix), "client: Contadores do fluxo %d:", meta->stripe_index + 1);
+        rdt_stats_dump(stdout, prefix, &conn.stats);
+    }
+    close(sockfd);
+    return rv;
+}
+
+// Envia o intervalo do fluxo. Na retomada, envia apenas os intervalos do plano contidos nele,
+// cada um em uma conexão própria.
+static void *send_stripe(void *arg) {
+    stripe *st = arg;
+    if (!st->runs) {
+        st->rv = send_range(st, &st->meta);
+        return NULL;
+    }
+    st->rv = SUCCESS;
+    long lo = st->meta.offset, hi = st->meta.offset + st->meta.length; // Intervalo do fluxo
+    for (int i = 0; i < st->nruns && st->rv == SUCCESS; i++) {
+        file_meta meta = st->meta; // Metadados do trecho
+        meta.offset = st->runs[i].offset > lo ? st->runs[i].offset : lo;
+        long end = st->runs[i].offset + st->runs[i].length < hi ? st->runs[i].offset + st->runs[i].length : hi;
+        meta.length = end - meta.offset;
+        if (meta.length > 0 || (st->runs[i].length == 0 && st->meta.length == 0)) // Arquivo vazio: só o PKT_START
+            st->rv = send_range(st, &meta);
+    }
+    return NULL;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) { // Verifica se o número de argumentos está correto
-        fprintf(stderr, "Uso: %s <server_ip> <server_port> <arquivo>\n", argv[0]); // Exibe mensagem de uso
+    if (argc < 4 || argc > 9) { // Verifica se o número de argumentos está correto
+        fprintf(stderr, "Uso: %s <server_ip> <server_port> <arquivo> [aimd|cubic|bbr] [fluxos] [resume] [lz4] [delta]\n", argv[0]); // Exibe mensagem de uso
         exit(EXIT_FAILURE); // Encerra o programa com falha
     }
     
     char *server_ip = argv[1]; // Endereço IP do servidor
     int server_port = atoi(argv[2]); // Porta do servidor
     char *filename = argv[3]; // Nome do arquivo a ser enviado
-    
-    int sockfd = socket(AF_INET, SOCK_DGRAM, 0); // Cria o socket
-    if (sockfd < 0) { // Verifica erros
-        perror("client: socket");
-        exit(EXIT_FAILURE);
+    int nstreams = 1; // Número de fluxos paralelos
+    for (int i = 4; i < argc; i++) {
+        if (isdigit((unsigned char)argv[i][0])) { // Número de fluxos
+            nstreams = atoi(argv[i]);
+            if (nstreams < 1 || nstreams > MAX_STREAMS) {
+                fprintf(stderr, "client: Número de fluxos deve estar entre 1 e %d.\n", MAX_STREAMS);
+                exit(EXIT_FAILURE);
+            }
+        } else if (strcmp(argv[i], "resume") == 0) { // Retoma um envio anterior
+            resume_enabled = TRUE;
+        } else if (strcmp(argv[i], "lz4") == 0) { // Comprime o fluxo de dados
+            compress_enabled = TRUE;
+        } else if (strcmp(argv[i], "delta") == 0) { // Envia só o que mudou em relação à cópia do servidor
+            delta_enabled = TRUE;
+        } else if (rdt_cc_select(argv[i]) < 0) { // Seleciona o controle de congestionamento
+            exit(EXIT_FAILURE);
+        }
     }
     
     struct sockaddr_in dest_addr; // Estrutura para o endereço do servidor
@@ -29,61 +248,128 @@ int main(int argc, char *argv[]) {
     dest_addr.sin_port = htons(server_port); // Define a porta do servidor
     if (inet_pton(AF_INET, server_ip, &dest_addr.sin_addr) <= 0) { // Converte o endereço IP
         perror("client: inet_pton");
-        close(sockfd);
         exit(EXIT_FAILURE);
     }
     
-    FILE *fp = fopen(filename, "rb"); // Abre o arquivo para leitura
-    if (!fp) {
-        perror("client: fopen");
+    const char *name = strrchr(filename, '/') ? strrchr(filename, '/') + 1 : filename; // Nome no servidor, sem o diretório
+    int fd = open(filename, O_RDONLY); // Abre o arquivo para leitura
+    struct stat st_file; // Informações do arquivo
+    if (fd < 0 || fstat(fd, &st_file) < 0) {
+        perror("client: open");
         return ERROR;
     }
-
-    char buffer[MAX_DATA_SIZE]; // Buffer para armazenar os dados lidos
-    size_t bytesRead; // Número de bytes lidos
+    long fileSize = st_file.st_size; // Obtém o tamanho do arquivo
     
-    fseek(fp, 0, SEEK_END); // Move o ponteiro para o final do arquivo
-    long fileSize = ftell(fp); // Obtém o tamanho do arquivo
-    rewind(fp); // Retorna o ponteiro para o início do arquivo
+    // O envio por diferença usa um único fluxo e substitui a retomada.
+    if (delta_enabled && (nstreams > 1 || resume_enabled)) {
+        printf("client: Envio por diferença usa um único fluxo, sem retomada.\n");
+        nstreams = 1;
+        resume_enabled = FALSE;
+    }
     
-    file_meta meta; // Estrutura para os metadados do arquivo
-    memset(&meta, 0, sizeof(file_meta)); // Zera a estrutura
-    strncpy(meta.filename, filename, sizeof(meta.filename)-1); // Copia o nome do arquivo
-    meta.fileSize = fileSize; // Copia o tamanho do arquivo
+    // O codificador do envio por diferença percorre o arquivo mapeado, mesmo sem o envio sem cópia.
+    const char *map = NULL; // Arquivo mapeado
+    if ((zero_copy_enabled || delta_enabled) && fileSize > 0) {
+        map = mmap(NULL, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            perror("client: mmap (usando leitura com cópia)");
+            map = NULL;
+        } else {
+            madvise((void *)map, fileSize, MADV_SEQUENTIAL);
+        }
+    }
     
-    pkt startPkt; // Pacote de início
+    // Divide o arquivo em intervalos contíguos, múltiplos de STRIPE_ALIGN bytes (múltiplo do
+    // payload de um pacote e do alinhamento do O_DIRECT no receptor). Na retomada, múltiplos do
+    // bloco do checkpoint, para que cada bloco seja gravado por uma única transferência.
+    long align = resume_enabled ? RESUME_BLOCK : STRIPE_ALIGN; // Alinhamento dos intervalos
+    long stripe_len = (fileSize + nstreams - 1) / nstreams; // Bytes por fluxo
+    stripe_len = (stripe_len + align - 1) / align * align;
+    if (stripe_len == 0)
+        stripe_len = align;
     
-    if (make_pkt(&startPkt, PKT_START, 0, &meta, sizeof(file_meta)) < 0) { // Cria o pacote de início
-        fclose(fp);
-        return ERROR;
+    // Retomada: consulta o checkpoint do servidor e envia só os blocos que faltam ou diferem. A
+    // consulta vai em uma conexão própria, aberta por um PKT_START da retomada sem dados.
+    rdt_range *runs = NULL; // Intervalos a enviar
+    int nruns = 0;
+    if (resume_enabled) {
+        int sockfd = socket(AF_INET, SOCK_DGRAM, 0); // Socket da consulta
+        rdt_conn conn; // Contexto da consulta
+        file_meta meta = {.fileSize = fileSize, .offset = 0, .length = 0, .stripe_index = 0, .stripe_count = 1};
+        strncpy(meta.filename, name, sizeof(meta.filename) - 1);
+        if (sockfd < 0) {
+            perror("client: socket");
+            exit(EXIT_FAILURE);
+        }
+        rdt_conn_init(&conn, sockfd, &dest_addr);
+        conn.compress_enabled = FALSE; // Nenhum dado vai nesta conexão
+        if (rdt_start(&conn, &meta) < 0) {
+            fprintf(stderr, "client: Servidor não confirmou o PKT_START da consulta do checkpoint.\n");
+            exit(EXIT_FAILURE);
+        }
+        nruns = rdt_resume_plan(&conn, fd, map, fileSize, &runs);
+        if (nruns < 0) {
+            perror("client: rdt_resume_plan");
+            exit(EXIT_FAILURE);
+        }
+        rdt_close(&conn); // O plano já está pronto: um FIN sem ACK não impede o envio
+        close(sockfd);
     }
-    int ns = sendto(sockfd, &startPkt, startPkt.h.pkt_size, 0,
-                    (struct sockaddr *)&dest_addr, sizeof(struct sockaddr_in)); // Envia o pacote de início
-    if (ns < 0) { // Verifica erros
-        perror("client: sendto(PKT_START)");
-        fclose(fp);
-        return ERROR;
+    nstreams = fileSize > 0 ? (fileSize + stripe_len - 1) / stripe_len : 1; // Descarta fluxos sem dados
+    
+    // Envio por diferença: o bloco das assinaturas e o hash do arquivo vão no PKT_START. Sem uma
+    // cópia no servidor, o arquivo vai inteiro.
+    int delta_block = 0; // Bloco das assinaturas (0 = sem envio por diferença)
+    uint64_t delta_digest = 0; // Hash do arquivo
+    if (delta_enabled && map) {
+        delta_block = rdt_delta_block_size(fileSize);
+        delta_digest = rdt_block_hash(fd, map, 0, fileSize, NULL);
     }
-
-    printf("client: PKT_START enviado (seq %d). Nome: %s, Tamanho: %ld bytes.\n", 
-           startPkt.h.pkt_seq, meta.filename, meta.fileSize); // Exibe informações
-
-    // Loop para ler o bloco de dados e enviar ao servidor
-    while ((bytesRead = fread(buffer, 1, MAX_DATA_SIZE, fp)) > 0) { // Lê o bloco de dados
-        if(rdt_send(sockfd, buffer, bytesRead, &dest_addr) < 0) { // Envia o bloco de dados
-            perror("client: rdt_send");
-            fclose(fp);
-            return ERROR;
-        }
+    
+    stripe stripes[MAX_STREAMS]; // Fluxos de envio
+    pthread_t threads[MAX_STREAMS];
+    for (int i = 0; i < nstreams; i++) {
+        stripe *st = &stripes[i];
+        memset(st, 0, sizeof(stripe)); // Zera a estrutura
+        st->fd = fd;
+        st->map = map;
+        st->dest_addr = dest_addr;
+        strncpy(st->meta.filename, name, sizeof(st->meta.filename)-1); // Copia o nome do arquivo
+        st->meta.fileSize = fileSize; // Copia o tamanho do arquivo
+        st->meta.offset = i * stripe_len;
+        st->meta.length = (i == nstreams - 1) ? fileSize - st->meta.offset : stripe_len;
+        st->meta.stripe_index = i;
+        st->meta.stripe_count = nstreams;
+        st->runs = runs;
+        st->nruns = nruns;
+        st->delta_block = delta_block;
+        st->delta_digest = delta_digest;
     }
-
-    if(rdt_close(sockfd, &dest_addr, 0) < 0) { // Fecha a conexão
-        perror("client: rdt_close");
-        fclose(fp);
-        return ERROR;
+    
+    // Com um único fluxo, o envio é feito na própria thread principal.
+    if (nstreams == 1) {
+        send_stripe(&stripes[0]);
+    } else {
+        for (int i = 0; i < nstreams; i++) {
+            if (pthread_create(&threads[i], NULL, send_stripe, &stripes[i]) != 0) {
+                fprintf(stderr, "client: pthread_create falhou.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (int i = 0; i < nstreams; i++)
+            pthread_join(threads[i], NULL);
     }
+    if (map)
+        munmap((void *)map, fileSize);
+    close(fd);
+    free(runs);
     
+    for (int i = 0; i < nstreams; i++) {
+        if (stripes[i].rv < 0) {
+            fprintf(stderr, "client: Falha no envio do fluxo %d.\n", i + 1);
+            return ERROR;
+        }
+    }
     printf("client: Arquivo enviado com sucesso.\n");
-    close(sockfd);
     return 0;
 }
@@ -1,45 +1,201 @@
+#define _GNU_SOURCE // sendmmsg / recvmmsg
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/udp.h>
 #include <stdint.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <sys/stat.h>
 #include "rdt.h"
+#include "rdt_cc.h"
+#include "rdt_uring.h"
+#include "rdt_fec.h"
+#include "rdt_resume.h"
+#include "rdt_compress.h"
+#include "rdt_delta.h"
 
 // Configurações da janela e timeout estático padrão.
 #define STATIC_WINDOW_SIZE 5
-#define MAX_DYNAMIC_WINDOW 100
+#define MAX_DYNAMIC_WINDOW SND_BUFFER_SIZE // Teto da janela de congestionamento: o buffer de envio inteiro
 #define MIN_DYNAMIC_WINDOW 1
 #define TIMEOUT_SEC        4
 #define TIMEOUT_USEC       100000
+#define SR_RCV_WINDOW      100 // Tamanho do buffer de reordenação do receptor (Selective Repeat)
+#define SND_BUFFER_SIZE    256 // Pacotes mantidos pelo fluxo de envio
+#define IO_BATCH           64  // Máximo de pacotes por chamada sendmmsg / recvmmsg
+#define GSO_MAX_SEGMENTS   64  // Máximo de pacotes por datagrama GSO (limite do kernel)
+#define GSO_MAX_BYTES      65507 // Máximo de bytes por datagrama GSO (limite de 64 KB do UDP)
+#define WRITE_BUF_SIZE     (1 << 20) // Buffer de escrita do receptor (bytes)
+#define WRITE_ALIGN        4096      // Alinhamento exigido pelo O_DIRECT
 
-// Variáveis globais para sequência (definidas como extern em rdt.h).
+#define INITIAL_SEQNUM     1   // Primeiro número de sequência de dados de cada conexão
+#define START_RETRIES      8   // Tentativas de envio do PKT_START
+#define FIN_RETRIES        8   // Tentativas de envio do PKT_FIN
+#define IP_UDP_OVERHEAD    28  // Headers IPv4 (20) e UDP (8) de cada datagrama
+#define PMTU_PROBE_INTERVAL 30.0 // Intervalo entre sondagens do PMTU durante a transferência (s)
+#define PMTU_BLACKHOLE_RTOS 3  // Timeouts seguidos que indicam um caminho que descarta os pacotes grandes
+#define PACING_GAIN_SS     2.0   // Ritmo do pacing no slow start, em janelas por RTT
+#define PACING_GAIN        1.25  // Ritmo do pacing fora do slow start
+#define PACING_QUANTUM     0.001 // Atraso máximo do pacing recuperado em rajada (s)
+
+// As variáveis globais abaixo são os valores padrão das flags de cada conexão: rdt_conn_init
+// as copia para o rdt_conn, e o protocolo só consulta e altera a cópia da conexão.
 int biterror_inject = FALSE;
-hseq_t _snd_seqnum = 1;
-hseq_t _rcv_seqnum = 1;
 
-// Variáveis globais para a janela de transmissão dinâmica.
+// Janela de transmissão dinâmica.
+// Com a janela dinâmica, o tamanho é decidido pelo controle de congestionamento
+// selecionado em cc_algorithm (rdt_cc.h).
 int dynamic_window_enabled = TRUE;   // 0 = janela estática, 1 = janela dinâmica
-int current_window_size = STATIC_WINDOW_SIZE;
 
-// Variáveis globais para timeout: se dinâmico, serão ajustados.
+// Timeout: se dinâmico, é ajustado a cada amostra de RTT a partir de INITIAL_TIMEOUT.
 int dynamic_timeout_enabled = TRUE;    // 0 = timeout estático, 1 = timeout dinâmico
-int current_timeout_sec = TIMEOUT_SEC;
+int current_timeout_sec = TIMEOUT_SEC;   // Timeout estático (também usado na espera pelos FINs)
 int current_timeout_usec = TIMEOUT_USEC;
 const int MAX_TIMEOUT_SEC = 10;     // valor máximo de timeout
-const int MIN_TIMEOUT_SEC = TIMEOUT_SEC; // valor mínimo de timeout
+const double MIN_TIMEOUT = 0.2;    // valor mínimo do timeout dinâmico (s)
+const double INITIAL_TIMEOUT = 1.0; // timeout dinâmico antes da primeira amostra de RTT (s)
+
+// Payload dos pacotes de dados proposto pelo remetente no PKT_START (até MAX_MSG_LEN). O receptor
+// responde com o menor entre a proposta e o seu próprio valor, e ambos passam a usá-lo.
+// DEFAULT_MSG_LEN cabe em um MTU de 1500 bytes; use até MAX_MSG_LEN com quadros jumbo.
+int payload_size = DEFAULT_MSG_LEN;
 
 // Nova flag para ativar ou desativar o fast retransmit.
 // 1 = fast retransmit ativado, 0 = fast retransmit desativado.
 int fast_retransmit_enabled = FALSE;
 
-// Função de checksum: calcula a soma de verificação do buffer.
-unsigned short checksum(unsigned short *buf, int nbytes) {
-    long sum = 0;
+// Flag para ativar o Selective Repeat no lugar do Go-Back-N.
+// 1 = Selective Repeat (ACK individual, timer por pacote e buffer de reordenação no receptor),
+// 0 = Go-Back-N (ACK cumulativo, retransmissão a partir da base da janela).
+// Deve ter o mesmo valor no cliente e no servidor.
+int selective_repeat_enabled = FALSE;
+
+// Flag para ativar os blocos SACK nos ACKs.
+// 1 = o receptor guarda pacotes fora de ordem e informa os intervalos recebidos acima do
+// ACK cumulativo; o remetente retransmite apenas as lacunas. 0 = apenas ACK cumulativo.
+// Deve ter o mesmo valor no cliente e no servidor.
+int sack_enabled = FALSE;
+
+// Flag para ativar a E/S em lote.
+// 1 = o remetente entrega cada rajada da janela ao kernel com um único sendmmsg e o receptor
+// drena a fila do socket com um único recvmmsg, respondendo com um ACK cumulativo por lote.
+// 0 = um sendto / recvfrom por pacote. Desativada automaticamente se o kernel não suportar.
+int batch_io_enabled = TRUE;
+
+// Flag para ativar o offload de segmentação do UDP (Linux).
+// 1 = o remetente junta pacotes consecutivos de mesmo tamanho em um único datagrama grande e o
+// kernel o divide em pacotes (UDP_SEGMENT / GSO); o receptor aceita datagramas coalescidos pelo
+// kernel (UDP_GRO) e os separa em pacotes. 0 = um datagrama por pacote.
+// Desativada automaticamente se o kernel não suportar.
+int udp_offload_enabled = FALSE;
+
+// Flag para gravar o arquivo recebido com O_DIRECT.
+// 1 = os blocos alinhados do buffer de escrita vão direto ao disco, sem passar pelo page cache
+// (útil em transferências maiores que a memória); 0 = escrita normal.
+// Desativada automaticamente se o sistema de arquivos não suportar.
+int direct_io_enabled = FALSE;
+
+// Flag para usar o io_uring (Linux) como motor de eventos.
+// 1 = o remetente envia cada rajada como uma cadeia de sendmsg no anel e espera os ACKs com um
+// recvmsg multishot e operações de timeout, no lugar do select + recvfrom; o receptor recebe
+// pelo mesmo mecanismo e grava o arquivo com escritas assíncronas no anel. 0 = select e
+// sendmmsg / recvmmsg. Desativada automaticamente se o kernel não suportar.
+int io_uring_enabled = FALSE;
+
+// Flag para ativar a descoberta do MTU do caminho (PMTU) no remetente.
+// 1 = junto com o PKT_START, o remetente envia sondagens com DF de vários tamanhos e usa como
+// segmento o maior que o receptor confirmar (até payload_size, que passa a ser o teto); a
+// sondagem se repete durante a transferência e quando um EMSGSIZE (ICMP) ou timeouts
+// seguidos indicam que o caminho encolheu. 0 = payload_size fixo.
+// O receptor sempre responde às sondagens.
+int pmtu_discovery_enabled = FALSE;
+
+// Flag para ativar a correção antecipada de erros (FEC) no remetente.
+// 1 = a cada fec_block_size pacotes de dados, o remetente envia pacotes de paridade (rdt_fec.c)
+// com os quais o receptor reconstrói os pacotes perdidos do bloco sem esperar a retransmissão;
+// o número de paridades acompanha a perda medida pelo receptor e informada nos ACKs.
+// 0 = apenas retransmissão. Negociada no PKT_START: o receptor sempre a aceita.
+int fec_enabled = FALSE;
+int fec_block_size = FEC_MAX_DATA;
+
+// Flag para ativar os ACKs atrasados no receptor.
+// 1 = os pacotes em ordem são confirmados por um único ACK cumulativo a cada delayed_ack_count
+// pacotes ou quando o mais antigo deles espera delayed_ack_timeout segundos; pacotes fora de
+// ordem, duplicados ou que preenchem uma lacuna continuam gerando ACK imediato. Reduz o tráfego
+// de ACKs no caminho de volta, o gargalo em enlaces assimétricos. O timer deve ficar bem abaixo
+// de MIN_TIMEOUT, pois atrasa as amostras de RTT do remetente.
+// 0 = um ACK por pacote (ou por lote, com a E/S em lote).
+int delayed_ack_enabled = FALSE;
+int delayed_ack_count = 2;
+double delayed_ack_timeout = 0.04;
+
+// Flag para ativar o controle de fluxo.
+// 1 = cada ACK do receptor anuncia quantos pacotes além dele ainda cabem no buffer de escrita
+// e no buffer de reordenação (PKT_F_RWND), e o remetente limita os pacotes em trânsito ao
+// menor entre a janela de congestionamento e a anunciada; com a janela fechada, sonda o
+// receptor com um pacote a intervalos crescentes. Com o io_uring, o receptor não espera o
+// disco enquanto houver espaço no buffer, e a janela fecha se o disco não acompanhar.
+// 0 = a janela depende só do controle de congestionamento.
+int flow_control_enabled = TRUE;
+
+// Flag para ativar o pacing no remetente.
+// 1 = em vez de enviar em rajada todos os pacotes que a janela permite, o remetente os espaça
+// no ritmo de janela / RTT suavizado (com folga de PACING_GAIN, ou PACING_GAIN_SS no slow
+// start), esperando a vez de cada pacote na mesma espera dos ACKs e timeouts. Evita que as
+// rajadas estourem a fila do roteador em enlaces estreitos. 0 = rajadas do tamanho da janela.
+int pacing_enabled = FALSE;
+
+// Flag para ativar a retomada de transferências (rdt_resume.h).
+// 1 = o PKT_START propõe a retomada: o intervalo é gravado sem truncar o arquivo do receptor,
+// que registra em um checkpoint o hash de cada bloco gravado. O remetente (client_rdt) consulta
+// antes esses hashes e envia só os blocos que faltam ou que diferem do arquivo local.
+// 0 = o arquivo é sempre enviado por inteiro e substitui o do receptor.
+int resume_enabled = FALSE;
+
+// Flag para ativar a compressão do fluxo de dados (rdt_compress.h).
+// 1 = o PKT_START propõe a compressão LZ4 com aceleração compress_level; se o receptor aceitar,
+// o remetente (client_rdt) envia o arquivo em quadros comprimidos por uma thread própria, e os
+// quadros que não diminuem vão sem compressão. Reduz os bytes no enlace de subida para arquivos
+// de texto, logs e CSVs. 0 = os bytes do arquivo vão sem alteração.
+int compress_enabled = FALSE;
+int compress_level = 1;
+
+// Flag para ativar o envio por diferença (rdt_delta.h).
+// 1 = o remetente (client_rdt) consulta as assinaturas dos blocos da cópia do arquivo no
+// receptor e o PKT_START propõe o envio por diferença: só os trechos que mudaram vão pelo
+// enlace, e o restante é copiado pelo receptor da cópia antiga. Um arquivo que mudou pouco
+// custa quase só as assinaturas. Usa um único fluxo e não se combina com a retomada.
+// 0 = o arquivo é sempre enviado por inteiro.
+int delta_enabled = FALSE;
+
+// Contadores e trace de cada conexão (rdt_log.h).
+// stats_interval > 0 imprime os contadores a cada stats_interval segundos durante a
+// transferência. Com trace_path, cada transferência guarda os seus últimos trace_capacity
+// eventos em um anel e os grava ao terminar em <trace_path>.<porta local>-<porta remota>.
+double stats_interval = 0;
+const char *trace_path = NULL;
+int trace_capacity = 1 << 16;
+
+// Algoritmo de verificação de integridade dos pacotes.
+// CSUM_CRC32C = CRC32C (Castagnoli), com as instruções crc32 do SSE4.2 quando o processador as
+// tiver e slicing-by-8 em software nos demais; detecta qualquer rajada de até 32 bits corrompidos.
+// CSUM_INET = soma de 16 bits em complemento de um (Internet checksum).
+// É global, e não uma flag da conexão, porque o PKT_START é verificado antes de a conexão
+// existir. Deve ter o mesmo valor no cliente e no servidor.
+int checksum_algorithm = CSUM_CRC32C;
+
+// Acumula em sum a soma de 16 bits de nbytes de buf. Somas parciais de trechos de tamanho
+// par podem ser encadeadas, o que permite calcular o checksum de header e payload separados.
+static long csum_add(const void *data, int nbytes, long sum) {
+    const unsigned short *buf = data;
     while (nbytes > 1) {
         sum += *buf++;
         nbytes -= 2;
@@ -47,289 +203,1637 @@ unsigned short checksum(unsigned short *buf, int nbytes) {
     if (nbytes == 1) {
         sum += *(unsigned char *)buf;
     }
+    return sum;
+}
+
+// Dobra os carries da soma e retorna o complemento (valor final do checksum).
+static unsigned short csum_fold(long sum) {
     while (sum >> 16)
         sum = (sum & 0xffff) + (sum >> 16);
     return (unsigned short)(~sum);
 }
 
-// Verifica se o pacote está corrompido.
+#define CRC32C_POLY 0x82f63b78 // Polinômio de Castagnoli, bits refletidos
+
+static uint32_t crc32c_table[8][256]; // Tabelas do slicing-by-8
+static uint32_t (*crc32c_impl)(uint32_t crc, const unsigned char *buf, size_t len); // Implementação escolhida
+
+// CRC32C em software, 8 bytes por iteração (slicing-by-8): cada tabela dá a contribuição de
+// um byte deslocado de 0 a 7 posições, e os oito resultados são combinados com xor.
+static uint32_t crc32c_slice8(uint32_t crc, const unsigned char *buf, size_t len) {
+    while (len > 0 && ((uintptr_t)buf & 7)) { // Alinha o buffer em 8 bytes
+        crc = crc32c_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t w; // Próximos 8 bytes (little-endian)
+        memcpy(&w, buf, 8);
+        w ^= crc;
+        crc = crc32c_table[7][w & 0xff] ^ crc32c_table[6][(w >> 8) & 0xff] ^
+              crc32c_table[5][(w >> 16) & 0xff] ^ crc32c_table[4][(w >> 24) & 0xff] ^
+              crc32c_table[3][(w >> 32) & 0xff] ^ crc32c_table[2][(w >> 40) & 0xff] ^
+              crc32c_table[1][(w >> 48) & 0xff] ^ crc32c_table[0][w >> 56];
+        buf += 8;
+        len -= 8;
+    }
+    while (len > 0) {
+        crc = crc32c_table[0][(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+        len--;
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+// CRC32C com a instrução crc32 do SSE4.2: 8 bytes por instrução.
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_sse42(uint32_t crc, const unsigned char *buf, size_t len) {
+    uint64_t c = crc;
+    while (len >= 8) {
+        uint64_t w;
+        memcpy(&w, buf, 8);
+        c = _mm_crc32_u64(c, w);
+        buf += 8;
+        len -= 8;
+    }
+    crc = (uint32_t)c;
+    while (len > 0) {
+        crc = _mm_crc32_u8(crc, *buf++);
+        len--;
+    }
+    return crc;
+}
+#endif
+
+// Monta as tabelas do slicing-by-8 e escolhe a implementação do CRC32C ao carregar o programa,
+// antes de qualquer thread usá-las.
+__attribute__((constructor))
+static void crc32c_init(void) {
+    for (int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (CRC32C_POLY & -(crc & 1));
+        crc32c_table[0][i] = crc;
+    }
+    for (int i = 0; i < 256; i++)
+        for (int t = 1; t < 8; t++)
+            crc32c_table[t][i] = crc32c_table[0][crc32c_table[t - 1][i] & 0xff] ^ (crc32c_table[t - 1][i] >> 8);
+    crc32c_impl = crc32c_slice8;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2"))
+        crc32c_impl = crc32c_sse42;
+#endif
+}
+
+// CRC32C de len bytes de buf, continuando de crc (0 no primeiro trecho).
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    return ~crc32c_impl(~crc, buf, len);
+}
+
+// CRC32C calculado sempre em software (slicing-by-8).
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len) {
+    return ~crc32c_slice8(~crc, buf, len);
+}
+
+// Função de checksum: calcula a soma de verificação do buffer com o algoritmo selecionado.
+uint32_t checksum(const void *buf, int nbytes) {
+    if (checksum_algorithm == CSUM_CRC32C)
+        return crc32c(0, buf, nbytes);
+    return csum_fold(csum_add(buf, nbytes, 0));
+}
+
+// Checksum de um pacote, já no formato do campo csum: header, com o campo csum tomado como
+// zero, seguido de len bytes de payload. Só o header é copiado; o payload é lido onde estiver.
+// O CRC32C vai na ordem de bytes da rede; a soma de 16 bits, calculada sobre palavras na ordem
+// do host, vai como está nos dois primeiros bytes (RFC 1071), o que dá os mesmos bytes em
+// qualquer host.
+static uint32_t pkt_checksum(const hdr *h, const void *payload, int len) {
+    hdr t = *h;
+    t.csum = 0;
+    if (checksum_algorithm == CSUM_CRC32C)
+        return htonl(crc32c(crc32c(0, &t, sizeof(hdr)), payload, len));
+    uint16_t sum = csum_fold(csum_add(payload, len, csum_add(&t, sizeof(hdr), 0)));
+    uint32_t field = 0;
+    memcpy(&field, &sum, sizeof(sum));
+    return field;
+}
+
+// Verifica se o pacote está corrompido. Pacotes de outra versão do formato também são descartados.
 int iscorrupted(pkt *pr) {
-    pkt copy = *pr;
-    unsigned short recv_csum = copy.h.csum;
-    copy.h.csum = 0;
-    unsigned short calc_csum = checksum((unsigned short *)&copy, copy.h.pkt_size);
-    return (recv_csum != calc_csum);
+    int size = pkt_size(pr); // Tamanho informado no header
+    if (pr->h.version != RDT_VERSION || size < (int)sizeof(hdr) || size > (int)sizeof(pkt))
+        return TRUE;
+    return pr->h.csum != pkt_checksum(&pr->h, pr->msg, size - sizeof(hdr));
 }
 
-// Cria um pacote com o header, copia o payload (se houver) e calcula o checksum.
-int make_pkt(pkt *p, htype_t type, hseq_t seqnum, void *msg, int msg_len) {
+// Preenche o header de um pacote de size bytes (sem o checksum).
+static void hdr_init(hdr *h, htype_t type, hseq_t seqnum, int size) {
+    h->version = RDT_VERSION;
+    h->pkt_type = type;
+    h->flags = 0;
+    h->size = htons(size);
+    h->seq = htonl(seqnum);
+    h->csum = 0;
+}
+
+// Cria um pacote com as flags do header, copia o payload (se houver) e calcula o checksum.
+static int build_pkt(pkt *p, htype_t type, int flags, hseq_t seqnum, const void *msg, int msg_len) {
     if (msg_len > MAX_MSG_LEN) {
-        fprintf(stderr, "make_pkt: tamanho da mensagem %d excede MAX_MSG_LEN %d\n", msg_len, MAX_MSG_LEN);
+        fprintf(stderr, "build_pkt: tamanho da mensagem %d excede MAX_MSG_LEN %d\n", msg_len, MAX_MSG_LEN);
         return ERROR;
     }
-    p->h.pkt_size = sizeof(hdr);
-    p->h.csum = 0;
-    p->h.pkt_type = type;
-    p->h.pkt_seq = seqnum;
-    if (msg != NULL && msg_len > 0) {
-        p->h.pkt_size += msg_len;
-        memset(p->msg, 0, MAX_MSG_LEN);
+    if (msg == NULL || msg_len < 0)
+        msg_len = 0;
+    hdr_init(&p->h, type, seqnum, sizeof(hdr) + msg_len);
+    p->h.flags = htons(flags);
+    if (msg_len > 0)
         memcpy(p->msg, msg, msg_len);
-    }
-    p->h.csum = checksum((unsigned short *)p, p->h.pkt_size);
+    p->h.csum = pkt_checksum(&p->h, msg_len > 0 ? p->msg : NULL, msg_len);
     return SUCCESS;
 }
 
+// Cria um pacote com o header, copia o payload (se houver) e calcula o checksum.
+int make_pkt(pkt *p, htype_t type, hseq_t seqnum, void *msg, int msg_len) {
+    return build_pkt(p, type, 0, seqnum, msg, msg_len);
+}
+
 // Verifica se o pacote ACK recebido possui o número de sequência esperado.
 int has_ackseq(pkt *p, hseq_t seqnum) {
-    if (p->h.pkt_type != PKT_ACK || p->h.pkt_seq != seqnum)
+    if (p->h.pkt_type != PKT_ACK || pkt_seq(p) != seqnum)
         return FALSE;
     return TRUE;
 }
 
-// Função rdt_send: envia um buffer segmentado usando uma janela de transmissão.
-// Se dynamic_window_enabled for 1, a janela é ajustada dinamicamente.
-// O fast retransmit é acionado se a flag fast_retransmit_enabled estiver ativada.
-int rdt_send(int sockfd, void *buf, int buf_len, struct sockaddr_in *dst) {
-    int chunk_size = MAX_MSG_LEN; // Tamanho máximo do payload
-    int num_segments = (buf_len + chunk_size - 1) / chunk_size; // Número de segmentos
-    double send_time[num_segments]; // Vetor para armazenar o tempo de envio de cada pacote
-    double sample_rtt; // Variável para armazenar o SampleRTT
-    double estimate_rtt = 0.100000; // Valor inicial do EstimateRTT
-    double dev_rtt = 0.005000; // Valor inicial do DevRTT
-    
-    pkt *packets = malloc(num_segments * sizeof(pkt)); // Vetor de pacotes
-    if (!packets) { // Verifica se a alocação foi bem-sucedida
-        perror("rdt_send: malloc");
-        return ERROR;
-    }
-    
-    // Criação dos pacotes com os dados.
-    for (int i = 0; i < num_segments; i++) {
-        int offset = i * chunk_size; // Deslocamento no buffer
-        int remaining = buf_len - offset; // Bytes restantes
-        int seg_len = (remaining > chunk_size) ? chunk_size : remaining; // Tamanho do segmento
-        if (make_pkt(&packets[i], PKT_DATA, _snd_seqnum + i, (char *)buf + offset, seg_len) < 0) { // Cria o pacote
-            free(packets);
+// Verifica se o pacote de dados recebido possui o número de sequência esperado.
+int has_dataseqnum(pkt *p, hseq_t seqnum) {
+    if (p->h.pkt_type != PKT_DATA || pkt_seq(p) != seqnum)
+        return FALSE;
+    return TRUE;
+}
+
+// Cria um ACK para seqnum. Se sack_enabled estiver ativo, anexa como payload os intervalos
+// de pacotes guardados no buffer de reordenação acima do próximo pacote esperado. Se rwnd não
+// for negativo, acrescenta a janela de recepção e marca o ACK com PKT_F_RWND; se fec_loss não
+// for negativo, acrescenta por último a perda medida pela FEC (por mil) e marca com PKT_F_FEC.
+// No Selective Repeat, o ACK do último pacote entregue em ordem é marcado com PKT_F_CUM e
+// confirma também os anteriores, cujos ACKs podem ter sido atrasados ou perdidos.
+static int make_ack(rdt_conn *c, pkt *ack, hseq_t seqnum, pkt *rcv_buffer, int rwnd, int fec_loss) {
+    sack_block blocks[MAX_SACK_BLOCKS + 1]; // Blocos SACK (e espaço para a janela e a perda informada)
+    int nblocks = 0; // Número de blocos preenchidos
+    hseq_t rcv_seqnum = c->rcv_seqnum; // Próximo pacote esperado
+    if (c->sack_enabled && rcv_buffer != NULL) {
+        // Percorre a janela de recepção agrupando sequências consecutivas presentes no buffer.
+        for (hseq_t seq = rcv_seqnum + 1; seq < rcv_seqnum + SR_RCV_WINDOW && nblocks < MAX_SACK_BLOCKS; seq++) {
+            if (pkt_size(&rcv_buffer[seq % SR_RCV_WINDOW]) == 0)
+                continue;
+            blocks[nblocks].start = htonl(seq); // Início do intervalo, na ordem da rede
+            while (seq + 1 < rcv_seqnum + SR_RCV_WINDOW && pkt_size(&rcv_buffer[(seq + 1) % SR_RCV_WINDOW]) != 0)
+                seq++;
+            blocks[nblocks].end = htonl(seq); // Fim do intervalo
+            nblocks++;
+        }
+    }
+    int len = nblocks * sizeof(sack_block); // Tamanho do payload
+    int flags = (c->selective_repeat_enabled && seqnum == rcv_seqnum - 1) ? PKT_F_CUM : 0; // Flags do ACK
+    if (rwnd >= 0) {
+        uint16_t win = htons(rwnd > 0xffff ? 0xffff : rwnd); // Janela de recepção
+        memcpy((char *)blocks + len, &win, sizeof(win));
+        len += sizeof(win);
+        flags |= PKT_F_RWND;
+    }
+    if (fec_loss >= 0) {
+        uint16_t loss = htons(fec_loss > 1000 ? 1000 : fec_loss); // Perda por mil
+        memcpy((char *)blocks + len, &loss, sizeof(loss));
+        len += sizeof(loss);
+        flags |= PKT_F_FEC;
+    }
+    return build_pkt(ack, PKT_ACK, flags, seqnum, len > 0 ? blocks : NULL, len);
+}
+
+// Retorna o instante atual em segundos, em relógio monotônico (imune a ajustes do relógio do sistema).
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Inicializa o contexto de uma conexão no socket sockfd com o outro lado em peer (ou
+// NULL, se ainda desconhecido). Flags e algoritmo de congestionamento vêm dos valores globais.
+void rdt_conn_init(rdt_conn *c, int sockfd, struct sockaddr_in *peer) {
+    memset(c, 0, sizeof(rdt_conn));
+    c->sockfd = sockfd;
+    if (peer)
+        c->peer = *peer;
+    c->snd_seqnum = INITIAL_SEQNUM;
+    c->rcv_seqnum = INITIAL_SEQNUM;
+    c->static_timeout = current_timeout_sec + current_timeout_usec / 1e6;
+    // Timeout estático, ou valor inicial do dinâmico até a primeira amostra de RTT (RFC 6298).
+    c->rto = dynamic_timeout_enabled ? INITIAL_TIMEOUT : c->static_timeout;
+    c->window_size = STATIC_WINDOW_SIZE;
+    c->payload_size = payload_size < 1 ? 1 : payload_size > MAX_MSG_LEN ? MAX_MSG_LEN : payload_size;
+    c->payload_max = c->payload_size;
+    c->pmtu_mode = IP_PMTUDISC_WANT; // Padrão do Linux para UDP
+    c->pmtu_failed = 0;
+    c->biterror_inject = biterror_inject;
+    c->dynamic_window_enabled = dynamic_window_enabled;
+    c->dynamic_timeout_enabled = dynamic_timeout_enabled;
+    c->fast_retransmit_enabled = fast_retransmit_enabled;
+    c->selective_repeat_enabled = selective_repeat_enabled;
+    c->sack_enabled = sack_enabled;
+    c->batch_io_enabled = batch_io_enabled;
+    c->udp_offload_enabled = udp_offload_enabled;
+    c->direct_io_enabled = direct_io_enabled;
+    c->io_uring_enabled = io_uring_enabled;
+    c->pmtu_discovery_enabled = pmtu_discovery_enabled;
+    c->fec_enabled = fec_enabled;
+    c->delayed_ack_enabled = delayed_ack_enabled;
+    c->flow_control_enabled = flow_control_enabled;
+    c->pacing_enabled = pacing_enabled;
+    c->resume_enabled = resume_enabled;
+    c->compress_enabled = compress_enabled;
+    c->compress_level = compress_level < 1 ? 1 : compress_level;
+    c->delta_enabled = delta_enabled;
+    c->delta_block = 0;
+    c->delta_digest = 0;
+    c->delayed_ack_count = delayed_ack_count < 1 ? 1 : delayed_ack_count;
+    c->delayed_ack_timeout = delayed_ack_timeout;
+    c->cc_algorithm = cc_algorithm;
+    c->stats_interval = stats_interval;
+    c->trace_path = trace_path;
+    c->trace_capacity = trace_capacity < 1 ? 1 : trace_capacity;
+    
+    // Semente do gerador aleatório: relógio, endereço do contexto e socket, para que
+    // conexões abertas ao mesmo tempo não gerem a mesma sequência.
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    c->rng = ((uint64_t)ts.tv_sec * 1000000007u) ^ ts.tv_nsec ^ ((uint64_t)(uintptr_t)c << 16) ^ sockfd;
+    if (c->rng == 0)
+        c->rng = 1;
+}
+
+void rdt_stats_get(const rdt_conn *c, rdt_stats *out) {
+    *out = c->stats;
+}
+
+// Imprime os contadores da conexão se o intervalo de stats_interval tiver passado.
+static void stats_tick(rdt_conn *c, const char *who) {
+    double now = now_sec();
+    if (c->stats_next == 0) {
+        c->stats_next = now + c->stats_interval;
+    } else if (now >= c->stats_next) {
+        char prefix[64]; // Origem da linha
+        snprintf(prefix, sizeof(prefix), "%s: Contadores:", who);
+        rdt_stats_dump(stdout, prefix, &c->stats);
+        c->stats_next = now + c->stats_interval;
+    }
+}
+
+// Registra um evento no trace da conexão, se houver, com a janela e o RTO atuais.
+#define TRACE(c, type, seq, rtt) do {                                                   \
+        if ((c)->trace)                                                                 \
+            rdt_trace_add((c)->trace, type, seq, (c)->window_size, (c)->rto, rtt);      \
+    } while (0)
+
+// Abre o anel do trace no início de uma transferência (trace_path definido).
+static void trace_begin(rdt_conn *c) {
+    if (c->trace_path && !c->trace)
+        c->trace = rdt_trace_open(c->trace_capacity);
+}
+
+// Grava e libera o anel do trace ao fim de uma transferência.
+static void trace_end(rdt_conn *c) {
+    if (!c->trace)
+        return;
+    struct sockaddr_in local; // Porta local, que distingue os fluxos paralelos de um remetente
+    socklen_t len = sizeof(local);
+    if (getsockname(c->sockfd, (struct sockaddr *)&local, &len) < 0)
+        local.sin_port = 0;
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.%d-%d", c->trace_path, ntohs(local.sin_port), ntohs(c->peer.sin_port));
+    if (rdt_trace_write(c->trace, path) == SUCCESS)
+        RDT_LOG(RDT_LOG_INFO, "rdt: Trace gravado em %s.\n", path);
+    rdt_trace_close(c->trace);
+    c->trace = NULL;
+}
+
+// Gerador aleatório da conexão (xorshift64*): não compartilha estado entre threads, ao
+// contrário de rand().
+static uint32_t conn_rand(rdt_conn *c) {
+    c->rng ^= c->rng >> 12;
+    c->rng ^= c->rng << 25;
+    c->rng ^= c->rng >> 27;
+    return (uint32_t)((c->rng * 2685821657736338717ull) >> 32);
+}
+
+// Preenche iov[0] com o header e iov[1] com o payload do pacote: o próprio p->msg ou, no
+// envio sem cópia, a região do usuário apontada por payload.
+static void pkt_iov(pkt *p, const char *payload, struct iovec *iov) {
+    iov[0].iov_base = &p->h;
+    iov[0].iov_len = sizeof(hdr);
+    iov[1].iov_base = (void *)(payload ? payload : p->msg);
+    iov[1].iov_len = pkt_size(p) - sizeof(hdr);
+}
+
+// MTUs sondados na descoberta do PMTU, em ordem decrescente: quadro jumbo, Ethernet, PPPoE,
+// VXLAN, túneis comuns e o mínimo do IPv6.
+static const int pmtu_candidates[] = {9000, 1500, 1492, 1450, 1400, 1280};
+#define PMTU_CANDIDATES     ((int)(sizeof(pmtu_candidates) / sizeof(pmtu_candidates[0])))
+
+// Payload de um pacote de dados que ocupa exatamente um datagrama IP de mtu bytes.
+static int mtu_payload(int mtu) {
+    return mtu - IP_UDP_OVERHEAD - (int)sizeof(hdr);
+}
+
+// Menor payload usado pela descoberta: o do menor MTU sondado.
+static int pmtu_floor(rdt_conn *c) {
+    int floor = mtu_payload(pmtu_candidates[PMTU_CANDIDATES - 1]);
+    return floor < c->payload_max ? floor : c->payload_max;
+}
+
+// Define o modo de descoberta do PMTU do socket para os pacotes de dados (IP_PMTUDISC_DO:
+// DF ligado e EMSGSIZE acima do PMTU conhecido; IP_PMTUDISC_DONT: fragmenta se preciso).
+static void set_pmtu_mode(rdt_conn *c, int mode) {
+    if (setsockopt(c->sockfd, IPPROTO_IP, IP_MTU_DISCOVER, &mode, sizeof(mode)) < 0)
+        perror("rdt: setsockopt(IP_MTU_DISCOVER)");
+    c->pmtu_mode = mode;
+}
+
+// Envia um PKT_PROBE do tamanho de cada MTU candidato cujo payload esteja acima de above e
+// dentro do aceito pelo receptor. As sondagens saem com DF e sem consultar o PMTU guardado
+// pelo kernel (IP_PMTUDISC_PROBE); as que excedem o MTU da interface falham com EMSGSIZE e
+// são ignoradas. Tamanhos a partir do último recusado ficam de fora até a próxima sondagem
+// periódica. O ACK de cada sondagem tem o MTU como número de sequência.
+static void pmtu_probe_send(rdt_conn *c, int above) {
+    static const char padding[MAX_MSG_LEN]; // Payload das sondagens
+    int mode = IP_PMTUDISC_PROBE;
+    setsockopt(c->sockfd, IPPROTO_IP, IP_MTU_DISCOVER, &mode, sizeof(mode));
+    for (int i = 0; i < PMTU_CANDIDATES; i++) {
+        int len = mtu_payload(pmtu_candidates[i]); // Payload da sondagem
+        if (len <= above || len > c->payload_max || (c->pmtu_failed && len >= c->pmtu_failed))
+            continue;
+        pkt probe; // Pacote de sondagem
+        if (build_pkt(&probe, PKT_PROBE, 0, pmtu_candidates[i], padding, len) < 0)
+            continue;
+        if (sendto(c->sockfd, &probe, pkt_size(&probe), 0, (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0
+            && errno != EMSGSIZE)
+            perror("rdt: sendto(PKT_PROBE)");
+    }
+    set_pmtu_mode(c, c->pmtu_mode);
+}
+
+// Trata o ACK de uma sondagem: o caminho comporta o MTU sondado, e os próximos segmentos
+// passam a usá-lo se for maior que o atual. ACKs atrasados de tamanhos que o kernel já
+// recusou são ignorados: o PMTU guardado por ele vale para os dados mesmo que a sondagem passe.
+static void pmtu_probe_ack(rdt_conn *c, pkt *ack) {
+    int len = mtu_payload(pkt_seq(ack)); // Payload confirmado
+    if (len <= c->payload_size || len > c->payload_max || (c->pmtu_failed && len >= c->pmtu_failed))
+        return;
+    RDT_LOG(RDT_LOG_INFO, "rdt_send: Sondagem de MTU %d confirmada, payload de %d para %d bytes.\n", pkt_seq(ack), c->payload_size, len);
+    c->payload_size = len;
+}
+
+// O caminho encolheu (EMSGSIZE após um ICMP, ou timeouts seguidos): os novos segmentos
+// voltam ao menor MTU sondado, os pacotes maiores já no buffer seguem fragmentados pelo IP e
+// os MTUs maiores são sondados de novo. Retorna TRUE se o envio recusado deve ser repetido.
+static int pmtu_shrink(rdt_conn *c) {
+    if (!c->pmtu_discovery_enabled || c->pmtu_mode == IP_PMTUDISC_DONT)
+        return FALSE;
+    int floor = pmtu_floor(c); // Novo payload
+    RDT_LOG(RDT_LOG_INFO, "rdt_send: Caminho reduzido, payload de %d para %d bytes; sondando novamente.\n", c->payload_size, floor);
+    c->pmtu_failed = c->payload_size;
+    c->payload_size = floor;
+    c->pmtu_fallback_end = c->snd_seqnum;
+    set_pmtu_mode(c, IP_PMTUDISC_DONT);
+    pmtu_probe_send(c, floor);
+    return TRUE;
+}
+
+// Responde a um PKT_PROBE recebido de dst com um ACK marcado com PKT_F_PROBE. Retorna ERROR se
+// o pacote não for uma sondagem íntegra.
+int rdt_probe_reply(int sockfd, struct sockaddr_in *dst, pkt *probe, int len) {
+    pkt ack; // Pacote ACK
+    if (len < (int)sizeof(hdr) || probe->h.pkt_type != PKT_PROBE || iscorrupted(probe))
+        return ERROR;
+    if (build_pkt(&ack, PKT_ACK, PKT_F_PROBE, pkt_seq(probe), NULL, 0) < 0)
+        return ERROR;
+    if (sendto(sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr *)dst, sizeof(struct sockaddr_in)) < 0) {
+        perror("rdt: sendto(PKT_PROBE ACK)");
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+// Nome de arquivo recebido do outro lado: só é aceito um nome simples, gravado em receive/
+// (sem '/', e diferente de "." e ".."), para que nenhum pacote alcance caminhos fora dele.
+static int safe_filename(const char *name) {
+    return name[0] != '\0' && strchr(name, '/') == NULL && strcmp(name, ".") != 0 && strcmp(name, "..") != 0;
+}
+
+// Envia um pacote de dados, aplicando a injeção de erro se biterror_inject estiver ativo.
+// O pacote original não é alterado, permitindo retransmiti-lo depois; só a injeção de erro
+// trabalha sobre uma cópia.
+static int send_data_pkt(rdt_conn *c, pkt *p, const char *payload) {
+    struct iovec iov[2]; // Header e payload
+    pkt temp_pkt; // Pacote temporário
+    pkt_iov(p, payload, iov);
+    
+    // Injeção de erro (aplicada de forma randômica, se biterror_inject estiver ativo)
+    if (c->biterror_inject) {
+        if (conn_rand(c) % 100 < 20) {  // 20% de chance
+            RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Injetando erro no pacote seq %d (tentativa)\n", pkt_seq(p));
+            temp_pkt.h = p->h;
+            memset(temp_pkt.msg, 0, MAX_MSG_LEN);
+            temp_pkt.h.csum = checksum(&temp_pkt, pkt_size(&temp_pkt));
+            pkt_iov(&temp_pkt, NULL, iov);
+        }
+    }
+    
+    struct msghdr msg; // Mensagem com o header e o payload
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = &c->peer;
+    msg.msg_namelen = sizeof(struct sockaddr_in);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    int ns = sendmsg(c->sockfd, &msg, 0); // Envia o pacote
+    if (ns < 0 && errno == EMSGSIZE && pmtu_shrink(c)) // Maior que o caminho: segue fragmentado
+        ns = sendmsg(c->sockfd, &msg, 0);
+    if (ns < 0) { // Verifica erros
+        perror("rdt_send: sendmsg(PKT_DATA)");
+        return ERROR;
+    }
+    return ns;
+}
+
+// Envia n pacotes para o outro lado da conexão. Com batch_io_enabled, todos vão ao kernel em uma única
+// chamada sendmmsg; caso contrário (ou se sendmmsg não estiver disponível), um sendto
+// por pacote. is_data indica pacotes de dados, sujeitos à injeção de erro. Se payloads não for
+// NULL, payloads[i] (quando não nulo) aponta para o payload do pacote i fora do pkt, e cada
+// datagrama é montado pelo kernel a partir do header e dessa região, sem cópia.
+static int send_pkts(rdt_conn *c, pkt **pkts, const char **payloads, int n, int is_data) {
+    int sockfd = c->sockfd; // Socket da conexão
+    struct sockaddr_in *dst = &c->peer; // Destino
+    int sent = 0; // Pacotes já entregues ao kernel
+    
+    // UDP GSO: cada sequência de pacotes de mesmo tamanho (o último pode ser menor) vira um
+    // único datagrama; o iovec aponta para os pacotes originais e o kernel faz a divisão.
+    // Pacotes maiores que o caminho (anteriores a uma redução do PMTU) seguem pelo envio normal.
+    while (c->udp_offload_enabled && is_data && !c->biterror_inject && sent < n - 1
+           && pkt_size(pkts[sent]) <= (int)sizeof(hdr) + c->payload_size) {
+        int seg_size = pkt_size(pkts[sent]); // Tamanho de cada pacote do datagrama
+        int run = 1; // Pacotes na sequência
+        while (sent + run < n && run < GSO_MAX_SEGMENTS && (run + 1) * seg_size <= GSO_MAX_BYTES
+               && pkt_size(pkts[sent + run]) <= seg_size) {
+            run++;
+            if (pkt_size(pkts[sent + run - 1]) < seg_size) // Um pacote menor encerra a sequência
+                break;
+        }
+        struct iovec iov[2 * GSO_MAX_SEGMENTS]; // Header e payload de cada pacote
+        for (int i = 0; i < run; i++)
+            pkt_iov(pkts[sent + i], payloads ? payloads[sent + i] : NULL, &iov[2 * i]);
+        char control[CMSG_SPACE(sizeof(uint16_t))]; // Mensagem de controle com o tamanho do segmento
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        memset(control, 0, sizeof(control));
+        msg.msg_name = dst;
+        msg.msg_namelen = sizeof(struct sockaddr_in);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2 * run;
+        if (run > 1) {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+            struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+            cm->cmsg_level = SOL_UDP;
+            cm->cmsg_type = UDP_SEGMENT;
+            cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t *)CMSG_DATA(cm) = seg_size;
+        }
+        if (sendmsg(sockfd, &msg, 0) < 0) {
+            // Com DF, o kernel recusa segmentos maiores que o PMTU (EMSGSIZE ou EINVAL no GSO).
+            if ((errno == EMSGSIZE || errno == EINVAL) && seg_size > (int)sizeof(hdr) + pmtu_floor(c) && pmtu_shrink(c))
+                continue;
+            if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT || errno == EOPNOTSUPP) { // Sem suporte a GSO
+                RDT_LOG(RDT_LOG_INFO, "rdt: UDP GSO indisponível (%s), desativando offload.\n", strerror(errno));
+                c->udp_offload_enabled = FALSE;
+                break;
+            }
+            perror("rdt: sendmsg(UDP_SEGMENT)");
             return ERROR;
         }
+        sent += run;
     }
     
-    // Ajusta a janela de transmissão: se dinâmica, usa current_window_size; caso contrário, STATIC_WINDOW_SIZE.
-    current_window_size = dynamic_window_enabled ? current_window_size : STATIC_WINDOW_SIZE;
+    // io_uring: os pacotes restantes formam uma cadeia de sendmsg no anel, submetida com uma
+    // única io_uring_enter. A submissão é imediata: adiá-la até a próxima espera atrasa o
+    // relógio de ACKs e junta rajadas maiores que a fila do receptor. ACKs são copiados, pois
+    // o vetor de ACKs do receptor é reutilizado no lote seguinte.
+    if (c->uring && sent < n && !(is_data && c->biterror_inject)) {
+        struct iovec iov[2 * (n - sent)]; // Header e payload de cada pacote
+        for (int i = sent; i < n; i++)
+            pkt_iov(pkts[i], payloads ? payloads[i] : NULL, &iov[2 * (i - sent)]);
+        if (rdt_uring_send(c->uring, dst, iov, n - sent, !is_data) < 0 || rdt_uring_submit(c->uring) < 0)
+            return ERROR;
+        return n;
+    }
     
-    int base = 0; // Base da janela
-    int next_seq = 0; // Próximo número de sequência
-    struct timeval timeout; // Timeout para select
-    timeout.tv_sec = current_timeout_sec; // Timeout em segundos
-    timeout.tv_usec = current_timeout_usec; // Timeout em microssegundos
-    struct timeval send; // Variáveis para medir o tempo de envio
-    struct timeval recv; // Variáveis para medir o tempo de recebimento
-    fd_set readfds; // Conjunto de descritores de arquivo para select
-    int ns, nr; // Número de bytes enviados e recebidos
-    struct sockaddr_in ack_addr; // Endereço do ACK
-    socklen_t addrlen; // Tamanho do endereço
-    int dw_count = 5; // Contador para janela dinâmica
-    // Variáveis para fast retransmission
-    hseq_t last_ack_seq = 0; // Último número de sequência ACK recebido
-    int dup_ack_count = 0; // Contador de ACKs duplicados
-    hseq_t fastRetransmittedSeq = 0; // Número de sequência do pacote retransmitido
-    
-    while (base < num_segments) {
-        // Envia os pacotes dentro da janela.
-        while (next_seq < num_segments && next_seq < base + current_window_size) { // Enquanto houver espaço na janela
-            pkt temp_pkt; // Pacote temporário
-            memcpy(&temp_pkt, &packets[next_seq], sizeof(pkt)); // Copia o pacote
-            
-            // Injeção de erro (aplicada de forma randômica, se biterror_inject estiver ativo)
-            if (biterror_inject) {
-                if (rand() % 100 < 20) {  // 20% de chance
-                    printf("rdt_send: Injetando erro no pacote seq %d (tentativa)\n", temp_pkt.h.pkt_seq);
-                    memset(temp_pkt.msg, 0, MAX_MSG_LEN);
-                    temp_pkt.h.csum = checksum((unsigned short *)&temp_pkt, temp_pkt.h.pkt_size);
+    // A injeção de erro altera uma cópia de cada pacote, então usa o caminho por pacote.
+    if (c->batch_io_enabled && n - sent > 1 && !(is_data && c->biterror_inject)) {
+        struct mmsghdr msgs[n]; // Uma mensagem por pacote
+        struct iovec iov[2 * n]; // Cada mensagem aponta para o pacote original, sem cópia
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < n; i++) {
+            pkt_iov(pkts[i], payloads ? payloads[i] : NULL, &iov[2 * i]);
+            msgs[i].msg_hdr.msg_iov = &iov[2 * i];
+            msgs[i].msg_hdr.msg_iovlen = 2;
+            msgs[i].msg_hdr.msg_name = dst;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+        while (sent < n) {
+            int rv = sendmmsg(sockfd, msgs + sent, n - sent, 0); // Pode enviar só parte do lote
+            if (rv < 0 && errno == EMSGSIZE && pmtu_shrink(c)) // Maior que o caminho: segue fragmentado
+                continue;
+            if (rv < 0) {
+                if (errno == ENOSYS || errno == EOPNOTSUPP) { // Sem suporte: volta ao envio por pacote
+                    RDT_LOG(RDT_LOG_INFO, "rdt: sendmmsg indisponível, usando envio por pacote.\n");
+                    c->batch_io_enabled = FALSE;
+                    break;
                 }
-            }
-            
-            gettimeofday(&send,NULL); // Marca o tempo de envio
-
-            ns = sendto(sockfd, &temp_pkt, temp_pkt.h.pkt_size, 0,
-                        (struct sockaddr *)dst, sizeof(struct sockaddr_in)); // Envia o pacote
-            
-            if (ns < 0) { // Verifica erros
-                perror("rdt_send: sendto(PKT_DATA)");
-                free(packets);
+                perror("rdt: sendmmsg");
                 return ERROR;
             }
-            send_time[next_seq]=send.tv_sec+send.tv_usec; // Armazena o tempo de envio
-            printf("rdt_send: Pacote enviado, seq %d\n", packets[next_seq].h.pkt_seq); // Exibe mensagem
-            next_seq++; // Incrementa o número de sequência
+            sent += rv;
         }
+    }
+    
+    for (; sent < n; sent++) {
+        if (is_data) {
+            if (send_data_pkt(c, pkts[sent], payloads ? payloads[sent] : NULL) < 0)
+                return ERROR;
+        } else if (sendto(sockfd, pkts[sent], pkt_size(pkts[sent]), 0,
+                          (struct sockaddr *)dst, sizeof(struct sockaddr_in)) < 0) {
+            perror("rdt: sendto");
+            return ERROR;
+        }
+    }
+    return n;
+}
+
+// Recebe até max pacotes. Com batch_io_enabled, uma chamada recvmmsg bloqueia até o primeiro
+// pacote e retorna também os que já estiverem na fila do socket; caso contrário (ou se
+// recvmmsg não estiver disponível), recebe um pacote com recvfrom. Retorna o número de
+// pacotes recebidos; lens[i] recebe o tamanho de cada datagrama e srcs[i] sua origem.
+int recv_pkts(rdt_conn *c, pkt *pkts, int *lens, struct sockaddr_in *srcs, int max) {
+    int sockfd = c->sockfd; // Socket da conexão
+    // UDP GRO: o kernel pode entregar vários datagramas coalescidos em um só, informando o
+    // tamanho de cada segmento. O datagrama é recebido direto no vetor pkts e, se os
+    // segmentos forem menores que um pkt, cada um é movido para o seu slot.
+    if (c->udp_offload_enabled && max > 1) {
+        char control[CMSG_SPACE(sizeof(int))]; // Mensagem de controle com o tamanho do segmento
+        struct iovec iov = {pkts, max * sizeof(pkt)};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_name = &srcs[0];
+        msg.msg_namelen = sizeof(struct sockaddr_in);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        int nr = recvmsg(sockfd, &msg, 0);
+        if (nr < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) // Socket não bloqueante sem dados
+                return 0;
+            perror("rdt: recvmsg(UDP_GRO)");
+            return ERROR;
+        }
+        int seg_size = nr; // Sem coalescência, o datagrama é um único pacote
+        for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+                seg_size = *(int *)CMSG_DATA(cm);
+        }
+        if (seg_size <= 0)
+            seg_size = nr;
+        int count = (nr + seg_size - 1) / seg_size; // Pacotes no datagrama
+        if (count > max)
+            count = max;
+        for (int i = count - 1; i >= 0; i--) { // De trás para frente, pois os destinos não se sobrepõem às origens ainda não movidas
+            int len = (i == count - 1) ? nr - i * seg_size : seg_size;
+            if (len > (int)sizeof(pkt))
+                len = sizeof(pkt);
+            if (seg_size != sizeof(pkt))
+                memmove(&pkts[i], (char *)pkts + i * seg_size, len);
+            lens[i] = len;
+            srcs[i] = srcs[0];
+        }
+        return count;
+    }
+    
+    if (c->batch_io_enabled && max > 1) {
+        struct mmsghdr msgs[max]; // Uma mensagem por pacote
+        struct iovec iov[max];
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < max; i++) {
+            iov[i].iov_base = &pkts[i];
+            iov[i].iov_len = sizeof(pkt);
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+            msgs[i].msg_hdr.msg_name = &srcs[i];
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        }
+        int rv = recvmmsg(sockfd, msgs, max, MSG_WAITFORONE, NULL);
+        if (rv >= 0) {
+            for (int i = 0; i < rv; i++)
+                lens[i] = msgs[i].msg_len;
+            return rv;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        if (errno != ENOSYS && errno != EOPNOTSUPP) {
+            perror("rdt: recvmmsg");
+            return ERROR;
+        }
+        RDT_LOG(RDT_LOG_INFO, "rdt: recvmmsg indisponível, usando recepção por pacote.\n");
+        c->batch_io_enabled = FALSE;
+    }
+    
+    socklen_t addrlen = sizeof(struct sockaddr_in); // Tamanho do endereço
+    int nr = recvfrom(sockfd, &pkts[0], sizeof(pkt), 0, (struct sockaddr *)&srcs[0], &addrlen);
+    if (nr < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return 0;
+        perror("rdt: recvfrom");
+        return ERROR;
+    }
+    lens[0] = nr;
+    return 1;
+}
+
+// Com o offload ativo, faz o socket aceitar datagramas coalescidos pelo kernel (UDP GRO).
+void enable_udp_gro(rdt_conn *c) {
+    if (!c->udp_offload_enabled)
+        return;
+    int one = 1;
+    if (setsockopt(c->sockfd, SOL_UDP, UDP_GRO, &one, sizeof(one)) < 0) {
+        RDT_LOG(RDT_LOG_INFO, "rdt: UDP GRO indisponível (%s), desativando offload.\n", strerror(errno));
+        c->udp_offload_enabled = FALSE;
+    }
+}
+
+// Estado de um fluxo de envio persistente (rdt_stream_open/write/close).
+// A janela, a estimativa de RTT e os pacotes em trânsito são mantidos entre as
+// chamadas de rdt_stream_write, de modo que o arquivo é enviado sem esvaziar a janela.
+struct rdt_stream {
+    rdt_conn *conn;             // Conexão (socket, destino, RTT, janela e flags)
+    pkt packets[SND_BUFFER_SIZE];       // Buffer circular de pacotes (índice = seq % SND_BUFFER_SIZE)
+    const char *payload[SND_BUFFER_SIZE]; // Payload fora do buffer (envio sem cópia) ou NULL
+    double send_time[SND_BUFFER_SIZE];  // Tempo de envio de cada pacote
+    int acked[SND_BUFFER_SIZE];         // Estado de confirmação de cada pacote (Selective Repeat e SACK)
+    int tx_count[SND_BUFFER_SIZE];      // Número de transmissões de cada pacote (regra de Karn)
+    hseq_t base;                // Pacote mais antigo ainda não confirmado
+    hseq_t next_seq;            // Próximo pacote a ser enviado
+    hseq_t end_seq;             // Próximo número de sequência livre no buffer
+    char tail[MAX_MSG_LEN];     // Dados de um segmento ainda incompleto
+    int tail_len;               // Bytes presentes em tail
+    // Janela dinâmica e fast retransmission
+    rdt_cc cc;                  // Controle de congestionamento
+    hseq_t last_ack_seq;        // Último número de sequência ACK recebido
+    int dup_ack_count;          // Contador de ACKs duplicados
+    hseq_t fastRetransmittedSeq; // Número de sequência do pacote retransmitido
+    // Descoberta do PMTU
+    double pmtu_next_probe;     // Instante da próxima sondagem
+    int rto_in_row;             // Timeouts seguidos sem nenhum pacote confirmado
+    rdt_fec_enc *fec;           // Codificador da FEC (NULL = desativada)
+    // Controle de fluxo
+    int rwnd;                   // Janela anunciada pelo receptor (pacotes além da base)
+    double persist_at;          // Janela fechada: instante da próxima sondagem (0 = nenhuma)
+    double persist_intvl;       // Intervalo atual entre sondagens
+    // Pacing
+    double srtt;                // RTT suavizado (s), mesmo com o timeout estático
+    double pace_next;           // Instante de envio do próximo pacote
+};
+
+#define SLOT(seq) ((seq) % SND_BUFFER_SIZE) // Posição de um número de sequência no buffer circular
+
+// Marca como confirmados os pacotes cobertos pelos blocos SACK do ACK recebido.
+// Retorna o número de sequência seguinte ao maior pacote confirmado por SACK (ou base, se não houver blocos)
+// e soma em *newly os pacotes confirmados pela primeira vez.
+static hseq_t apply_sack(rdt_stream *s, pkt *ack, int *newly) {
+    hseq_t high = s->base; // Limite superior das lacunas conhecidas
+    int len = pkt_size(ack) - (int)sizeof(hdr); // Payload do ACK
+    if (ack->h.flags & htons(PKT_F_FEC)) // Sem a perda informada ao fim
+        len -= sizeof(uint16_t);
+    if (ack->h.flags & htons(PKT_F_RWND)) // Sem a janela de recepção
+        len -= sizeof(uint16_t);
+    int nblocks = len / (int)sizeof(sack_block); // Blocos presentes no payload
+    for (int b = 0; b < nblocks && b < MAX_SACK_BLOCKS; b++) {
+        sack_block blk; // Bloco SACK (o payload pode estar desalinhado)
+        memcpy(&blk, ack->msg + b * sizeof(blk), sizeof(blk));
+        hseq_t start = ntohl(blk.start), end = ntohl(blk.end);
+        if (start > end) // Bloco inválido
+            continue;
+        // Limita o bloco à janela de envio: os limites vêm do outro lado e não podem custar mais
+        // que uma volta pela janela.
+        uint64_t lo = start > s->base ? start : s->base;
+        uint64_t hi = (uint64_t)end + 1 < s->end_seq ? (uint64_t)end + 1 : s->end_seq;
+        for (hseq_t seq = lo; seq < hi; seq++) {
+            if (s->acked[SLOT(seq)]) // Já confirmado
+                continue;
+            s->acked[SLOT(seq)] = TRUE;
+            (*newly)++;
+            if (seq + 1 > high)
+                high = seq + 1;
+        }
+    }
+    return high;
+}
+
+// Aplica a janela calculada pelo controle de congestionamento.
+static void apply_cwnd(rdt_stream *s) {
+    int window = (int)s->cc.cwnd; // Janela em pacotes inteiros
+    if (window == s->conn->window_size)
+        return;
+    RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Janela dinâmica %s para %d\n", window > s->conn->window_size ? "aumentada" : "diminuída", window);
+    s->conn->window_size = window;
+}
+
+// Informa uma perda (timeout ou fast retransmit) ao controle de congestionamento.
+static void on_loss(rdt_stream *s, int is_timeout) {
+    if (!s->conn->dynamic_window_enabled)
+        return;
+    s->cc.ops->on_loss(&s->cc, is_timeout, now_sec());
+    apply_cwnd(s);
+}
+
+// Envia os n pacotes de seqs do buffer em lote e reinicia seus timers.
+static int stream_xmit(rdt_stream *s, hseq_t *seqs, int n) {
+    pkt *burst[IO_BATCH]; // Pacotes do lote
+    const char *payloads[IO_BATCH]; // Payloads fora do buffer
+    for (int i = 0; i < n; i++) {
+        burst[i] = &s->packets[SLOT(seqs[i])];
+        payloads[i] = s->payload[SLOT(seqs[i])];
+    }
+    if (send_pkts(s->conn, burst, payloads, n, TRUE) < 0) // Envia os pacotes
+        return ERROR;
+    double now = now_sec();
+    rdt_stats *st = &s->conn->stats;
+    for (int i = 0; i < n; i++) {
+        st->bytes_sent += pkt_size(burst[i]) - sizeof(hdr);
+        if (s->tx_count[SLOT(seqs[i])]) {
+            st->retransmits++;
+            TRACE(s->conn, RDT_EV_RETX, seqs[i], s->conn->estimate_rtt);
+        } else {
+            TRACE(s->conn, RDT_EV_SEND, seqs[i], s->conn->estimate_rtt);
+        }
+        s->send_time[SLOT(seqs[i])] = now; // Armazena o tempo de envio
+        s->tx_count[SLOT(seqs[i])]++;
+    }
+    st->segments_sent += n;
+    return SUCCESS;
+}
+
+// Atualiza EstimateRTT, DevRTT e o TimeoutInterval com uma nova amostra (RFC 6298).
+// A amostra também alimenta o controle de congestionamento.
+static void rtt_sample(rdt_stream *s, double sample_rtt) {
+    rdt_conn *c = s->conn; // Conexão que guarda o estimador
+    TRACE(c, RDT_EV_RTT, 0, sample_rtt);
+    s->srtt = (s->srtt == 0) ? sample_rtt : 0.875 * s->srtt + 0.125 * sample_rtt;
+    if (c->dynamic_window_enabled)
+        s->cc.ops->on_rtt_sample(&s->cc, sample_rtt, now_sec());
+    if (!c->dynamic_timeout_enabled) // Timeout estático: o TimeoutInterval não muda
+        return;
+    
+    if (c->estimate_rtt == 0) { // Primeira amostra
+        c->estimate_rtt = sample_rtt;
+        c->dev_rtt = sample_rtt / 2;
+    } else {
+        // Cálculo do módulo de Dev_RTT (antes de atualizar EstimateRTT)
+        double diff = (sample_rtt > c->estimate_rtt) ? sample_rtt - c->estimate_rtt : c->estimate_rtt - sample_rtt;
+        c->dev_rtt = 0.75 * c->dev_rtt + 0.25 * diff; // DevRTT
+        c->estimate_rtt = 0.875 * c->estimate_rtt + 0.125 * sample_rtt; // EstimateRTT
+    }
+    
+    // TimeoutInterval = EstimateRTT + 4 * DevRTT, limitado a [MIN_TIMEOUT, MAX_TIMEOUT_SEC].
+    // Uma amostra válida também desfaz o backoff exponencial.
+    c->rto = c->estimate_rtt + 4 * c->dev_rtt;
+    if (c->rto < MIN_TIMEOUT)
+        c->rto = MIN_TIMEOUT;
+    if (c->rto > MAX_TIMEOUT_SEC)
+        c->rto = MAX_TIMEOUT_SEC;
+    RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Timeout dinâmico alterado para %.3f s (SampleRTT %.3f s)\n", c->rto, sample_rtt); // Exibe mensagem de alteração
+}
+
+// Pacing: retorna TRUE se o próximo pacote já pode sair e reserva o instante do seguinte,
+// um intervalo de RTT / (ganho * janela) depois. Até a primeira amostra de RTT, a janela
+// inicial sai em rajada. Um atraso da espera de até PACING_QUANTUM é recuperado enviando
+// os pacotes atrasados juntos; um atraso maior (o remetente ficou sem janela) é descartado.
+static int pace_ok(rdt_stream *s, double now) {
+    rdt_conn *c = s->conn; // Conexão
+    if (s->srtt == 0)
+        return TRUE;
+    if (s->pace_next > now) // Ainda não é a vez do pacote
+        return FALSE;
+    if (s->pace_next < now - PACING_QUANTUM)
+        s->pace_next = now - PACING_QUANTUM;
+    double gain = (c->dynamic_window_enabled && s->cc.cwnd < s->cc.ssthresh) ? PACING_GAIN_SS : PACING_GAIN;
+    s->pace_next += s->srtt / (gain * c->window_size);
+    return TRUE;
+}
+
+// FEC: acrescenta ao bloco atual o pacote seq, na sua primeira transmissão.
+// Retorna TRUE se o bloco ficou completo.
+static int fec_add(rdt_stream *s, hseq_t seq) {
+    pkt *p = &s->packets[SLOT(seq)]; // Pacote
+    const char *payload = s->payload[SLOT(seq)] ? s->payload[SLOT(seq)] : p->msg; // Payload, no buffer ou fora dele
+    return rdt_fec_enc_add(s->fec, seq, payload, pkt_size(p) - sizeof(hdr), s->conn->window_size);
+}
+
+// FEC: encerra o bloco atual e envia os seus pacotes de paridade, logo depois dos dados.
+static int fec_flush(rdt_stream *s) {
+    pkt *parity[FEC_MAX_PARITY]; // Pacotes de paridade
+    int n = rdt_fec_enc_finish(s->fec, parity);
+    if (n <= 0)
+        return n;
+    RDT_LOG(RDT_LOG_TRACE, "rdt_send: %d pacotes de paridade enviados para o bloco iniciado em seq %d\n", n, pkt_seq(parity[0]));
+    return send_pkts(s->conn, parity, NULL, n, FALSE) < 0 ? ERROR : SUCCESS;
+}
+
+// Descoberta do PMTU durante a transferência: volta a marcar DF nos pacotes de dados quando
+// os pacotes maiores que o caminho já foram confirmados e, a cada PMTU_PROBE_INTERVAL,
+// sonda MTUs maiores que o atual, pois o caminho pode ter mudado.
+static void pmtu_tick(rdt_stream *s) {
+    rdt_conn *c = s->conn; // Conexão
+    if (c->pmtu_mode == IP_PMTUDISC_DONT && s->base >= c->pmtu_fallback_end)
+        set_pmtu_mode(c, IP_PMTUDISC_DO);
+    double now = now_sec(); // Instante atual
+    if (now < s->pmtu_next_probe)
+        return;
+    c->pmtu_failed = 0; // O caminho pode ter voltado a comportar os tamanhos recusados
+    if (c->payload_size < c->payload_max)
+        pmtu_probe_send(c, c->payload_size);
+    s->pmtu_next_probe = now + PMTU_PROBE_INTERVAL;
+}
+
+// Função stream_pump: envia os pacotes permitidos pela janela e processa ACKs e timeouts.
+// Se drain for 1, retorna apenas quando todos os pacotes do buffer forem confirmados;
+// caso contrário, retorna assim que houver espaço livre no buffer para novos dados.
+static int stream_pump(rdt_stream *s, int drain) {
+    rdt_conn *c = s->conn; // Conexão
+    fd_set readfds; // Conjunto de descritores de arquivo para select
+    struct timeval wait; // Tempo de espera passado ao select
+    
+    while (1) {
+        if (c->pmtu_discovery_enabled)
+            pmtu_tick(s);
+        if (c->stats_interval > 0)
+            stats_tick(c, "rdt_send");
         
-        FD_ZERO(&readfds); // Limpa o conjunto de descritores
-        FD_SET(sockfd, &readfds); // Adiciona o socket ao conjunto
+        // Envia os pacotes dentro da janela, em lotes de até IO_BATCH pacotes.
+        // Com FEC, a paridade de cada bloco sai logo depois do lote que o completa.
+        hseq_t burst[IO_BATCH]; // Pacotes da rajada
+        int nburst = 0;
+        int block_done = FALSE; // Bloco da FEC completo no lote
+        int window = c->window_size < s->rwnd ? c->window_size : s->rwnd; // Menor entre a janela de congestionamento e a do receptor
+        int paced = FALSE; // Há pacotes na janela esperando a vez (pacing)
+        while (s->next_seq < s->end_seq && s->next_seq < s->base + window) { // Enquanto houver espaço na janela
+            // Após voltar para a base, pacotes já confirmados por SACK não são reenviados.
+            if (!s->acked[SLOT(s->next_seq)]) {
+                if (c->pacing_enabled && !pace_ok(s, now_sec())) {
+                    paced = TRUE;
+                    break;
+                }
+                burst[nburst++] = s->next_seq;
+                RDT_LOG(RDT_LOG_TRACE, "rdt_send: Pacote enviado, seq %d\n", s->next_seq); // Exibe mensagem
+                if (s->fec && s->tx_count[SLOT(s->next_seq)] == 0) // Retransmissões não entram na paridade
+                    block_done = fec_add(s, s->next_seq);
+            }
+            s->next_seq++; // Incrementa o número de sequência
+            if (nburst == IO_BATCH || block_done) {
+                if (stream_xmit(s, burst, nburst) < 0)
+                    return ERROR;
+                nburst = 0;
+                if (block_done && fec_flush(s) < 0)
+                    return ERROR;
+                block_done = FALSE;
+            }
+        }
+        if (nburst > 0 && stream_xmit(s, burst, nburst) < 0)
+            return ERROR;
+        if (s->fec && drain && s->next_seq == s->end_seq && fec_flush(s) < 0) // Último bloco, incompleto
+            return ERROR;
         
-        int rv = select(sockfd + 1, &readfds, NULL, NULL, &timeout); // Aguarda o recebimento de ACKs
+        if (s->base == s->end_seq) // Tudo confirmado
+            return SUCCESS;
+        if (!drain && s->end_seq - s->base < SND_BUFFER_SIZE) // Há espaço para novos dados
+            return SUCCESS;
         
-        gettimeofday(&recv,NULL); // Marca o tempo de recebimento
+        // Janela do receptor fechada sem pacotes em trânsito: se o ACK que a reabre se perder,
+        // nada mais chegaria, então o receptor é sondado com um pacote a intervalos crescentes.
+        if (s->rwnd == 0 && s->base == s->next_seq && s->next_seq < s->end_seq) {
+            if (s->persist_intvl == 0)
+                s->persist_intvl = c->rto;
+            if (s->persist_at == 0)
+                s->persist_at = now_sec() + s->persist_intvl;
+        } else {
+            s->persist_at = 0;
+        }
         
-        // Cálculo do TimeoutInterval
-        if (dynamic_timeout_enabled) { // Se o timeout dinâmico estiver ativado
-            sample_rtt = (recv.tv_sec - send.tv_sec) + (recv.tv_usec - send.tv_usec)/10e6; // Calcula o SampleRTT em segundos 
-        	estimate_rtt = 0.875 * estimate_rtt + 0.125 * sample_rtt; // Calcula o EstimateRTT em segundos
-        	
-        	// Cálculo do módulo de Dev_RTT
-        	if(sample_rtt-estimate_rtt>0) // Se SampleRTT > EstimateRTT
-			dev_rtt = 0.75 * dev_rtt + 0.25 * (sample_rtt-estimate_rtt); // Calcula o DevRTT utilizando SampleRTT - EstimateRTT
- 		else
- 			dev_rtt = 0.75 * dev_rtt + 0.25 * (estimate_rtt-sample_rtt); // Calcula o DevRTT utilizando EstimateRTT - SampleRTT
+        FD_ZERO(&readfds); // Limpa o conjunto de descritores
+        FD_SET(c->sockfd, &readfds); // Adiciona o socket ao conjunto
         
-        	// Atribuição
-        	timeout.tv_sec = estimate_rtt + 4 * dev_rtt; // TimeoutInterval = EstimateRTT + 4 * DevRTT
-       		timeout.tv_usec = (estimate_rtt + 4 * dev_rtt - timeout.tv_sec) * 1000000; // Converte para microssegundos
-		
-            if (timeout.tv_sec > MAX_TIMEOUT_SEC) // Limita o valor máximo do timeout
-                timeout.tv_sec = MAX_TIMEOUT_SEC;
-                
-            printf("rdt_send: Timeout dinâmico alterado para %ld.%ld s\n", timeout.tv_sec, timeout.tv_usec/1000); // Exibe mensagem de alteração
-        }else{
-        	// Se for Timeout Estático
-        	timeout.tv_sec = current_timeout_sec; // Timeout em segundos
-    		timeout.tv_usec = current_timeout_usec; // Timeout em microssegundos
+        // Espera até o vencimento do timer mais próximo entre os pacotes pendentes.
+        // No Go-Back-N é sempre o da base; no Selective Repeat cada pacote tem o seu.
+        double now = now_sec(); // Instante atual
+        double earliest = now + c->rto; // Vencimento mais próximo
+        if (!c->selective_repeat_enabled) { // Só o timer da base dispara a retransmissão
+            if (s->base < s->next_seq && s->send_time[SLOT(s->base)] + c->rto < earliest)
+                earliest = s->send_time[SLOT(s->base)] + c->rto;
+        } else {
+            for (hseq_t seq = s->base; seq < s->next_seq; seq++) {
+                if (!s->acked[SLOT(seq)] && s->send_time[SLOT(seq)] + c->rto < earliest)
+                    earliest = s->send_time[SLOT(seq)] + c->rto;
+            }
         }
+        if (s->persist_at > 0) // Nenhum pacote em trânsito: só a sondagem da janela
+            earliest = s->persist_at;
+        if (paced && s->pace_next < earliest) // Vez do próximo pacote da janela
+            earliest = s->pace_next;
+        double remaining = (earliest > now) ? earliest - now : 0; // Tempo restante até o vencimento
+        wait.tv_sec = (long)remaining;
+        wait.tv_usec = (long)((remaining - wait.tv_sec) * 1000000);
+        
+        pkt ack; // Pacote ACK
+        pkt *ring_ack = NULL; // ACK no buffer do anel (io_uring)
+        int nr = 0; // Tamanho do ACK
+        int rv; // Resultado da espera (0 = timeout)
+        if (c->uring) // Aguarda o ACK ou o timeout do anel
+            rv = rdt_uring_recv(c->uring, &ring_ack, &nr, NULL, 1, remaining);
+        else
+            rv = select(c->sockfd + 1, &readfds, NULL, NULL, &wait); // Aguarda o recebimento de ACKs
         
         if (rv < 0) { // Verifica erros
-            perror("rdt_send: select error");
-            free(packets);
+            if (!c->uring) // O anel já informa o erro
+                perror("rdt_send: select error");
             return ERROR;
         } else if (rv == 0) { // Timeout
-            printf("rdt_send: Timeout. Retransmitindo a partir do pacote seq %d\n", packets[base].h.pkt_seq);
-            next_seq = base; // Volta para a base da janela
+            int expired = 0; // Pacotes com timer vencido
+            now = now_sec();
+            if (s->persist_at > 0 && now >= s->persist_at) {
+                RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Janela do receptor fechada, sondando com o pacote seq %d\n", s->next_seq);
+                if (stream_xmit(s, &s->next_seq, 1) < 0)
+                    return ERROR;
+                s->next_seq++;
+                s->persist_at = 0;
+                s->persist_intvl *= 2;
+                if (s->persist_intvl > MAX_TIMEOUT_SEC)
+                    s->persist_intvl = MAX_TIMEOUT_SEC;
+                continue;
+            }
+            if (c->selective_repeat_enabled) {
+                // Retransmite apenas os pacotes cujo timer individual venceu.
+                hseq_t burst[IO_BATCH]; // Pacotes a retransmitir
+                int nburst = 0;
+                for (hseq_t seq = s->base; seq < s->next_seq; seq++) {
+                    if (s->acked[SLOT(seq)] || s->send_time[SLOT(seq)] + c->rto > now) // Confirmado ou timer ainda ativo
+                        continue;
+                    RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Timeout. Retransmitindo o pacote seq %d\n", seq);
+                    burst[nburst++] = seq;
+                    expired++;
+                    if (nburst == IO_BATCH) {
+                        if (stream_xmit(s, burst, nburst) < 0)
+                            return ERROR;
+                        nburst = 0;
+                    }
+                }
+                if (nburst > 0 && stream_xmit(s, burst, nburst) < 0)
+                    return ERROR;
+            } else if (s->base < s->next_seq && s->send_time[SLOT(s->base)] + c->rto <= now) {
+                RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Timeout. Retransmitindo a partir do pacote seq %d\n", s->base);
+                s->next_seq = s->base; // Volta para a base da janela
+                expired++;
+            }
+            if (expired == 0) // Acordou antes do vencimento (ou na vez do pacing)
+                continue;
+            c->stats.timeouts++;
+            TRACE(c, RDT_EV_TIMEOUT, s->base, c->estimate_rtt);
             
-            // Cálculo da Janela Deslizante se Timeout
-            if (dynamic_window_enabled){
-            	// Subtrai o valor do ultimo pacote previsto e divide a janela por 2
-            	dw_count -=current_window_size; // Subtrai o valor do ultimo pacote previsto
-            	current_window_size /= 2; // Divide a janela por 2
-            	
-            	if (current_window_size < MIN_DYNAMIC_WINDOW) // Limita o valor mínimo da janela
-                    current_window_size = MIN_DYNAMIC_WINDOW;
-                
-               	printf("rdt_send: Janela dinâmica diminuída para %d\n",current_window_size);
-               	// Contador recomeça do pacote retransmitido até o fim da proxíma janela diminuída
-                dw_count = packets[base].h.pkt_seq + current_window_size; // Contador recomeça do pacote retransmitido até o fim da proxíma janela diminuída
+            // Timeouts seguidos com pacotes grandes podem ser um caminho que os descarta sem
+            // avisar (ICMP filtrado): volta ao menor MTU e sonda de novo.
+            if (++s->rto_in_row >= PMTU_BLACKHOLE_RTOS && c->payload_size > pmtu_floor(c) && pmtu_shrink(c))
+                s->rto_in_row = 0;
+            
+            // Backoff exponencial: dobra o timeout até a próxima amostra válida de RTT.
+            if (c->dynamic_timeout_enabled) {
+                c->rto *= 2;
+                if (c->rto > MAX_TIMEOUT_SEC)
+                    c->rto = MAX_TIMEOUT_SEC;
+                RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Backoff do timeout para %.3f s\n", c->rto);
             }
+            on_loss(s, TRUE); // Cálculo da Janela Deslizante se Timeout
             continue; // Reinicia o loop
-          } else {
-            pkt ack; // Pacote ACK
-            addrlen = sizeof(struct sockaddr_in); // Tamanho do endereço
-            nr = recvfrom(sockfd, &ack, sizeof(pkt), 0,
+        }
+        
+        if (ring_ack) { // O buffer volta ao kernel na próxima espera
+            memcpy(&ack, ring_ack, nr);
+        } else {
+            struct sockaddr_in ack_addr; // Endereço do ACK
+            socklen_t addrlen = sizeof(struct sockaddr_in); // Tamanho do endereço
+            nr = recvfrom(c->sockfd, &ack, sizeof(pkt), 0,
                           (struct sockaddr *)&ack_addr, &addrlen); // Recebe o ACK
+        }
+        if (nr < 0) {
+            perror("rdt_send: recvfrom(PKT_ACK)");
+            return ERROR;
+        }
+        if (iscorrupted(&ack) || ack.h.pkt_type != PKT_ACK) {
+            RDT_LOG(RDT_LOG_DEBUG, "rdt_send: ACK corrompido ou inválido recebido.\n");
+            continue;
+        }
+        if (ack.h.flags & htons(PKT_F_PROBE)) { // ACK de uma sondagem do PMTU
+            pmtu_probe_ack(c, &ack);
+            continue;
+        }
+        if (ack.h.flags & htons(PKT_F_DELTA)) // Resposta atrasada de uma consulta das assinaturas
+            continue;
+        c->stats.acks_received++;
+        rdt_hist_add(c->stats.cwnd_hist, c->window_size);
+        rdt_hist_add(c->stats.rto_hist, c->rto * 1000);
+        TRACE(c, RDT_EV_ACK, pkt_seq(&ack), c->estimate_rtt);
+        if (s->fec && (ack.h.flags & htons(PKT_F_FEC)) && pkt_size(&ack) - (int)sizeof(hdr) >= (int)sizeof(uint16_t)) {
+            uint16_t loss; // Perda medida pelo receptor (por mil)
+            memcpy(&loss, ack.msg + pkt_size(&ack) - sizeof(hdr) - sizeof(loss), sizeof(loss));
+            rdt_fec_enc_report(s->fec, ntohs(loss));
+        }
+        int rwnd_changed = FALSE; // Um ACK que só atualiza a janela do receptor não é duplicado
+        if (c->flow_control_enabled && (ack.h.flags & htons(PKT_F_RWND))) {
+            uint16_t win; // Janela anunciada
+            int off = pkt_size(&ack) - (int)sizeof(hdr) - (int)sizeof(win)
+                      - ((ack.h.flags & htons(PKT_F_FEC)) ? (int)sizeof(uint16_t) : 0); // Posição no payload
+            if (off >= 0) {
+                memcpy(&win, ack.msg + off, sizeof(win));
+                rwnd_changed = (ntohs(win) != s->rwnd);
+                if (rwnd_changed && (ntohs(win) == 0 || s->rwnd == 0))
+                    RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Janela do receptor %s\n", ntohs(win) == 0 ? "fechada" : "reaberta");
+                s->rwnd = ntohs(win);
+                if (s->rwnd > 0)
+                    s->persist_intvl = 0;
+            }
+        }
+        
+        // Amostra de RTT do pacote confirmado por este ACK. Pela regra de Karn, pacotes
+        // retransmitidos não geram amostra, pois o ACK pode ser de qualquer uma das cópias.
+        if (pkt_seq(&ack) >= s->base && pkt_seq(&ack) < s->end_seq && !s->acked[SLOT(pkt_seq(&ack))]
+            && s->tx_count[SLOT(pkt_seq(&ack))] == 1)
+            rtt_sample(s, now_sec() - s->send_time[SLOT(pkt_seq(&ack))]);
+        
+        int newly = 0; // Pacotes confirmados pela primeira vez por este ACK
+        hseq_t sack_high = apply_sack(s, &ack, &newly); // Processa os blocos SACK, se houver
+        
+        if (c->selective_repeat_enabled) {
+            // No Selective Repeat cada ACK confirma apenas o pacote indicado, exceto o ACK
+            // cumulativo (PKT_F_CUM), que confirma todos até ele: com ACKs atrasados, o receptor
+            // confirma assim vários pacotes em ordem de uma vez.
+            if (ack.h.flags & htons(PKT_F_CUM)) {
+                for (hseq_t seq = s->base; seq < pkt_seq(&ack) && seq < s->next_seq; seq++) {
+                    if (!s->acked[SLOT(seq)]) {
+                        s->acked[SLOT(seq)] = TRUE;
+                        newly++;
+                    }
+                }
+            }
+            if (pkt_seq(&ack) >= s->base && pkt_seq(&ack) < s->next_seq && !s->acked[SLOT(pkt_seq(&ack))]) { // Dentro da janela e ainda não confirmado
+                s->acked[SLOT(pkt_seq(&ack))] = TRUE; // Marca o pacote como confirmado
+                newly++;
+                RDT_LOG(RDT_LOG_TRACE, "rdt_send: ACK recebido para o pacote seq %d\n", pkt_seq(&ack));
+            } else if (newly == 0) {
+                continue;
+            }
+            
+            // ACKs de pacotes acima da base indicam que a base pode ter sido perdida.
+            if (c->fast_retransmit_enabled && pkt_seq(&ack) > s->base && !s->acked[SLOT(s->base)]) {
+                s->dup_ack_count++; // Conta ACKs recebidos após o buraco
+                if (s->dup_ack_count >= 3 && s->fastRetransmittedSeq != s->base) {
+                    RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Fast retransmission disparada para o pacote seq %d\n", s->base);
+                    c->stats.fast_retransmits++;
+                    TRACE(c, RDT_EV_FAST_RETX, s->base, c->estimate_rtt);
+                    if (stream_xmit(s, &s->base, 1) < 0)
+                        return ERROR;
+                    s->fastRetransmittedSeq = s->base; // Marca o pacote retransmitido
+                    s->dup_ack_count = 0; // Reseta o contador
+                    on_loss(s, FALSE); // Cálculo da Janela Deslizante se perda
+                }
+            }
+            
+            // Avança a base até o primeiro pacote ainda não confirmado.
+            while (s->base < s->next_seq && s->acked[SLOT(s->base)]) {
+                s->base++;
+                s->dup_ack_count = 0;
+            }
+        } else if (c->fast_retransmit_enabled && pkt_seq(&ack) == s->last_ack_seq && !rwnd_changed) { // Se o ACK for duplicado
+            c->stats.dup_acks++;
+            TRACE(c, RDT_EV_DUPACK, pkt_seq(&ack), c->estimate_rtt);
+            if (s->fastRetransmittedSeq != pkt_seq(&ack)) { // Se o pacote ainda não foi retransmitido
+                s->dup_ack_count++; // Incrementa o contador de ACKs duplicados
+                RDT_LOG(RDT_LOG_DEBUG, "rdt_send: ACK duplicado (%d) para o pacote seq %d\n", s->dup_ack_count, pkt_seq(&ack)); // Exibe mensagem de ACK duplicado
+                if (s->dup_ack_count >= 3) { // Se houver 3 ACKs duplicados
+                    RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Fast retransmission disparada para o pacote seq %d\n", s->base); // Exibe mensagem de fast retransmission
+                    c->stats.fast_retransmits++;
+                    TRACE(c, RDT_EV_FAST_RETX, s->base, c->estimate_rtt);
+                    if (c->sack_enabled) {
+                        // Retransmite apenas as lacunas informadas pelo SACK (ao menos a base).
+                        hseq_t holes[IO_BATCH]; // Lacunas a retransmitir
+                        int nholes = 0;
+                        for (hseq_t seq = s->base; (seq < sack_high || seq == s->base) && nholes < IO_BATCH; seq++) {
+                            if (s->acked[SLOT(seq)])
+                                continue;
+                            RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Retransmitindo lacuna SACK, seq %d\n", seq);
+                            holes[nholes++] = seq;
+                        }
+                        if (stream_xmit(s, holes, nholes) < 0)
+                            return ERROR;
+                    } else {
+                        s->next_seq = s->base; // Volta para a base da janela
+                    }
+                    s->fastRetransmittedSeq = pkt_seq(&ack); // Marca o pacote retransmitido
+                    s->dup_ack_count = 0; // Reseta o contador de ACKs duplicados
+                    on_loss(s, FALSE); // Cálculo da Janela Deslizante se perda
+                    continue; // Reinicia o loop
+                }
+            } else {
+                RDT_LOG(RDT_LOG_TRACE, "rdt_send: ACK duplicado para o mesmo pacote (seq %d) já retransmitido, ignorando.\n", pkt_seq(&ack)); // Exibe mensagem
+            }
+        } else if (pkt_seq(&ack) > s->last_ack_seq) { // Se o ACK for maior que o último ACK recebido
+            s->last_ack_seq = pkt_seq(&ack); // Atualiza o último ACK recebido
+            s->dup_ack_count = 0; // Reseta o contador de ACKs duplicados
+            s->fastRetransmittedSeq = 0; // Reseta o número de sequência do pacote retransmitido
+            if (pkt_seq(&ack) >= s->base && pkt_seq(&ack) < s->end_seq) { // Se o ACK estiver dentro da janela
+                RDT_LOG(RDT_LOG_TRACE, "rdt_send: ACK recebido para o pacote seq %d\n", pkt_seq(&ack));
+                for (hseq_t seq = s->base; seq <= pkt_seq(&ack); seq++) // Conta os pacotes confirmados pelo ACK cumulativo
+                    if (!s->acked[SLOT(seq)])
+                        newly++;
+                s->base = pkt_seq(&ack) + 1; // Atualiza a base da janela
+                if (s->next_seq < s->base) // ACK de um envio anterior ao retorno para a base
+                    s->next_seq = s->base;
+            }
+        }
+        
+        if (newly > 0)
+            s->rto_in_row = 0;
+        
+        // Cálculo da Janela Deslizante se tudo certo
+        if (c->dynamic_window_enabled && newly > 0) {
+            s->cc.ops->on_ack(&s->cc, newly, now_sec());
+            apply_cwnd(s);
+        }
+    }
+}
+
+// Coloca um segmento completo no buffer circular, aguardando espaço se necessário.
+static int stream_queue(rdt_stream *s, void *msg, int msg_len) {
+    if (s->end_seq - s->base >= SND_BUFFER_SIZE && stream_pump(s, FALSE) < 0) // Buffer cheio
+        return ERROR;
+    if (s->conn->uring && rdt_uring_drain(s->conn->uring) < 0) // O slot pode ainda estar em um envio do anel
+        return ERROR;
+    if (make_pkt(&s->packets[SLOT(s->end_seq)], PKT_DATA, s->end_seq, msg, msg_len) < 0) // Cria o pacote
+        return ERROR;
+    s->payload[SLOT(s->end_seq)] = NULL;
+    s->acked[SLOT(s->end_seq)] = FALSE;
+    s->tx_count[SLOT(s->end_seq)] = 0;
+    s->end_seq++;
+    s->conn->snd_seqnum = s->end_seq; // Atualiza o número de sequência
+    return SUCCESS;
+}
+
+// Coloca no buffer circular um segmento cujo payload permanece na memória do usuário:
+// apenas o header é montado, com o checksum calculado sobre header e payload.
+static int stream_queue_ref(rdt_stream *s, const char *msg, int msg_len) {
+    if (s->end_seq - s->base >= SND_BUFFER_SIZE && stream_pump(s, FALSE) < 0) // Buffer cheio
+        return ERROR;
+    if (s->conn->uring && rdt_uring_drain(s->conn->uring) < 0) // O slot pode ainda estar em um envio do anel
+        return ERROR;
+    hdr *h = &s->packets[SLOT(s->end_seq)].h; // Header do pacote
+    hdr_init(h, PKT_DATA, s->end_seq, sizeof(hdr) + msg_len);
+    h->csum = pkt_checksum(h, msg, msg_len);
+    s->payload[SLOT(s->end_seq)] = msg;
+    s->acked[SLOT(s->end_seq)] = FALSE;
+    s->tx_count[SLOT(s->end_seq)] = 0;
+    s->end_seq++;
+    s->conn->snd_seqnum = s->end_seq; // Atualiza o número de sequência
+    return SUCCESS;
+}
+
+// Função rdt_stream_open: cria um fluxo de envio na conexão c a partir de c->snd_seqnum.
+rdt_stream *rdt_stream_open(rdt_conn *c) {
+    rdt_stream *s = calloc(1, sizeof(rdt_stream));
+    if (!s) {
+        perror("rdt_stream_open: calloc");
+        return NULL;
+    }
+    s->conn = c;
+    s->base = s->next_seq = s->end_seq = c->snd_seqnum;
+    // Até o primeiro ACK com PKT_F_RWND (que não vem se o receptor não tiver controle de fluxo),
+    // o limite é o buffer de reordenação do receptor, quando o modo usa um.
+    s->rwnd = c->selective_repeat_enabled || c->sack_enabled || c->fec_enabled ? SR_RCV_WINDOW : SND_BUFFER_SIZE;
+    s->pmtu_next_probe = now_sec() + PMTU_PROBE_INTERVAL;
+    if (c->fec_enabled) {
+        s->fec = rdt_fec_enc_open(fec_block_size);
+        if (!s->fec) {
+            free(s);
+            return NULL;
+        }
+    }
+    
+    // Ajusta a janela de transmissão: se dinâmica, parte da janela atual da conexão; caso contrário, STATIC_WINDOW_SIZE.
+    if (!c->dynamic_window_enabled)
+        c->window_size = STATIC_WINDOW_SIZE;
+    rdt_cc_init(&s->cc, c->cc_algorithm, c->window_size, MIN_DYNAMIC_WINDOW, MAX_DYNAMIC_WINDOW);
+    
+    // O anel consome os datagramas do socket enquanto o fluxo existir (até rdt_stream_close).
+    if (c->io_uring_enabled && !c->uring) {
+        c->uring = rdt_uring_open(c->sockfd);
+        if (!c->uring) {
+            RDT_LOG(RDT_LOG_INFO, "rdt_stream_open: io_uring indisponível, usando select.\n");
+            c->io_uring_enabled = FALSE;
+        }
+    }
+    trace_begin(c);
+    return s;
+}
+
+// Libera o fluxo e o anel da conexão, devolvendo o socket às chamadas normais (FIN, rdt_recv).
+static void stream_free(rdt_stream *s) {
+    trace_end(s->conn);
+    rdt_uring_close(s->conn->uring);
+    s->conn->uring = NULL;
+    rdt_fec_enc_close(s->fec);
+    free(s);
+}
+
+// Payload dos segmentos de dados. Com FEC, fica FEC_OVERHEAD bytes abaixo de payload_size,
+// para que os pacotes de paridade do bloco também caibam no payload negociado.
+static int seg_size(rdt_conn *c) {
+    int seg = c->payload_size - (c->fec_enabled ? FEC_OVERHEAD : 0);
+    return seg < 1 ? 1 : seg;
+}
+
+// Função rdt_stream_write: segmenta buf e envia os pacotes à medida que a janela permite.
+// Um segmento incompleto no fim de buf é completado pela próxima escrita (ou por rdt_stream_flush).
+// O tamanho dos segmentos é relido a cada um, pois a descoberta do PMTU pode alterá-lo.
+// Retorna buf_len ou ERROR.
+int rdt_stream_write(rdt_stream *s, void *buf, int buf_len) {
+    char *data = buf; // Próximo byte a ser segmentado
+    int remaining = buf_len; // Bytes restantes
+    
+    while (remaining > 0) {
+        int seg = seg_size(s->conn); // Tamanho dos segmentos
+        if (s->tail_len == 0 && remaining >= seg) {
+            // Segmento completo direto do buffer do usuário.
+            if (stream_queue(s, data, seg) < 0)
+                return ERROR;
+            data += seg;
+            remaining -= seg;
+        } else {
+            // Completa o segmento parcial.
+            int n = seg - s->tail_len;
+            if (n < 0) // O segmento parcial já excede o tamanho atual
+                n = 0;
+            if (n > remaining)
+                n = remaining;
+            memcpy(s->tail + s->tail_len, data, n);
+            s->tail_len += n;
+            data += n;
+            remaining -= n;
+            if (s->tail_len >= seg) {
+                if (stream_queue(s, s->tail, s->tail_len) < 0)
+                    return ERROR;
+                s->tail_len = 0;
+            }
+        }
+    }
+    if (stream_pump(s, FALSE) < 0) // Envia o que a janela permitir
+        return ERROR;
+    return buf_len;
+}
+
+// Função rdt_stream_write_zc: envia buf sem copiar o payload. Os pacotes apontam para buf
+// (por exemplo, um arquivo mapeado com mmap), e o kernel monta cada datagrama a partir do
+// header e do trecho de buf com sendmsg / sendmmsg; retransmissões reutilizam o mesmo trecho.
+// buf deve permanecer válido e inalterado até rdt_stream_flush ou rdt_stream_close.
+// Retorna SUCCESS ou ERROR.
+int rdt_stream_write_zc(rdt_stream *s, const void *buf, long buf_len) {
+    const char *data = buf; // Próximo byte a ser segmentado
+    if (s->tail_len > 0) { // Segmento parcial de uma escrita anterior com cópia
+        if (stream_queue(s, s->tail, s->tail_len) < 0)
+            return ERROR;
+        s->tail_len = 0;
+    }
+    for (long off = 0; off < buf_len; ) {
+        int seg = seg_size(s->conn); // Relido a cada segmento: a descoberta do PMTU pode alterá-lo
+        int n = (buf_len - off < seg) ? (int)(buf_len - off) : seg; // Tamanho do segmento
+        if (stream_queue_ref(s, data + off, n) < 0)
+            return ERROR;
+        off += n;
+    }
+    return stream_pump(s, FALSE); // Envia o que a janela permitir
+}
+
+// Função rdt_stream_flush: envia o segmento parcial e aguarda a confirmação de todos os pacotes.
+int rdt_stream_flush(rdt_stream *s) {
+    if (s->tail_len > 0) {
+        if (stream_queue(s, s->tail, s->tail_len) < 0)
+            return ERROR;
+        s->tail_len = 0;
+    }
+    return stream_pump(s, TRUE);
+}
+
+// Função rdt_stream_close: esvazia o fluxo, encerra a conexão com FIN e libera o fluxo.
+int rdt_stream_close(rdt_stream *s) {
+    int rv = rdt_stream_flush(s);
+    rdt_conn *c = s->conn;
+    stream_free(s);
+    if (rv == SUCCESS)
+        rv = rdt_close(c);
+    return rv;
+}
+
+// Função rdt_send: envia um buffer segmentado usando uma janela de transmissão e aguarda
+// a confirmação de todos os pacotes. Para arquivos, prefira rdt_stream_open/write/close,
+// que mantêm a janela e o RTT entre as escritas.
+// Se dynamic_window_enabled for 1, a janela é ajustada dinamicamente.
+// O fast retransmit é acionado se a flag fast_retransmit_enabled estiver ativada.
+// Se selective_repeat_enabled for 1, cada pacote tem seu próprio timer e apenas os
+// pacotes não confirmados são retransmitidos (Selective Repeat); caso contrário, Go-Back-N.
+// Com sack_enabled, pacotes informados nos blocos SACK não são reenviados.
+int rdt_send(rdt_conn *c, void *buf, int buf_len) {
+    rdt_stream *s = rdt_stream_open(c);
+    if (!s)
+        return ERROR;
+    int rv = rdt_stream_write(s, buf, buf_len);
+    if (rv >= 0 && rdt_stream_flush(s) < 0)
+        rv = ERROR;
+    stream_free(s);
+    return rv;
+}
+
+
+// Metadados do PKT_START no formato da rede: campos de tamanho fixo, sem preenchimento e na
+// ordem de bytes da rede. Leva também o payload proposto pelo remetente; o receptor responde
+// com o payload aceito (uint16_t na ordem da rede) no payload do ACK.
+typedef struct __attribute__((packed)) {
+    char filename[256];
+    uint64_t file_size;
+    uint64_t offset;
+    uint64_t length;
+    uint32_t stripe_index;
+    uint32_t stripe_count;
+    uint16_t payload_size;      // Payload proposto pelo remetente
+} start_meta;
+
+// Com PKT_F_COMPRESS, os metadados são seguidos do codec e do nível propostos. O receptor que
+// aceita confirma com PKT_F_COMPRESS no ACK.
+typedef struct __attribute__((packed)) {
+    uint8_t codec;              // RDT_Z_LZ4
+    uint8_t level;              // Aceleração do LZ4
+} start_compress;
+
+// Com PKT_F_DELTA, seguem (depois de start_compress, se houver) o bloco das assinaturas e o hash
+// do arquivo enviado (rdt_block_hash do arquivo inteiro), conferido pelo receptor no FIN.
+typedef struct __attribute__((packed)) {
+    uint32_t block_size;
+    uint64_t digest;
+} start_delta;
+
+// Confirma o PKT_START de número seqnum, informando o payload aceito para a conexão e, em
+// flags, as funcionalidades aceitas (PKT_F_FEC).
+int rdt_start_ack(rdt_conn *c, hseq_t seqnum, int flags) {
+    pkt ack; // Pacote ACK
+    uint16_t accepted = htons(c->payload_size); // Payload aceito
+    if (build_pkt(&ack, PKT_ACK, flags, seqnum, &accepted, sizeof(accepted)) < 0) // Cria o pacote ACK
+        return ERROR;
+    if (sendto(c->sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0) { // Envia o ACK
+        perror("rdt_recv_file: sendto(PKT_START ACK)"); // Exibe mensagem de erro
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+// Função rdt_start: envia o PKT_START com os metadados do arquivo e aguarda o ACK,
+// retransmitindo-o a cada timeout (até START_RETRIES vezes).
+int rdt_start(rdt_conn *c, file_meta *meta) {
+    pkt startPkt; // Pacote de início
+    int ceiling = c->payload_size; // Maior payload desejado, proposto ao receptor
+    start_meta sm; // Metadados no formato da rede
+    memset(&sm, 0, sizeof(sm));
+    memcpy(sm.filename, meta->filename, sizeof(sm.filename) - 1); // sm.filename já termina em '\0'
+    sm.file_size = htobe64(meta->fileSize);
+    sm.offset = htobe64(meta->offset);
+    sm.length = htobe64(meta->length);
+    sm.stripe_index = htonl(meta->stripe_index);
+    sm.stripe_count = htonl(meta->stripe_count);
+    sm.payload_size = htons(ceiling);
+    // Sem bloco escolhido pelo remetente, ou sem o controle de fluxo que segura o envio enquanto
+    // o receptor monta as cópias.
+    if (c->delta_enabled && (c->delta_block < DELTA_MIN_BLOCK || !c->flow_control_enabled))
+        c->delta_enabled = FALSE;
+    int flags = (c->fec_enabled ? PKT_F_FEC : 0) | (c->resume_enabled ? PKT_F_RESUME : 0)
+              | (c->compress_enabled ? PKT_F_COMPRESS : 0) | (c->delta_enabled ? PKT_F_DELTA : 0); // Funcionalidades propostas
+    char payload[sizeof(start_meta) + sizeof(start_compress) + sizeof(start_delta)]; // Metadados e funcionalidades propostas
+    int plen = sizeof(sm); // Tamanho do payload
+    memcpy(payload, &sm, sizeof(sm));
+    if (c->compress_enabled) {
+        start_compress sz = {RDT_Z_LZ4, c->compress_level > UINT8_MAX ? UINT8_MAX : c->compress_level};
+        memcpy(payload + plen, &sz, sizeof(sz));
+        plen += sizeof(sz);
+    }
+    if (c->delta_enabled) {
+        start_delta sd = {htonl(c->delta_block), htobe64(c->delta_digest)};
+        memcpy(payload + plen, &sd, sizeof(sd));
+        plen += sizeof(sd);
+    }
+    if (build_pkt(&startPkt, PKT_START, flags, 0, payload, plen) < 0) // Cria o pacote de início
+        return ERROR;
+    
+    // Descoberta do PMTU: os dados começam no menor MTU sondado e sobem à medida que as
+    // sondagens enviadas junto com o PKT_START são confirmadas (aqui ou já no fluxo de envio).
+    if (c->pmtu_discovery_enabled) {
+        c->payload_size = pmtu_floor(c);
+        set_pmtu_mode(c, IP_PMTUDISC_DO);
+        pmtu_probe_send(c, c->payload_size);
+    }
+    
+    for (int attempt = 0; attempt < START_RETRIES; attempt++) {
+        if (attempt > 0 && c->pmtu_discovery_enabled) // As sondagens também podem ter se perdido
+            pmtu_probe_send(c, c->payload_size);
+        if (sendto(c->sockfd, &startPkt, pkt_size(&startPkt), 0,
+                   (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0) { // Envia o pacote de início
+            perror("rdt_start: sendto(PKT_START)");
+            return ERROR;
+        }
+        RDT_LOG(RDT_LOG_INFO, "rdt_start: PKT_START enviado (seq %d). Nome: %s, Tamanho: %ld bytes.\n",
+                pkt_seq(&startPkt), meta->filename, meta->fileSize); // Exibe informações
+        
+        double wait_s = c->rto * (1 << attempt); // Backoff exponencial entre as tentativas
+        if (wait_s > MAX_TIMEOUT_SEC)
+            wait_s = MAX_TIMEOUT_SEC;
+        struct timeval timeout = {(long)wait_s, (long)((wait_s - (long)wait_s) * 1000000)}; // Timeout
+        fd_set readfds; // Conjunto de descritores de arquivo para select
+        while (1) {
+            FD_ZERO(&readfds); // Limpa o conjunto
+            FD_SET(c->sockfd, &readfds); // Adiciona o socket ao conjunto
+            if (select(c->sockfd + 1, &readfds, NULL, NULL, &timeout) <= 0) // Timeout: reenvia
+                break;
+            pkt ack; // Pacote ACK
+            int nr = recvfrom(c->sockfd, &ack, sizeof(pkt), 0, NULL, NULL); // Recebe o ACK
+            if (nr < 0) {
+                perror("rdt_start: recvfrom(PKT_START ACK)");
+                return ERROR;
+            }
+            if (nr < (int)sizeof(hdr) || iscorrupted(&ack))
+                continue;
+            if (ack.h.flags & htons(PKT_F_PROBE)) { // ACK de uma sondagem do PMTU
+                pmtu_probe_ack(c, &ack);
+                continue;
+            }
+            if (has_ackseq(&ack, pkt_seq(&startPkt))) {
+                uint16_t accepted; // Payload aceito pelo receptor
+                if (pkt_size(&ack) - (int)sizeof(hdr) >= (int)sizeof(accepted)) {
+                    memcpy(&accepted, ack.msg, sizeof(accepted));
+                    accepted = ntohs(accepted);
+                    if (accepted >= 1 && accepted < c->payload_max)
+                        c->payload_max = accepted;
+                }
+                if (!c->pmtu_discovery_enabled || c->payload_size > c->payload_max)
+                    c->payload_size = c->payload_max;
+                if (c->fec_enabled && !(ack.h.flags & htons(PKT_F_FEC))) {
+                    RDT_LOG(RDT_LOG_INFO, "rdt_start: FEC recusada pelo receptor.\n");
+                    c->fec_enabled = FALSE;
+                }
+                if (c->compress_enabled && !(ack.h.flags & htons(PKT_F_COMPRESS))) {
+                    RDT_LOG(RDT_LOG_INFO, "rdt_start: Compressão recusada pelo receptor.\n");
+                    c->compress_enabled = FALSE;
+                }
+                if (c->delta_enabled && !(ack.h.flags & htons(PKT_F_DELTA))) { // O arquivo vai inteiro
+                    RDT_LOG(RDT_LOG_INFO, "rdt_start: Envio por diferença recusado pelo receptor.\n");
+                    c->delta_enabled = FALSE;
+                }
+                if (c->resume_enabled && !(ack.h.flags & htons(PKT_F_RESUME))) { // O receptor truncaria o arquivo
+                    fprintf(stderr, "rdt_start: Retomada recusada pelo receptor.\n");
+                    return ERROR;
+                }
+                RDT_LOG(RDT_LOG_INFO, "rdt_start: ACK do PKT_START recebido (payload de %d bytes).\n", c->payload_size);
+                return SUCCESS;
+            }
+        }
+        RDT_LOG(RDT_LOG_DEBUG, "rdt_start: Timeout aguardando ACK do PKT_START.\n");
+    }
+    return ERROR;
+}
+
+// Função rdt_resume_query: pede ao receptor, na conexão aberta com PKT_F_RESUME, os hashes do
+// checkpoint a partir do bloco first, retransmitindo o PKT_RESUME a cada timeout (até START_RETRIES vezes).
+// Preenche hashes (até RESUME_PAGE) e retorna quantos vieram (0 = sem checkpoint compatível),
+// ou ERROR se o receptor não responder.
+int rdt_resume_query(rdt_conn *c, long first, uint64_t *hashes) {
+    pkt query; // Pacote de consulta
+    resume_query rq; // Consulta no formato da rede
+    rq.block_size = htonl(RESUME_BLOCK);
+    rq.first = htonl(first);
+    if (build_pkt(&query, PKT_RESUME, 0, first, &rq, sizeof(rq)) < 0) // O seq identifica a página
+        return ERROR;
+    
+    for (int attempt = 0; attempt < START_RETRIES; attempt++) {
+        if (sendto(c->sockfd, &query, pkt_size(&query), 0, (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0) {
+            perror("rdt_resume_query: sendto(PKT_RESUME)");
+            return ERROR;
+        }
+        double wait_s = c->rto * (1 << attempt); // Backoff exponencial entre as tentativas
+        if (wait_s > MAX_TIMEOUT_SEC)
+            wait_s = MAX_TIMEOUT_SEC;
+        struct timeval timeout = {(long)wait_s, (long)((wait_s - (long)wait_s) * 1000000)}; // Timeout
+        fd_set readfds; // Conjunto de descritores de arquivo para select
+        while (1) {
+            FD_ZERO(&readfds);
+            FD_SET(c->sockfd, &readfds);
+            if (select(c->sockfd + 1, &readfds, NULL, NULL, &timeout) <= 0) // Timeout: reenvia
+                break;
+            pkt ack; // Resposta
+            int nr = recvfrom(c->sockfd, &ack, sizeof(pkt), 0, NULL, NULL);
             if (nr < 0) {
-                perror("rdt_send: recvfrom(PKT_ACK)");
-                free(packets);
+                perror("rdt_resume_query: recvfrom");
                 return ERROR;
             }
-            if (iscorrupted(&ack) || ack.h.pkt_type != PKT_ACK) {
-                printf("rdt_send: ACK corrompido ou inválido recebido.\n");
+            int len = pkt_size(&ack) - (int)sizeof(hdr); // Tamanho do payload
+            if (nr < (int)sizeof(hdr) || iscorrupted(&ack) || ack.h.pkt_type != PKT_ACK
+                || !(ack.h.flags & htons(PKT_F_RESUME)) || pkt_seq(&ack) != (hseq_t)first || len < (int)sizeof(resume_reply))
                 continue;
+            resume_reply rr; // Resposta no formato da rede
+            memcpy(&rr, ack.msg, sizeof(rr));
+            int count = ntohs(rr.count); // Hashes na resposta
+            if (ntohl(rr.first) != (uint32_t)first || count > RESUME_PAGE || len < (int)(sizeof(rr) + count * sizeof(uint64_t)))
+                continue;
+            for (int i = 0; i < count; i++) {
+                memcpy(&hashes[i], ack.msg + sizeof(rr) + i * sizeof(uint64_t), sizeof(uint64_t));
+                hashes[i] = be64toh(hashes[i]);
             }
-            
-            // Se o fast retransmit estiver habilitado, processa os ACKs duplicados.
-            if (fast_retransmit_enabled) { // Se o fast retransmit estiver ativado
-                if (ack.h.pkt_seq == last_ack_seq) { // Se o ACK for duplicado
-                    if (fastRetransmittedSeq != ack.h.pkt_seq) { // Se o pacote ainda não foi retransmitido
-                        dup_ack_count++; // Incrementa o contador de ACKs duplicados
-                        printf("rdt_send: ACK duplicado (%d) para o pacote seq %d\n", dup_ack_count, ack.h.pkt_seq); // Exibe mensagem de ACK duplicado
-                        if (dup_ack_count >= 3) { // Se houver 3 ACKs duplicados
-                            printf("rdt_send: Fast retransmission disparada para o pacote seq %d\n", packets[base].h.pkt_seq); // Exibe mensagem de fast retransmission
-                            
-                            next_seq = base; // Volta para a base da janela
-                            fastRetransmittedSeq = ack.h.pkt_seq; // Marca o pacote retransmitido
-                            dup_ack_count = 0; // Reseta o contador de ACKs duplicados
-                            
-                        // Cálculo da Janela Deslizante se Timeout
-            		    if (dynamic_window_enabled){ // Se a janela dinâmica estiver ativada
-            		  	// Subtrai o valor do ultimo pacote previsto e divide a janela por 2
-            		        dw_count -=current_window_size; // Subtrai o valor do ultimo pacote previsto
-            			    current_window_size /= 2; // Divide a janela por 2
-		            	if (current_window_size < MIN_DYNAMIC_WINDOW) // Limita o valor mínimo da janela
-                		    current_window_size = MIN_DYNAMIC_WINDOW;
-                
-               			printf("rdt_send: Janela dinâmica diminuída para %d\n",current_window_size); // Exibe mensagem
-               			// Contador recomeça do pacote retransmitido até o fim da proxíma janela diminuída
-                		dw_count = packets[base].h.pkt_seq + current_window_size; // Contador recomeça do pacote retransmitido até o fim da proxíma janela diminuída
-            		    }
-                        continue; // Reinicia o loop
-                        }
-                    }else {
-                        printf("rdt_send: ACK duplicado para o mesmo pacote (seq %d) já retransmitido, ignorando.\n", ack.h.pkt_seq); // Exibe mensagem
-                    }
-                } else if (ack.h.pkt_seq > last_ack_seq) { // Se o ACK for maior que o último ACK recebido
-                    last_ack_seq = ack.h.pkt_seq; // Atualiza o último ACK recebido
-                    dup_ack_count = 0; // Reseta o contador de ACKs duplicados
-                    fastRetransmittedSeq = 0; // Reseta o número de sequência do pacote retransmitido
-                    int ack_index = ack.h.pkt_seq - _snd_seqnum; // Índice do ACK
-                    if (ack_index >= base && ack_index < num_segments) { // Se o ACK estiver dentro da janela
-                        printf("rdt_send: ACK recebido para o pacote seq %d\n", ack.h.pkt_seq);
-                        base = ack_index + 1; // Atualiza a base da janela
-                    }                
-                 }
-            } else {
-                // Se fast retransmit estiver desativado, ignoramos a contagem de ACKs duplicados.
-                if (ack.h.pkt_seq > last_ack_seq) { // Se o ACK for maior que o último ACK recebido
-                    last_ack_seq = ack.h.pkt_seq; // Atualiza o último ACK recebido
-                    int ack_index = ack.h.pkt_seq - _snd_seqnum; // Índice do ACK
-                    if (ack_index >= base && ack_index < num_segments) { // Se o ACK estiver dentro da janela
-                        printf("rdt_send: ACK recebido para o pacote seq %d\n", ack.h.pkt_seq); // Exibe mensagem
-                        base = ack_index + 1; // Atualiza a base da janela
-                    }
-                }
-            }
-            
-           // Cálculo da Janela Deslizante se tudo certo
-           if (dynamic_window_enabled){ 
-           	// Verifica se todos os ACKs da janela foram recebidos e a aumenta 
-	   	if (ack.h.pkt_seq >= dw_count && current_window_size < MAX_DYNAMIC_WINDOW) { // Se todos os ACKs da janela foram recebidos e a janela não atingiu o máximo
-		    current_window_size++; // Aumenta a janela
-		    
-		    if (current_window_size > MAX_DYNAMIC_WINDOW)
-		        current_window_size = MAX_DYNAMIC_WINDOW;
-	 	    printf("rdt_send: Janela dinâmica aumentada para %d\n", current_window_size); // Exibe mensagem
-   		    dw_count +=current_window_size; // Incremento do contador com a nova janela
-    		}
-            }
+            return count;
         }
+        RDT_LOG(RDT_LOG_DEBUG, "rdt_resume_query: Timeout aguardando a resposta do PKT_RESUME.\n");
     }
-    _snd_seqnum += num_segments; // Atualiza o número de sequência
-    free(packets); // Libera a memória alocada
-    return buf_len; // Retorna o tamanho do buffer
+    return ERROR;
 }
 
-
-// Função rdt_close: envia um pacote FIN e aguarda o ACK correspondente.
-int rdt_close(int sockfd, struct sockaddr_in *dst, int snd_seqnum) {
+// Função rdt_close: envia um pacote FIN com o próximo número de sequência da conexão
+// e aguarda o ACK correspondente, retransmitindo o FIN a cada timeout (até FIN_RETRIES vezes):
+// o FIN ou o seu ACK podem se perder, e o receptor adia o ACK enquanto monta um envio por diferença.
+int rdt_close(rdt_conn *c) {
+    int sockfd = c->sockfd; // Socket da conexão
     int ns; // Número de bytes enviados
     pkt finPkt; // Pacote FIN
-    if (make_pkt(&finPkt, PKT_FIN, snd_seqnum, NULL, 0) < 0) { // Cria o pacote FIN (sem payload)
+    if (c->ack_unsent > 0) { // ACK atrasado de rdt_recv ainda pendente
+        pkt ack; // ACK cumulativo
+        if (make_pkt(&ack, PKT_ACK, c->rcv_seqnum - 1, NULL, 0) == SUCCESS)
+            sendto(sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in));
+        c->ack_unsent = 0;
+    }
+    if (make_pkt(&finPkt, PKT_FIN, c->snd_seqnum, NULL, 0) < 0) { // Cria o pacote FIN (sem payload)
         return ERROR;
     }
     
-    ns = sendto(sockfd, &finPkt, finPkt.h.pkt_size, 0,
-        (struct sockaddr *)dst, sizeof(struct sockaddr_in)); // Envia o pacote FIN
+    ns = sendto(sockfd, &finPkt, pkt_size(&finPkt), 0,
+        (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)); // Envia o pacote FIN
     if (ns < 0) { // Verifica erros
         perror("rdt_send_file: sendto(PKT_FIN)");
         return ERROR;
     }
-    printf("rdt_send_file: Pacote FIN enviado (seq %d).\n", finPkt.h.pkt_seq); // Exibe mensagem de envio
+    RDT_LOG(RDT_LOG_INFO, "rdt_send_file: Pacote FIN enviado (seq %d).\n", pkt_seq(&finPkt)); // Exibe mensagem de envio
     
     // Configura o timeout para aguardar o ACK
-    struct timeval timeout = {current_timeout_sec, current_timeout_usec}; // Timeout
+    struct timeval timeout = {(long)c->static_timeout, (long)((c->static_timeout - (long)c->static_timeout) * 1000000)}; // Timeout
     fd_set readfds; // Conjunto de descritores de arquivo para select
-    FD_ZERO(&readfds); // Limpa o conjunto
-    FD_SET(sockfd, &readfds); // Adiciona o socket ao conjunto
+    int retries = 0; // Retransmissões do FIN
     
-    int rv = select(sockfd + 1, &readfds, NULL, NULL, &timeout); // Aguarda o recebimento de ACK
-    if (rv > 0) { // Se houve dados para leitura
+    // ACKs atrasados de pacotes de dados podem chegar antes do ACK do FIN e são ignorados.
+    // O select (Linux) desconta de timeout o tempo já esperado.
+    while (1) {
+        FD_ZERO(&readfds); // Limpa o conjunto
+        FD_SET(sockfd, &readfds); // Adiciona o socket ao conjunto
+        
+        int rv = select(sockfd + 1, &readfds, NULL, NULL, &timeout); // Aguarda o recebimento de ACK
+        if (rv < 0 && errno != EINTR) {
+            perror("rdt_close: select");
+            return ERROR;
+        }
+        if (rv <= 0) {
+            RDT_LOG(RDT_LOG_INFO, "rdt_close: Timeout aguardando ACK do FIN.\n"); // Exibe mensagem de timeout 
+            if (++retries >= FIN_RETRIES)
+                return ERROR;
+            if (sendto(sockfd, &finPkt, pkt_size(&finPkt), 0, (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0) {
+                perror("rdt_send_file: sendto(PKT_FIN)");
+                return ERROR;
+            }
+            timeout.tv_sec = (long)c->static_timeout;
+            timeout.tv_usec = (long)((c->static_timeout - (long)c->static_timeout) * 1000000);
+            continue;
+        }
         pkt ack; // Pacote ACK
         socklen_t addrlen = sizeof(struct sockaddr_in); // Tamanho do endereço
         ns = recvfrom(sockfd, &ack, sizeof(pkt), 0, NULL, &addrlen); // Recebe o ACK
@@ -337,29 +1841,45 @@ int rdt_close(int sockfd, struct sockaddr_in *dst, int snd_seqnum) {
             perror("rdt_close: recvfrom(PKT_FIN ACK)"); // Exibe mensagem de erro
             return ERROR;
         }
-        if (ack.h.pkt_type == PKT_ACK && ack.h.pkt_seq == finPkt.h.pkt_seq) { // Se o ACK for válido
-            printf("rdt_close: ACK do FIN recebido.\n"); // Exibe mensagem de sucesso
+        if (ack.h.pkt_type == PKT_ACK && !(ack.h.flags & htons(PKT_F_PROBE | PKT_F_DELTA)) && pkt_seq(&ack) == pkt_seq(&finPkt)) { // Se o ACK for válido
+            RDT_LOG(RDT_LOG_INFO, "rdt_close: ACK do FIN recebido.\n"); // Exibe mensagem de sucesso
             return SUCCESS;
-        } else {
-            printf("rdt_close: ACK incorreto recebido.\n"); // Exibe mensagem de erro
-            return ERROR;
         }
-    } else {
-        printf("rdt_close: Timeout aguardando ACK do FIN.\n"); // Exibe mensagem de timeout 
-        return ERROR;
+        RDT_LOG(RDT_LOG_TRACE, "rdt_close: ACK de outro pacote (seq %d) ignorado.\n", pkt_seq(&ack)); // Exibe mensagem
     }
 }
 
-int rdt_recv(int sockfd, void *buf, int buf_len, struct sockaddr_in *src) {
+int rdt_recv(rdt_conn *c, void *buf, int buf_len) {
+	int sockfd = c->sockfd;
+	struct sockaddr_in *src = &c->peer;
 	pkt p, ack;
 	int nr, ns;
 	int addrlen;
 	memset(&p, 0, sizeof(hdr));
 
-        if (make_pkt(&ack, PKT_ACK, _rcv_seqnum - 1, NULL, 0) < 0)
+        if (make_pkt(&ack, PKT_ACK, c->rcv_seqnum - 1, NULL, 0) < 0)
                 return ERROR;
 
 rerecv:
+	// ACK atrasado pendente: se nenhum pacote chegar até o vencimento do timer, é enviado antes de continuar esperando.
+	if (c->ack_unsent > 0) {
+		double remaining = c->ack_due - now_sec(); // Tempo até o vencimento
+		fd_set readfds;
+		struct timeval wait = {0, 0};
+		if (remaining > 0) {
+			wait.tv_sec = (long)remaining;
+			wait.tv_usec = (long)((remaining - wait.tv_sec) * 1000000);
+		}
+		FD_ZERO(&readfds);
+		FD_SET(sockfd, &readfds);
+		if (select(sockfd + 1, &readfds, NULL, NULL, &wait) == 0) {
+			if (sendto(sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr*)src, (socklen_t)sizeof(struct sockaddr_in)) < 0) {
+				perror("rdt_rcv: sendto(PKT_ACK atrasado)");
+				return ERROR;
+			}
+			c->ack_unsent = 0;
+		}
+	}
 	addrlen = sizeof(struct sockaddr_in);
 	nr = recvfrom(sockfd, &p, sizeof(pkt), 0, (struct sockaddr*)src,
 		(socklen_t *)&addrlen);
@@ -367,179 +1887,944 @@ rerecv:
 		perror("recvfrom():");
 		return ERROR;
 	}
-	if (iscorrupted(&p) || !has_dataseqnum(&p, _rcv_seqnum)) {
-		printf("rdt_recv: iscorrupted || has_dataseqnum \n");
-		// enviar ultimo ACK (_rcv_seqnum - 1)
-		ns = sendto(sockfd, &ack, ack.h.pkt_size, 0,
+	if (!iscorrupted(&p) && p.h.pkt_type == PKT_FEC) // Paridade da FEC: sem uso aqui
+		goto rerecv;
+	if (iscorrupted(&p) || !has_dataseqnum(&p, c->rcv_seqnum)) {
+		RDT_LOG(RDT_LOG_DEBUG, "rdt_recv: iscorrupted || has_dataseqnum \n");
+		// enviar ultimo ACK (c->rcv_seqnum - 1)
+		ns = sendto(sockfd, &ack, pkt_size(&ack), 0,
 			(struct sockaddr*)src, (socklen_t)sizeof(struct sockaddr_in));
 		if (ns < 0) {
 			perror("rdt_rcv: sendto(PKT_ACK - 1)");
 			return ERROR;
 		}
+		c->ack_unsent = 0; // Os pacotes em ordem ficaram confirmados
 		goto rerecv;
 	}
-	int msg_size = p.h.pkt_size - sizeof(hdr);
+	int msg_size = pkt_size(&p) - sizeof(hdr);
 	if (msg_size > buf_len) {
-		printf("rdt_rcv(): tamanho insuficiente de buf (%d) para payload (%d).\n", 
+		RDT_LOG(RDT_LOG_INFO, "rdt_rcv(): tamanho insuficiente de buf (%d) para payload (%d).\n", 
 			buf_len, msg_size);
 		return ERROR;
 	}
 	memcpy(buf, p.msg, msg_size);
+	c->rcv_seqnum++;
+	// ACKs atrasados: o ACK sai a cada delayed_ack_count pacotes ou, na próxima chamada, no vencimento do timer
+	if (c->delayed_ack_enabled) {
+		if (c->ack_unsent++ == 0)
+			c->ack_due = now_sec() + c->delayed_ack_timeout;
+		if (c->ack_unsent < c->delayed_ack_count)
+			return msg_size;
+		c->ack_unsent = 0;
+	}
 	// enviar ACK
 
-	if (make_pkt(&ack, PKT_ACK, p.h.pkt_seq, NULL, 0) < 0)
+	if (make_pkt(&ack, PKT_ACK, pkt_seq(&p), NULL, 0) < 0)
                 return ERROR;
 
-	ns = sendto(sockfd, &ack, ack.h.pkt_size, 0,
+	ns = sendto(sockfd, &ack, pkt_size(&ack), 0,
                 (struct sockaddr*)src, (socklen_t)sizeof(struct sockaddr_in));
 	if (ns < 0) {
                 perror("rdt_rcv: sendto(PKT_ACK)");
                 return ERROR;
         }
-	_rcv_seqnum++;
-	return p.h.pkt_size - sizeof(hdr);
+	return msg_size;
 }
     
 
-// Função rdt_recv_file: recebe um arquivo e grava no sistema de arquivos.
-// O receptor espera inicialmente um PKT_START com metadados.
-int rdt_recv_file(int sockfd, const char *filename) {
-    FILE *fp = NULL; // Ponteiro para o arquivo
-    pkt p, ack; // Pacotes
-    struct sockaddr_in src; // Endereço do remetente
-    socklen_t addrlen; // Tamanho do endereço
-    fd_set readfds; // Conjunto de descritores de arquivo para select
-    struct timeval timeout; // Timeout
-    int ns, nr, rv; // Número de bytes enviados e recebidos, e valor de retorno
-    int totalBytes = 0; // Número total de bytes recebidos
+// Estado de recepção de uma transferência de arquivo (rdt_receiver_open/input/flush/close).
+// Cada conexão tem o seu, de modo que um servidor pode atender vários remetentes ao mesmo tempo.
+struct rdt_receiver {
+    rdt_conn *conn;             // Conexão (socket, remetente, sequência esperada e flags)
+    int fd;                     // Arquivo de destino
+    long offset;                // Posição no arquivo do primeiro byte desta transferência
+    long end;                   // Posição no arquivo logo após o último byte desta transferência
+    char *wbuf;                 // Buffer de escrita (alinhado), gravado com pwrite em blocos grandes
+    long wbuf_off;              // Posição no arquivo de wbuf[0]
+    int wbuf_len;               // Bytes presentes em wbuf
+    char *wbuf_alt;             // Com io_uring: segundo buffer, preenchido enquanto wbuf é gravado
+    int direct;                 // Arquivo aberto com O_DIRECT
+    pkt *rcv_buffer;            // Buffer de reordenação do Selective Repeat e do SACK (pkt_size == 0 indica slot vazio)
+    int state;                  // RDT_RX_OPEN, RDT_RX_FIN_WAIT ou RDT_RX_DONE
+    long totalBytes;            // Número total de bytes recebidos
+    pkt acks[IO_BATCH + 1];     // ACKs pendentes do lote (um por pacote, mais o cumulativo)
+    int nacks;                  // Número de ACKs pendentes
+    int cum_pending;            // Há pacotes em ordem aguardando o ACK cumulativo
+    int buffered;               // Pacotes guardados no buffer de reordenação
+    int rwnd_sent;              // Janela de recepção anunciada no último ACK
+    rdt_fec_dec *fec;           // Decodificador da FEC (NULL = desativada)
+    pkt fec_out[FEC_MAX_PARITY]; // Pacotes reconstruídos pela FEC
+    int resume;                 // Retomada aceita no PKT_START (PKT_F_RESUME)
+    rdt_ckpt *ck;               // Checkpoint dos blocos gravados (NULL = sem retomada)
+    rdt_zdec *zdec;             // Descompressor do fluxo (NULL = sem compressão)
+    rdt_delta_dec *delta;       // Decodificador do envio por diferença (NULL = arquivo inteiro)
+    char *delta_tmp;            // Arquivo temporário do envio por diferença (NULL depois de renomeado)
+    char *delta_path;           // Arquivo substituído no FIN
+    int delta_fd;               // Cópia antiga (-1 = nenhuma)
+    long delta_size;
+    int delta_block;            // Bloco das assinaturas
+    uint64_t delta_digest;      // Hash do arquivo do remetente (rdt_block_hash)
+    int fin_pending;            // FIN recebido antes do fim das cópias: o ACK sai quando terminarem
+    hseq_t fin_seq;
+};
+
+// Funcionalidades aceitas no ACK do PKT_START.
+static int rx_accepted(rdt_receiver *r) {
+    return (r->fec ? PKT_F_FEC : 0) | (r->resume ? PKT_F_RESUME : 0) | (r->zdec ? PKT_F_COMPRESS : 0)
+         | (r->delta ? PKT_F_DELTA : 0);
+}
+
+// Envia os ACKs pendentes em uma única chamada (send_pkts).
+static int rx_send_acks(rdt_receiver *r) {
+    pkt *ack_ptrs[IO_BATCH + 1];
+    for (int i = 0; i < r->nacks; i++) {
+        ack_ptrs[i] = &r->acks[i];
+        TRACE(r->conn, RDT_EV_ACK_SENT, pkt_seq(&r->acks[i]), 0);
+    }
+    r->conn->stats.acks_sent += r->nacks;
+    int rv = r->nacks > 0 ? send_pkts(r->conn, ack_ptrs, NULL, r->nacks, FALSE) : SUCCESS;
+    r->nacks = 0;
+    return rv;
+}
+
+// Janela de recepção: pacotes além do próximo esperado que cabem no espaço livre do buffer de
+// escrita, descontados os que já aguardam no buffer de reordenação e o que o envio por diferença
+// ainda vai montar, e no próprio buffer de reordenação, quando existe (no máximo SR_RCV_WINDOW).
+// No Go-Back-N, só o buffer de escrita limita.
+static int rx_window(rdt_receiver *r) {
+    long backlog = r->delta ? rdt_delta_dec_backlog(r->delta) : 0; // Bytes ainda a montar pelo envio por diferença
+    int rwnd = (WRITE_BUF_SIZE - r->wbuf_len - backlog) / r->conn->payload_size - r->buffered; // Pacotes que cabem
+    if (r->rcv_buffer && rwnd > SR_RCV_WINDOW)
+        rwnd = SR_RCV_WINDOW;
+    return rwnd < 0 ? 0 : rwnd;
+}
+
+// Acrescenta um ACK para seqnum aos ACKs pendentes. O ACK do último pacote entregue em ordem
+// também confirma os pacotes que aguardavam o ACK cumulativo.
+static int rx_queue_ack(rdt_receiver *r, hseq_t seqnum) {
+    rdt_conn *c = r->conn; // Conexão
+    if (r->nacks == IO_BATCH + 1 && rx_send_acks(r) < 0) // Fila cheia
+        return ERROR;
+    if (seqnum == c->rcv_seqnum - 1) {
+        r->cum_pending = FALSE;
+        c->ack_unsent = 0;
+    }
+    int rwnd = c->flow_control_enabled ? rx_window(r) : -1; // Janela anunciada
+    if (c->flow_control_enabled)
+        r->rwnd_sent = rwnd;
+    return make_ack(c, &r->acks[r->nacks++], seqnum, r->rcv_buffer, rwnd, r->fec ? rdt_fec_dec_loss(r->fec) : -1);
+}
+
+// Com o io_uring, a escrita anterior do buffer alternativo ainda não terminou: gravar agora
+// faria o receptor esperar o disco.
+static int rx_write_busy(rdt_receiver *r) {
+    return r->wbuf_alt && r->conn->uring && rdt_uring_writing(r->conn->uring);
+}
+
+// Confirma delivered pacotes entregues em ordem (mais de um se o pacote preencheu uma lacuna).
+// Com ACKs atrasados, o ACK cumulativo entra na fila a cada delayed_ack_count pacotes sem ACK
+// ou quando uma lacuna é preenchida (o remetente espera por ela); os demais aguardam o timer
+// em rdt_receiver_flush. Mesmo em um lote grande sai um ACK a cada delayed_ack_count pacotes:
+// se um ACK cumulativo único se perdesse, todos os pacotes do lote venceriam o timer no remetente.
+// Sem ACKs atrasados, a E/S em lote envia um ACK cumulativo por lote.
+static int rx_in_order(rdt_receiver *r, int delivered) {
+    rdt_conn *c = r->conn; // Conexão
+    if (c->delayed_ack_enabled) {
+        if (c->ack_unsent == 0) // Primeiro pacote sem ACK: arma o timer
+            c->ack_due = now_sec() + c->delayed_ack_timeout;
+        c->ack_unsent += delivered;
+        if (c->ack_unsent >= c->delayed_ack_count || delivered > 1)
+            return rx_queue_ack(r, c->rcv_seqnum - 1) < 0 ? ERROR : r->state;
+        return r->state;
+    }
+    if (c->batch_io_enabled) { // Coberto pelo ACK cumulativo do lote
+        r->cum_pending = TRUE;
+        return r->state;
+    }
+    return rx_queue_ack(r, c->rcv_seqnum - 1) < 0 ? ERROR : r->state; // ACK do pacote
+}
+
+// Grava o buffer de escrita com pwrite. Com O_DIRECT, grava só a parte que termina em uma
+// posição alinhada e mantém o restante no início do buffer; se final for 1, grava tudo
+// (o trecho final não alinhado é gravado sem O_DIRECT). Com io_uring, a escrita é submetida
+// no anel e os buffers são trocados: a recepção continua enquanto o disco grava.
+static int rx_write(rdt_receiver *r, int final) {
+    rdt_uring *u = r->conn->uring; // Anel da conexão
+    int len = r->wbuf_len; // Bytes a gravar
+    if (r->direct && !final)
+        len -= (r->wbuf_off + len) % WRITE_ALIGN;
+    if (u && r->wbuf_alt) {
+        if (rdt_uring_drain(u) < 0) // A escrita anterior ainda usa wbuf_alt
+            return ERROR;
+        if (r->ck) // Tudo antes de wbuf já está no arquivo
+            rdt_ckpt_advance(r->ck, r->wbuf_off);
+        if (!final) {
+            if (len > 0 && rdt_uring_write(u, r->fd, r->wbuf, len, r->wbuf_off) < 0)
+                return ERROR;
+            memcpy(r->wbuf_alt, r->wbuf + len, r->wbuf_len - len);
+            char *tmp = r->wbuf; // Troca os buffers
+            r->wbuf = r->wbuf_alt;
+            r->wbuf_alt = tmp;
+            r->wbuf_len -= len;
+            r->wbuf_off += len;
+            return SUCCESS;
+        }
+    }
+    if (r->direct && final && len % WRITE_ALIGN != 0) { // Trecho final sem alinhamento
+        fcntl(r->fd, F_SETFL, fcntl(r->fd, F_GETFL) & ~O_DIRECT);
+        r->direct = FALSE;
+    }
+    int done = 0; // Bytes gravados
+    while (done < len) {
+        ssize_t nw = pwrite(r->fd, r->wbuf + done, len - done, r->wbuf_off + done); // Escreve os dados no arquivo
+        if (nw < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("rdt_recv_file: pwrite");
+            return ERROR;
+        }
+        done += nw;
+    }
+    r->wbuf_len -= len;
+    r->wbuf_off += len;
+    memmove(r->wbuf, r->wbuf + len, r->wbuf_len);
+    if (r->ck)
+        rdt_ckpt_advance(r->ck, r->wbuf_off);
+    return SUCCESS;
+}
+
+// Acrescenta len bytes do arquivo ao buffer de escrita, gravando-o antes se estiver cheio.
+static int rx_append(rdt_receiver *r, const char *data, int len) {
+    if (r->wbuf_off + r->wbuf_len + len > r->end) { // O remetente não pode escrever fora do intervalo que abriu
+        fprintf(stderr, "rdt_recv_file: Dados além do intervalo do PKT_START (até o byte %ld).\n", r->end - 1);
+        return ERROR;
+    }
+    if (r->wbuf_len + len > WRITE_BUF_SIZE && rx_write(r, FALSE) < 0) // Buffer cheio
+        return ERROR;
+    memcpy(r->wbuf + r->wbuf_len, data, len);
+    r->wbuf_len += len;
+    r->totalBytes += len; // Atualiza o total de bytes recebidos
+    r->conn->stats.bytes_delivered += len;
+    return SUCCESS;
+}
+
+static int rx_emit(void *arg, const char *data, int len) {
+    return rx_append(arg, data, len);
+}
+
+// Envio por diferença: executa as instruções pendentes só até encher o buffer de escrita. Uma
+// cópia da cópia antiga continua nas próximas chamadas de rdt_receiver_flush, depois dos ACKs,
+// e enquanto isso a janela anunciada exclui o que falta montar.
+static int rx_delta_run(rdt_receiver *r) {
+    return rdt_delta_dec_run(r->delta, WRITE_BUF_SIZE - r->wbuf_len, rx_emit, r);
+}
+
+// Entrega bytes do fluxo: pelo decodificador do envio por diferença, que os transforma nos bytes
+// do novo arquivo, ou direto ao buffer de escrita.
+static int rx_output(rdt_receiver *r, const char *data, int len) {
+    if (!r->delta)
+        return rx_append(r, data, len);
+    if (rdt_delta_dec_input(r->delta, data, len) < 0)
+        return ERROR;
+    if (rdt_delta_dec_backlog(r->delta) > DELTA_QUEUE_MAX) { // Só se o remetente ignorar a janela
+        fprintf(stderr, "rdt_recv_file: Remetente ignorou a janela de recepção no envio por diferença.\n");
+        return ERROR;
+    }
+    return rx_delta_run(r);
+}
+
+// Compressão: passa o payload pelo descompressor e entrega cada quadro completo.
+static int rx_inflate(rdt_receiver *r, const char *data, int len) {
+    while (len > 0) {
+        const char *raw; // Quadro descomprimido
+        int raw_len;
+        int used = rdt_zdec_input(r->zdec, data, len, &raw, &raw_len); // Bytes consumidos
+        if (used < 0 || (raw_len > 0 && rx_output(r, raw, raw_len) < 0))
+            return ERROR;
+        data += used;
+        len -= used;
+    }
+    return SUCCESS;
+}
+
+// Entrega o payload de um pacote em ordem ao buffer de escrita. O buffer é gravado por
+// rdt_receiver_flush depois do envio dos ACKs; aqui só se estiver cheio.
+static int rx_deliver(rdt_receiver *r, pkt *pr) {
+    int dataSize = pkt_size(pr) - sizeof(hdr); // Tamanho dos dados
+    if ((r->zdec ? rx_inflate(r, pr->msg, dataSize) : rx_output(r, pr->msg, dataSize)) < 0)
+        return ERROR;
+    RDT_LOG(RDT_LOG_TRACE, "rdt_recv_file: Pacote recebido, seq %d (%d bytes).\n", pkt_seq(pr), dataSize); // Exibe mensagem de sucesso
+    r->conn->rcv_seqnum++;
+    return SUCCESS;
+}
+
+// Aumenta o buffer de recepção do socket para caber duas janelas inteiras de pacotes do tamanho
+// negociado: com payloads grandes, o buffer padrão (cerca de 200 KB) comporta poucos pacotes, e
+// o kernel descartaria o restante de cada rajada. O kernel dobra o valor pedido (e o informado
+// por getsockopt) para contar o overhead de cada datagrama e o limita a net.core.rmem_max.
+static void fit_rcvbuf(rdt_conn *c) {
+    int want = 2 * MAX_DYNAMIC_WINDOW * (c->payload_size + (int)sizeof(hdr)); // Tamanho desejado
+    int cur; // Tamanho atual (em dobro)
+    socklen_t optlen = sizeof(cur);
+    if (getsockopt(c->sockfd, SOL_SOCKET, SO_RCVBUF, &cur, &optlen) == 0 && cur / 2 >= want)
+        return;
+    if (setsockopt(c->sockfd, SOL_SOCKET, SO_RCVBUF, &want, sizeof(want)) < 0)
+        perror("rdt_recv_file: setsockopt(SO_RCVBUF)");
+}
+
+// Envio por diferença: abre a cópia antiga em filepath e o decodificador. O novo arquivo é
+// montado em um temporário e só substitui a cópia se o seu hash for o do remetente.
+static int rx_delta_open(rdt_receiver *r, const char *filepath, const start_delta *sd) {
+    int block_size = ntohl(sd->block_size);
+    if (block_size < DELTA_MIN_BLOCK || block_size > DELTA_MAX_BLOCK)
+        return ERROR;
+    int fd = open(filepath, O_RDONLY); // Cópia antiga
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size == 0) { // Nada a aproveitar
+        if (fd >= 0)
+            close(fd);
+        return ERROR;
+    }
+    size_t n = strlen(filepath) + sizeof(DELTA_SUFFIX) + 8; // Tamanho do caminho do temporário
+    r->delta_path = strdup(filepath);
+    r->delta_tmp = malloc(n);
+    r->delta = rdt_delta_dec_open(fd, st.st_size, block_size);
+    if (!r->delta_path || !r->delta_tmp || !r->delta) {
+        close(fd);
+        rdt_delta_dec_close(r->delta);
+        free(r->delta_path);
+        free(r->delta_tmp);
+        r->delta = NULL;
+        r->delta_path = r->delta_tmp = NULL;
+        return ERROR;
+    }
+    r->delta_fd = fd;
+    r->delta_size = st.st_size;
+    r->delta_block = block_size;
+    r->delta_digest = be64toh(sd->digest);
+    // Um temporário por remetente: duas transferências do mesmo arquivo não se misturam.
+    snprintf(r->delta_tmp, n, "%s" DELTA_SUFFIX ".%u", filepath, ntohs(r->conn->peer.sin_port));
+    return SUCCESS;
+}
+
+// Responde a um PKT_DELTA do remetente com as assinaturas de uma página de blocos da cópia
+// antiga, em um ACK marcado com PKT_F_DELTA. Só na conexão que aceitou o envio por diferença:
+// a cópia é a aberta no PKT_START, e nenhum nome vem da consulta.
+static int rx_delta_reply(rdt_receiver *r, pkt *query, int len) {
+    if (!r->delta || pkt_size(query) - (int)sizeof(hdr) < (int)sizeof(delta_query))
+        return ERROR;
+    delta_query dq; // Consulta no formato da rede
+    memcpy(&dq, query->msg, sizeof(dq));
+    delta_sig sigs[DELTA_PAGE]; // Assinaturas da página
+    int n = rdt_delta_sigs(r->delta_fd, r->delta_size, r->delta_block, ntohl(dq.first), sigs, DELTA_PAGE);
     
-    // Aguarda o PKT_START com os metadados do arquivo.
-    addrlen = sizeof(struct sockaddr_in); // Tamanho do endereço
-    nr = recvfrom(sockfd, &p, sizeof(pkt), 0, (struct sockaddr *)&src, &addrlen); // Recebe o pacote
-    if (nr < 0) { // Verifica erros
-        perror("rdt_recv_file: recvfrom(PKT_START)"); // Exibe mensagem de erro
+    char payload[sizeof(delta_reply) + sizeof(sigs)]; // Resposta no formato da rede
+    delta_reply rr = {.file_size = htobe64(r->delta_size), .first = dq.first, .count = htons(n)};
+    memcpy(payload, &rr, sizeof(rr));
+    for (int i = 0; i < n; i++) {
+        delta_sig sg = {htonl(sigs[i].weak), htobe64(sigs[i].strong)};
+        memcpy(payload + sizeof(rr) + i * sizeof(sg), &sg, sizeof(sg));
+    }
+    pkt ack; // Pacote ACK
+    if (build_pkt(&ack, PKT_ACK, PKT_F_DELTA, pkt_seq(query), payload, sizeof(rr) + n * sizeof(delta_sig)) < 0)
+        return ERROR;
+    if (sendto(r->conn->sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr *)&r->conn->peer, sizeof(struct sockaddr_in)) < 0) {
+        perror("rdt_recv_file: sendto(PKT_DELTA ACK)");
         return ERROR;
     }
-    if (p.h.pkt_type != PKT_START) { // Verifica se o pacote é um PKT_START
-        fprintf(stderr, "rdt_recv_file: Esperado PKT_START, recebido outro tipo.\n"); // Exibe mensagem de erro
+    return SUCCESS;
+}
+
+// Envio por diferença, no FIN: confere o hash do arquivo montado (calculado à medida que os bytes
+// são entregues) com o do remetente e só então substitui o arquivo antigo. Um FIN retransmitido
+// não renomeia de novo.
+static int rx_delta_commit(rdt_receiver *r) {
+    if (rdt_delta_dec_pending(r->delta)) {
+        fprintf(stderr, "rdt_recv_file: Fluxo por diferença terminou no meio de uma instrução, arquivo anterior mantido.\n");
         return ERROR;
     }
-    // Extrai os metadados.
-    file_meta meta; // Metadados do arquivo
-    if (p.h.pkt_size - sizeof(hdr) < sizeof(file_meta)) { // Verifica se o tamanho do pacote é suficiente
-        fprintf(stderr, "rdt_recv_file: Tamanho insuficiente para metadados.\n");
+    if (rdt_delta_dec_digest(r->delta) != r->delta_digest) {
+        fprintf(stderr, "rdt_recv_file: Arquivo montado por diferença não confere com o do remetente "
+                "(a cópia local mudou durante a transferência?), arquivo anterior mantido.\n");
         return ERROR;
     }
-    memcpy(&meta, p.msg, sizeof(file_meta)); // Copia os metadados
-    printf("rdt_recv_file: PKT_START recebido. Nome do arquivo: %s, Tamanho: %ld bytes.\n", meta.filename, meta.fileSize); // Exibe mensagem de sucesso
-    // Envia ACK para o PKT_START.
-    if (make_pkt(&ack, PKT_ACK, p.h.pkt_seq, NULL, 0) < 0) // Cria o pacote ACK
+    if (rename(r->delta_tmp, r->delta_path) < 0) {
+        perror("rdt_recv_file: rename");
         return ERROR;
-    ns = sendto(sockfd, &ack, ack.h.pkt_size, 0, (struct sockaddr *)&src, sizeof(struct sockaddr_in)); // Envia o ACK
-    if (ns < 0) { // Verifica erros
-        perror("rdt_recv_file: sendto(PKT_START ACK)"); // Exibe mensagem de erro
+    }
+    free(r->delta_tmp);
+    r->delta_tmp = NULL;
+    return SUCCESS;
+}
+
+// Responde a um PKT_RESUME do remetente com os hashes de uma página do checkpoint, em um ACK
+// marcado com PKT_F_RESUME. Só na conexão que aceitou a retomada: o arquivo é o do PKT_START,
+// e uma origem que não completou o PKT_START não recebe resposta.
+static int rx_resume_reply(rdt_receiver *r, pkt *query, int len) {
+    if (!r->resume || pkt_size(query) - (int)sizeof(hdr) < (int)sizeof(resume_query))
+        return ERROR;
+    resume_query rq; // Consulta no formato da rede
+    memcpy(&rq, query->msg, sizeof(rq));
+    uint64_t hashes[RESUME_PAGE]; // Hashes do checkpoint
+    int n = rdt_ckpt_lookup(r->ck, ntohl(rq.block_size), ntohl(rq.first), hashes, RESUME_PAGE);
+    
+    char payload[sizeof(resume_reply) + sizeof(hashes)]; // Resposta no formato da rede
+    resume_reply rr = {.first = rq.first, .count = htons(n)};
+    memcpy(payload, &rr, sizeof(rr));
+    for (int i = 0; i < n; i++) {
+        uint64_t h = htobe64(hashes[i]);
+        memcpy(payload + sizeof(rr) + i * sizeof(h), &h, sizeof(h));
+    }
+    pkt ack; // Pacote ACK
+    if (build_pkt(&ack, PKT_ACK, PKT_F_RESUME, pkt_seq(query), payload, sizeof(rr) + n * sizeof(uint64_t)) < 0)
+        return ERROR;
+    if (sendto(r->conn->sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr *)&r->conn->peer, sizeof(struct sockaddr_in)) < 0) {
+        perror("rdt_recv_file: sendto(PKT_RESUME ACK)");
         return ERROR;
     }
+    return SUCCESS;
+}
+
+// Libera o envio por diferença, removendo o temporário que não chegou a substituir o arquivo.
+static void rx_delta_close(rdt_receiver *r) {
+    if (r->delta_tmp)
+        unlink(r->delta_tmp);
+    free(r->delta_tmp);
+    free(r->delta_path);
+    rdt_delta_dec_close(r->delta);
+    if (r->delta_fd >= 0)
+        close(r->delta_fd);
+}
+
+// Abre uma transferência a partir do PKT_START recebido do outro lado da conexão c:
+// extrai e confere os metadados, cria o arquivo em receive/ e confirma o PKT_START.
+rdt_receiver *rdt_receiver_open(rdt_conn *c, pkt *start, int len) {
+    if (len < (int)sizeof(hdr) || start->h.pkt_type != PKT_START) { // Verifica se o pacote é um PKT_START
+        fprintf(stderr, "rdt_recv_file: Esperado PKT_START, recebido outro tipo.\n"); // Exibe mensagem de erro
+        return NULL;
+    }
+    // Extrai os metadados.
+    start_meta sm; // Metadados no formato da rede
+    if (pkt_size(start) - sizeof(hdr) < sizeof(start_meta)) { // Verifica se o tamanho do pacote é suficiente
+        fprintf(stderr, "rdt_recv_file: Tamanho insuficiente para metadados.\n");
+        return NULL;
+    }
+    memcpy(&sm, start->msg, sizeof(start_meta)); // Copia os metadados
+    file_meta meta; // Metadados do arquivo
+    memcpy(meta.filename, sm.filename, sizeof(meta.filename));
+    meta.filename[sizeof(meta.filename) - 1] = '\0';
+    if (!safe_filename(meta.filename)) {
+        fprintf(stderr, "rdt_recv_file: Nome de arquivo inválido no PKT_START.\n");
+        return NULL;
+    }
+    meta.fileSize = be64toh(sm.file_size);
+    meta.offset = be64toh(sm.offset);
+    meta.length = be64toh(sm.length);
+    meta.stripe_index = ntohl(sm.stripe_index);
+    meta.stripe_count = ntohl(sm.stripe_count);
+    int proposed = ntohs(sm.payload_size); // Payload proposto pelo remetente
+    if (proposed >= 1 && proposed < c->payload_size)
+        c->payload_size = proposed;
+    fit_rcvbuf(c);
+    int resume = (start->h.flags & htons(PKT_F_RESUME)) != 0; // Intervalo de uma retomada
+    if (meta.stripe_count <= 1 && !resume) { // Arquivo enviado por um único fluxo
+        meta.stripe_count = 1;
+        meta.offset = 0;
+        meta.length = meta.fileSize;
+    }
+    // O intervalo vem da rede e define ftruncate, fallocate e o limite da escrita.
+    if (meta.fileSize < 0 || meta.offset < 0 || meta.length < 0 || meta.offset > meta.fileSize - meta.length) {
+        fprintf(stderr, "rdt_recv_file: Intervalo inválido no PKT_START (%ld bytes a partir de %ld, arquivo de %ld bytes).\n",
+                meta.length, meta.offset, meta.fileSize);
+        return NULL;
+    }
+    RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: PKT_START recebido. Nome do arquivo: %s, Tamanho: %ld bytes, payload de %d bytes.\n",
+            meta.filename, meta.fileSize, c->payload_size); // Exibe mensagem de sucesso
+    if (meta.stripe_count > 1)
+        RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: Fluxo %d de %d, bytes %ld a %ld.\n", meta.stripe_index + 1, meta.stripe_count, meta.offset, meta.offset + meta.length - 1);
+    
+    rdt_receiver *r = calloc(1, sizeof(rdt_receiver));
+    if (!r) {
+        perror("rdt_recv_file: calloc");
+        return NULL;
+    }
+    r->conn = c;
+    r->fd = -1;
+    r->delta_fd = -1;
+    r->offset = meta.offset;
+    r->end = meta.offset + meta.length;
+    r->wbuf_off = meta.offset;
+    r->state = RDT_RX_OPEN;
+    r->rwnd_sent = SR_RCV_WINDOW; // Até o primeiro ACK, o remetente não conhece limite do receptor
+    r->resume = resume;
+    if (posix_memalign((void **)&r->wbuf, WRITE_ALIGN, WRITE_BUF_SIZE) != 0
+        || (c->io_uring_enabled && posix_memalign((void **)&r->wbuf_alt, WRITE_ALIGN, WRITE_BUF_SIZE) != 0)) {
+        fprintf(stderr, "rdt_recv_file: posix_memalign falhou.\n");
+        free(r->wbuf);
+        free(r);
+        return NULL;
+    }
+    
+    // FEC proposta pelo remetente: os pacotes de dados são guardados até a paridade do bloco.
+    if (start->h.flags & htons(PKT_F_FEC)) {
+        r->fec = rdt_fec_dec_open();
+        if (r->fec)
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: FEC ativada.\n");
+    }
+    
+    // Compressão proposta pelo remetente: aceita se o codec for conhecido.
+    if (start->h.flags & htons(PKT_F_COMPRESS)) {
+        start_compress sz; // Codec e nível propostos
+        if (pkt_size(start) - sizeof(hdr) >= sizeof(start_meta) + sizeof(sz)) {
+            memcpy(&sz, start->msg + sizeof(start_meta), sizeof(sz));
+            if (sz.codec == RDT_Z_LZ4)
+                r->zdec = rdt_zdec_open();
+        }
+        if (r->zdec)
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: Compressão LZ4 ativada (aceleração %d).\n", sz.level);
+    }
     
-    char filepath[100]; // Caminho do arquivo
+    char filepath[sizeof(meta.filename) + 8]; // Caminho do arquivo
     strcpy(filepath, "receive/"); // Diretório de recebimento
     strcat(filepath, meta.filename); // Adiciona o nome do arquivo
-    fp = fopen(filepath, "wb"); // Abre o arquivo para escrita
-    if (!fp) {
-        perror("rdt_recv_file: fopen");
+    
+    // Envio por diferença proposto pelo remetente: aceito para o arquivo inteiro em um único
+    // fluxo, com controle de fluxo, se houver uma cópia em receive/ a aproveitar.
+    if ((start->h.flags & htons(PKT_F_DELTA)) && meta.stripe_count == 1 && !resume && c->flow_control_enabled) {
+        start_delta sd = {0, 0}; // Bloco e hash do arquivo enviado
+        size_t at = sizeof(start_meta) + ((start->h.flags & htons(PKT_F_COMPRESS)) ? sizeof(start_compress) : 0);
+        if (pkt_size(start) - sizeof(hdr) >= at + sizeof(sd)) {
+            memcpy(&sd, start->msg + at, sizeof(sd));
+            rx_delta_open(r, filepath, &sd);
+        }
+        if (r->delta)
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: Envio por diferença ativado (blocos de %u bytes).\n", ntohl(sd.block_size));
+        else
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: Envio por diferença recusado, sem cópia local do arquivo.\n");
+    }
+    
+    // O checkpoint descreve o arquivo de dados com o tamanho que ele tinha: se o arquivo sumiu ou
+    // mudou de tamanho, o checkpoint deixa de valer antes que o ftruncate abaixo esconda a diferença.
+    struct stat st; // Arquivo de dados
+    if (resume && !r->delta && (stat(filepath, &st) < 0 || st.st_size != meta.fileSize))
+        rdt_ckpt_remove(filepath);
+    
+    // Com vários fluxos, ou na retomada, cada transferência grava o seu intervalo no mesmo
+    // arquivo: o arquivo não é truncado na abertura, apenas ajustado ao tamanho total.
+    int whole = meta.stripe_count == 1 && !resume; // Transferência do arquivo inteiro
+    int flags = O_WRONLY | O_CREAT | (whole ? O_TRUNC : 0);
+    // O_DIRECT só quando o intervalo começa em posição alinhada.
+    r->direct = c->direct_io_enabled && meta.offset % WRITE_ALIGN == 0;
+    const char *target = r->delta ? r->delta_tmp : filepath; // No envio por diferença, o temporário
+    r->fd = open(target, flags | (r->direct ? O_DIRECT : 0), 0644); // Abre o arquivo para escrita
+    if (r->fd < 0 && r->direct && errno == EINVAL) { // Sistema de arquivos sem O_DIRECT
+        RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: O_DIRECT indisponível, usando escrita normal.\n");
+        c->direct_io_enabled = r->direct = FALSE;
+        r->fd = open(target, flags, 0644);
+    }
+    if (r->fd < 0) {
+        perror("rdt_recv_file: open");
+        goto fail;
+    }
+    if (!whole && ftruncate(r->fd, meta.fileSize) < 0) {
+        perror("rdt_recv_file: ftruncate");
+        goto fail;
+    }
+    // Reserva o espaço do intervalo de uma vez, evitando a fragmentação do arquivo em
+    // extents pequenos; sem suporte do sistema de arquivos, os blocos são alocados na escrita.
+    if (meta.length > 0 && fallocate(r->fd, 0, meta.offset, meta.length) < 0 && errno != EOPNOTSUPP)
+        perror("rdt_recv_file: fallocate");
+    
+    // Retomada: o checkpoint registra os blocos do intervalo à medida que chegam ao disco. Uma
+    // transferência sem retomada substitui o arquivo, e o checkpoint anterior deixa de valer.
+    if (resume) {
+        r->ck = rdt_ckpt_open(filepath, meta.fileSize, meta.offset, meta.length);
+        if (!r->ck)
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: Checkpoint indisponível, intervalo gravado sem ele.\n");
+    } else {
+        rdt_ckpt_remove(filepath);
+    }
+    
+    // Buffer de reordenação do Selective Repeat, do SACK e da FEC: um slot por número de
+    // sequência dentro da janela de recepção.
+    if (c->selective_repeat_enabled || c->sack_enabled || r->fec) {
+        r->rcv_buffer = calloc(SR_RCV_WINDOW, sizeof(pkt));
+        if (!r->rcv_buffer) {
+            perror("rdt_recv_file: calloc");
+            goto fail;
+        }
+    }
+    
+    // Envia ACK para o PKT_START, com o payload aceito, só com o arquivo já aberto e dimensionado:
+    // se algo falhar antes, o remetente não começa a enviar para uma transferência inexistente.
+    if (rdt_start_ack(c, pkt_seq(start), rx_accepted(r)) < 0)
+        goto fail;
+    trace_begin(c);
+    return r;
+
+fail:
+    rdt_ckpt_close(r->ck);
+    if (r->fd >= 0)
+        close(r->fd);
+    rdt_fec_dec_close(r->fec);
+    rdt_zdec_close(r->zdec);
+    rx_delta_close(r);
+    free(r->wbuf);
+    free(r->wbuf_alt);
+    free(r);
+    return NULL;
+}
+
+// Processa um pacote de dados íntegro, recebido ou reconstruído pela FEC.
+static int rx_data(rdt_receiver *r, pkt *pr) {
+    rdt_conn *c = r->conn; // Conexão
+    if (r->state != RDT_RX_OPEN) // Dados após o FIN
+        return r->state;
+    
+    // Selective Repeat / SACK: armazenamento de pacotes fora de ordem no buffer de reordenação.
+    // No Selective Repeat o ACK confirma o próprio pacote (com ACKs atrasados, os pacotes em
+    // ordem são confirmados por um ACK cumulativo); com SACK, o ACK é cumulativo e carrega os
+    // intervalos já guardados acima dele.
+    if (r->rcv_buffer != NULL) {
+        if (pkt_seq(pr) >= c->rcv_seqnum + SR_RCV_WINDOW) { // Além da janela de recepção
+            RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Pacote seq %d fora da janela de recepção, descartado.\n", pkt_seq(pr));
+            c->stats.out_of_order++;
+            return r->state;
+        }
+        int in_order = (pkt_seq(pr) == c->rcv_seqnum); // Pacote esperado
+        int delivered = 0; // Pacotes entregues a partir deste
+        if (pkt_seq(pr) < c->rcv_seqnum) { // Já entregue: o ACK anterior se perdeu
+            RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Pacote duplicado seq %d, ACK reenviado.\n", pkt_seq(pr));
+            c->stats.duplicates++;
+        } else {
+            pkt *slot = &r->rcv_buffer[pkt_seq(pr) % SR_RCV_WINDOW]; // Slot do pacote no buffer
+            if (pkt_size(slot) == 0) { // Armazena apenas a primeira cópia
+                *slot = *pr;
+                r->buffered++;
+                if (!in_order) {
+                    RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Pacote fora de ordem seq %d armazenado (esperado seq %d).\n", pkt_seq(pr), c->rcv_seqnum);
+                    c->stats.out_of_order++;
+                }
+            } else {
+                c->stats.duplicates++;
+            }
+            // Entrega ao arquivo todos os pacotes consecutivos a partir do esperado.
+            slot = &r->rcv_buffer[c->rcv_seqnum % SR_RCV_WINDOW];
+            while (pkt_size(slot) != 0) {
+                if (rx_deliver(r, slot) < 0)
+                    return ERROR;
+                delivered++;
+                r->buffered--;
+                slot->h.size = 0; // Libera o slot
+                slot = &r->rcv_buffer[c->rcv_seqnum % SR_RCV_WINDOW];
+            }
+        }
+        if (in_order && (c->delayed_ack_enabled || !c->selective_repeat_enabled))
+            return rx_in_order(r, delivered);
+        if (c->selective_repeat_enabled) // ACK individual
+            return rx_queue_ack(r, pkt_seq(pr)) < 0 ? ERROR : r->state;
+        return rx_queue_ack(r, c->rcv_seqnum - 1) < 0 ? ERROR : r->state; // ACK cumulativo com SACK
+    }
+    
+    if (pkt_seq(pr) == c->rcv_seqnum) { // Se for o número de sequência esperado
+        if (rx_deliver(r, pr) < 0)
+            return ERROR;
+        return rx_in_order(r, 1);
+    }
+    RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Pacote fora de ordem (esperado seq %d).\n", c->rcv_seqnum); // Exibe mensagem de erro (pacote fora de ordem)
+    if (pkt_seq(pr) < c->rcv_seqnum)
+        c->stats.duplicates++;
+    else
+        c->stats.out_of_order++;
+    return rx_queue_ack(r, c->rcv_seqnum - 1) < 0 ? ERROR : r->state; // ACK para o último pacote
+}
+
+// FIN do cliente (ou retransmissão dele): confirma após enviar os ACKs pendentes e envia o FIN do servidor.
+// O restante do arquivo é gravado, e o checkpoint atualizado, antes do ACK: quando o remetente
+// conclui o envio, uma nova consulta de retomada já encontra todos os blocos.
+static int rx_fin(rdt_receiver *r, hseq_t seq) {
+    rdt_conn *c = r->conn; // Conexão
+    pkt ack, serverFin; // ACK do FIN e FIN do servidor
+    if (c->ack_unsent > 0) // O ACK atrasado sai antes do ACK do FIN
+        r->cum_pending = TRUE;
+    if (rdt_receiver_flush(r) < 0)
+        return ERROR;
+    if (rx_write(r, TRUE) < 0) // Grava o restante do arquivo
+        return ERROR;
+    if (r->zdec && rdt_zdec_pending(r->zdec) > 0)
+        fprintf(stderr, "rdt_recv_file: Fluxo comprimido terminou no meio de um quadro (%d bytes descartados).\n",
+                rdt_zdec_pending(r->zdec));
+    if (r->ck)
+        rdt_ckpt_flush(r->ck);
+    if (r->delta_tmp && rx_delta_commit(r) < 0) // O novo arquivo substitui o antigo
+        return ERROR;
+    if (make_pkt(&ack, PKT_ACK, seq, NULL, 0) < 0) // Cria o pacote ACK
+        return ERROR;
+    sendto(c->sockfd, &ack, pkt_size(&ack), 0,
+           (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)); // Envia o ACK
+    RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: FIN recebido do cliente. ACK enviado para FIN.\n"); // Exibe mensagem de sucesso
+    
+    if (make_pkt(&serverFin, PKT_FIN, c->snd_seqnum, NULL, 0) < 0) // Cria o pacote FIN
+        return ERROR;
+    if (sendto(c->sockfd, &serverFin, pkt_size(&serverFin), 0,
+               (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0) { // Envia o pacote FIN
+        perror("rdt_recv_file: sendto(PKT_FIN do servidor)");
         return ERROR;
     }
+    RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: FIN enviado pelo servidor (seq %d).\n", pkt_seq(&serverFin)); // Exibe mensagem de sucesso
+    r->state = RDT_RX_FIN_WAIT;
+    return r->state;
+}
+
+// Processa um datagrama recebido do remetente. Os ACKs gerados ficam pendentes até
+// rdt_receiver_flush, para que um lote inteiro seja respondido em uma única chamada: os
+// pacotes em ordem são confirmados por um único ACK cumulativo, enquanto pacotes corrompidos
+// ou fora de ordem continuam gerando ACKs duplicados para o fast retransmit.
+// Retorna o estado da transferência ou ERROR.
+int rdt_receiver_input(rdt_receiver *r, pkt *pr, int len) {
+    rdt_conn *c = r->conn; // Conexão
+    if (len < (int)sizeof(hdr) || iscorrupted(pr)) { // Verifica se o pacote está corrompido
+        RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Pacote corrompido, reenviando último ACK.\n"); // Exibe mensagem de erro
+        c->stats.corrupted++;
+        return rx_queue_ack(r, c->rcv_seqnum - 1) < 0 ? ERROR : r->state; // ACK para o último pacote
+    }
     
-    // Recebe os pacotes de dados.
-    while (1) {
+    if (pr->h.pkt_type == PKT_FIN) {
+        // Envio por diferença com cópias ainda por montar: o FIN fica para rdt_receiver_flush.
+        if (r->delta && rdt_delta_dec_backlog(r->delta) > 0) {
+            r->fin_pending = TRUE;
+            r->fin_seq = pkt_seq(pr);
+            return r->state;
+        }
+        return rx_fin(r, pkt_seq(pr));
+    }
+    
+    if (pr->h.pkt_type == PKT_ACK) { // ACK do FIN do servidor
+        if (r->state == RDT_RX_FIN_WAIT && pkt_seq(pr) == c->snd_seqnum) {
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: ACK recebido para o FIN do servidor.\n"); // Exibe mensagem de sucesso
+            r->state = RDT_RX_DONE;
+        }
+        return r->state;
+    }
+    if (pr->h.pkt_type == PKT_PROBE) { // Sondagem do PMTU
+        rdt_probe_reply(c->sockfd, &c->peer, pr, len);
+        return r->state;
+    }
+    if (pr->h.pkt_type == PKT_RESUME) { // Consulta do checkpoint
+        rx_resume_reply(r, pr, len);
+        return r->state;
+    }
+    if (pr->h.pkt_type == PKT_DELTA) { // Consulta das assinaturas
+        rx_delta_reply(r, pr, len);
+        return r->state;
+    }
+    if (pr->h.pkt_type == PKT_START) { // START retransmitido: o ACK anterior se perdeu
+        rdt_start_ack(c, pkt_seq(pr), rx_accepted(r));
+        return r->state;
+    }
+    
+    if (pr->h.pkt_type == PKT_DATA) {
+        c->stats.segments_received++;
+        TRACE(c, RDT_EV_RECV, pkt_seq(pr), 0);
+    }
+    
+    // FEC: um pacote de dados ou de paridade pode completar um bloco; os pacotes reconstruídos
+    // seguem o mesmo caminho dos recebidos, logo depois do pacote atual.
+    if (r->fec && (pr->h.pkt_type == PKT_DATA || pr->h.pkt_type == PKT_FEC)) {
+        int n = rdt_fec_dec_input(r->fec, pr, r->fec_out); // Pacotes reconstruídos
+        c->stats.fec_recovered += n;
+        int state = pr->h.pkt_type == PKT_DATA ? rx_data(r, pr) : r->state; // Estado após o pacote atual
+        for (int i = 0; i < n && state != ERROR; i++) {
+            RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Pacote seq %d reconstruído pela FEC.\n", pkt_seq(&r->fec_out[i]));
+            state = rx_data(r, &r->fec_out[i]);
+        }
+        return state;
+    }
+    if (pr->h.pkt_type != PKT_DATA)
+        return r->state;
+    return rx_data(r, pr);
+}
+
+// Envia os ACKs pendentes, incluindo o ACK cumulativo único para os pacotes em ordem do lote
+// (com ACKs atrasados, só se houver pacotes suficientes ou o timer tiver vencido).
+// Só depois dos ACKs o buffer de escrita é gravado, se tiver passado da metade, para que a
+// escrita em disco não atrase a confirmação.
+int rdt_receiver_flush(rdt_receiver *r) {
+    rdt_conn *c = r->conn; // Conexão
+    if (c->stats_interval > 0)
+        stats_tick(c, "rdt_recv_file");
+    if (r->cum_pending || (c->ack_unsent > 0 && now_sec() >= c->ack_due)) {
+        if (rx_queue_ack(r, c->rcv_seqnum - 1) < 0)
+            return ERROR;
+    }
+    if (rx_send_acks(r) < 0)
+        return ERROR;
+    // Com o io_uring, enquanto o disco grava o buffer anterior, os pacotes continuam no buffer
+    // de escrita e a janela anunciada diminui; quando a escrita termina, um ACK avisa o
+    // remetente de que a janela voltou a abrir.
+    if (r->wbuf_len >= WRITE_BUF_SIZE / 2 && !rx_write_busy(r) && rx_write(r, FALSE) < 0)
+        return ERROR;
+    // Envio por diferença: a cópia em andamento continua no espaço liberado, e o FIN que a
+    // aguardava é concluído quando ela termina.
+    if (r->delta && r->state == RDT_RX_OPEN && rx_delta_run(r) < 0)
+        return ERROR;
+    if (r->fin_pending && rdt_delta_dec_backlog(r->delta) == 0) {
+        r->fin_pending = FALSE;
+        return rx_fin(r, r->fin_seq) < 0 ? ERROR : SUCCESS;
+    }
+    if (c->flow_control_enabled && r->state == RDT_RX_OPEN && r->rwnd_sent < rx_window(r) / 2) {
+        RDT_LOG(RDT_LOG_DEBUG, "rdt_recv_file: Janela de recepção reaberta (%d pacotes).\n", rx_window(r));
+        if (rx_queue_ack(r, c->rcv_seqnum - 1) < 0 || rx_send_acks(r) < 0)
+            return ERROR;
+    }
+    return SUCCESS;
+}
+
+// Tempo (s) até o vencimento do ACK atrasado pendente (0 se já venceu, ou se o envio por
+// diferença tiver cópias a continuar), ou -1 se não houver: o laço de recepção deve chamar
+// rdt_receiver_flush até lá, mesmo sem novos pacotes.
+double rdt_receiver_ack_delay(rdt_receiver *r) {
+    rdt_conn *c = r->conn; // Conexão
+    if (r->delta && rdt_delta_dec_backlog(r->delta) > 0)
+        return 0;
+    if (c->ack_unsent == 0)
+        return -1;
+    double remaining = c->ack_due - now_sec(); // Tempo até o vencimento
+    return remaining > 0 ? remaining : 0;
+}
+
+// Estado atual da transferência (RDT_RX_OPEN, RDT_RX_FIN_WAIT ou RDT_RX_DONE).
+int rdt_receiver_state(rdt_receiver *r) {
+    return r->state;
+}
+
+// Funcionalidades (PKT_F_*) aceitas no ACK do PKT_START, para repeti-lo após o encerramento.
+int rdt_receiver_accepted(rdt_receiver *r) {
+    return rx_accepted(r);
+}
+
+// Grava o restante do buffer, fecha o arquivo e libera o estado da transferência.
+// Retorna o total de bytes recebidos ou ERROR.
+long rdt_receiver_close(rdt_receiver *r) {
+    long totalBytes = r->totalBytes;
+    trace_end(r->conn);
+    if (rx_write(r, TRUE) < 0)
+        totalBytes = ERROR;
+    rdt_ckpt_close(r->ck);
+    close(r->fd);
+    free(r->wbuf);
+    free(r->wbuf_alt);
+    free(r->rcv_buffer);
+    rdt_fec_dec_close(r->fec);
+    rdt_zdec_close(r->zdec);
+    rx_delta_close(r);
+    free(r);
+    return totalBytes;
+}
+
+// Função rdt_recv_file: recebe um arquivo na conexão c e grava no sistema de arquivos.
+// O receptor espera inicialmente um PKT_START com metadados; o remetente fica em c->peer.
+long rdt_recv_file(rdt_conn *c, const char *filename) {
+    pkt p; // Pacote
+    socklen_t addrlen; // Tamanho do endereço
+    fd_set readfds; // Conjunto de descritores de arquivo para select
+    int nr; // Número de bytes recebidos
+    
+    // Aguarda o PKT_START com os metadados do arquivo, respondendo às sondagens do PMTU que o precedem.
+    do {
         addrlen = sizeof(struct sockaddr_in); // Tamanho do endereço
-        nr = recvfrom(sockfd, &p, sizeof(pkt), 0, (struct sockaddr *)&src, &addrlen); // Recebe o pacote
+        nr = recvfrom(c->sockfd, &p, sizeof(pkt), 0, (struct sockaddr *)&c->peer, &addrlen); // Recebe o pacote
         if (nr < 0) { // Verifica erros
-            perror("rdt_recv_file: recvfrom()");
-            fclose(fp);
+            perror("rdt_recv_file: recvfrom(PKT_START)"); // Exibe mensagem de erro
             return ERROR;
         }
-        
-        if (iscorrupted(&p)) { // Verifica se o pacote está corrompido
-            printf("rdt_recv_file: Pacote corrompido, reenviando último ACK.\n"); // Exibe mensagem de erro
-            if (make_pkt(&ack, PKT_ACK, _rcv_seqnum - 1, NULL, 0) < 0) { // Cria o pacote ACK para o último pacote
-                fclose(fp);
-                return ERROR;
-            }
-            sendto(sockfd, &ack, ack.h.pkt_size, 0,
-                   (struct sockaddr *)&src, sizeof(struct sockaddr_in)); // Envia o ACK
-            continue;
+    } while (rdt_probe_reply(c->sockfd, &c->peer, &p, nr) == SUCCESS);
+    rdt_receiver *r = rdt_receiver_open(c, &p, nr); // Abre a transferência
+    if (!r)
+        return ERROR;
+    if (c->io_uring_enabled) {
+        c->uring = rdt_uring_open(c->sockfd);
+        if (!c->uring) {
+            RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: io_uring indisponível, usando recvmmsg.\n");
+            c->io_uring_enabled = FALSE;
         }
-        
-        // Se for um pacote FIN, inicia o handshake de terminação.
-        if (p.h.pkt_type == PKT_FIN) {
-            if (make_pkt(&ack, PKT_ACK, p.h.pkt_seq, NULL, 0) < 0) { // Cria o pacote ACK
-                fclose(fp);
-                return ERROR;
-            }
-            sendto(sockfd, &ack, ack.h.pkt_size, 0,
-                   (struct sockaddr *)&src, sizeof(struct sockaddr_in)); // Envia o ACK
-            printf("rdt_recv_file: FIN recebido do cliente. ACK enviado para FIN.\n"); // Exibe mensagem de sucesso
-            
-            // Envia FIN do servidor.
-            pkt serverFin; // Pacote FIN do servidor
-            if (make_pkt(&serverFin, PKT_FIN, _snd_seqnum, NULL, 0) < 0) { // Cria o pacote FIN
-                fclose(fp);
-                return ERROR;
-            }
-            ns = sendto(sockfd, &serverFin, serverFin.h.pkt_size, 0,
-                        (struct sockaddr *)&src, sizeof(struct sockaddr_in)); // Envia o pacote FIN
-            if (ns < 0) {
-                perror("rdt_recv_file: sendto(PKT_FIN do servidor)");
-                fclose(fp);
-                return ERROR;
-            }
-            printf("rdt_recv_file: FIN enviado pelo servidor (seq %d).\n", serverFin.h.pkt_seq); // Exibe mensagem de sucesso
-            
-            // Aguarda ACK para o FIN do servidor.
-            FD_ZERO(&readfds); // Limpa o conjunto de descritores
-            FD_SET(sockfd, &readfds); // Adiciona o socket ao conjunto
-            timeout.tv_sec = current_timeout_sec; // Timeout em segundos
-            timeout.tv_usec = current_timeout_usec; // Timeout em microssegundos
-            rv = select(sockfd + 1, &readfds, NULL, NULL, &timeout); // Aguarda o recebimento de ACK
-            if (rv > 0) { // Se houve dados para leitura
-                socklen_t ackAddrLen = sizeof(struct sockaddr_in); // Tamanho do endereço
-                nr = recvfrom(sockfd, &ack, sizeof(pkt), 0, (struct sockaddr *)&src, &ackAddrLen); // Recebe o ACK
-                if (nr > 0 && ack.h.pkt_type == PKT_ACK && ack.h.pkt_seq == serverFin.h.pkt_seq) { // Se o ACK for válido
-                    printf("rdt_recv_file: ACK recebido para o FIN do servidor.\n"); // Exibe mensagem de sucesso
-                }
-            }
-            break; // Encerra o loop
+    }
+    if (!c->uring) // O anel recebe datagramas de até um pkt, sem coalescência
+        enable_udp_gro(c);
+    
+    // Recebe os pacotes de dados. Cada iteração drena em lote os pacotes já na fila do socket
+    // (recv_pkts, ou os buffers do anel) e responde com os ACKs do lote em uma única chamada.
+    // Com payloads grandes o lote passa de meio megabyte: fica no heap, e não na pilha.
+    pkt *rx = malloc(IO_BATCH * sizeof(pkt)); // Pacotes do lote
+    pkt *rxp[IO_BATCH]; // Pacotes do lote (em rx ou nos buffers do anel)
+    int rx_len[IO_BATCH]; // Tamanho de cada datagrama
+    struct sockaddr_in rx_src[IO_BATCH]; // Origem de cada datagrama
+    int state = RDT_RX_OPEN; // Estado da transferência
+    if (!rx) {
+        perror("rdt_recv_file: malloc");
+        goto fail;
+    }
+    for (int i = 0; i < IO_BATCH; i++)
+        rxp[i] = &rx[i];
+    
+    while (state == RDT_RX_OPEN) {
+        // Com um ACK atrasado pendente, a espera pelo próximo lote termina no vencimento do timer.
+        double ack_delay = rdt_receiver_ack_delay(r); // Tempo até o ACK atrasado (-1 = nenhum)
+        int n; // Pacotes recebidos
+        if (c->uring) {
+            n = rdt_uring_recv(c->uring, rxp, rx_len, rx_src, IO_BATCH, ack_delay);
+        } else if (ack_delay >= 0) {
+            struct timeval wait = {(long)ack_delay, (long)((ack_delay - (long)ack_delay) * 1000000)}; // Espera
+            FD_ZERO(&readfds);
+            FD_SET(c->sockfd, &readfds);
+            n = select(c->sockfd + 1, &readfds, NULL, NULL, &wait);
+            if (n > 0)
+                n = recv_pkts(c, rx, rx_len, rx_src, IO_BATCH);
+        } else {
+            n = recv_pkts(c, rx, rx_len, rx_src, IO_BATCH); // Recebe o lote
         }
-        
-        if (p.h.pkt_type == PKT_DATA && p.h.pkt_seq == _rcv_seqnum) { // Se for um pacote de dados e o número de sequência esperado
-            int dataSize = p.h.pkt_size - sizeof(hdr); // Tamanho dos dados
-            if (fwrite(p.msg, 1, dataSize, fp) != dataSize) { // Escreve os dados no arquivo
-                perror("rdt_recv_file: fwrite");
-                fclose(fp);
-                return ERROR;
-            }
-            totalBytes += dataSize; // Atualiza o total de bytes recebidos
-            printf("rdt_recv_file: Pacote recebido, seq %d (%d bytes).\n", p.h.pkt_seq, dataSize);  // Exibe mensagem de sucesso
-            if (make_pkt(&ack, PKT_ACK, p.h.pkt_seq, NULL, 0) < 0) { // Cria o pacote ACK
-                fclose(fp);
-                return ERROR;
-            }
-            sendto(sockfd, &ack, ack.h.pkt_size, 0,
-                   (struct sockaddr *)&src, sizeof(struct sockaddr_in)); // Envia o ACK
-            _rcv_seqnum++;
+        if (n < 0) // Verifica erros
+            goto fail;
+        for (int i = 0; i < n && state != ERROR; i++)
+            state = rdt_receiver_input(r, rxp[i], rx_len[i]);
+        if (state == ERROR || rdt_receiver_flush(r) < 0) // Envia os ACKs do lote
+            goto fail;
+        state = rdt_receiver_state(r); // Um FIN adiado pelo envio por diferença termina no flush
+    }
+    
+    // Aguarda ACK para o FIN do servidor (ou retransmissões do FIN do cliente).
+    struct timeval timeout = {(long)c->static_timeout, (long)((c->static_timeout - (long)c->static_timeout) * 1000000)}; // Timeout
+    double deadline = now_sec() + c->static_timeout; // Fim da espera (io_uring)
+    while (state == RDT_RX_FIN_WAIT) {
+        pkt *fp = &p; // Pacote recebido
+        if (c->uring) {
+            if (rdt_uring_recv(c->uring, &fp, &nr, NULL, 1, deadline - now_sec()) <= 0)
+                break;
         } else {
-            printf("rdt_recv_file: Pacote fora de ordem (esperado seq %d).\n", _rcv_seqnum); // Exibe mensagem de erro (pacote fora de ordem)
-            if (make_pkt(&ack, PKT_ACK, _rcv_seqnum - 1, NULL, 0) < 0) { // Cria o pacote ACK para o último pacote
-                fclose(fp);
-                return ERROR;
-            }
-            sendto(sockfd, &ack, ack.h.pkt_size, 0,
-                   (struct sockaddr *)&src, sizeof(struct sockaddr_in)); // Envia o ACK
+            FD_ZERO(&readfds); // Limpa o conjunto de descritores
+            FD_SET(c->sockfd, &readfds); // Adiciona o socket ao conjunto
+            if (select(c->sockfd + 1, &readfds, NULL, NULL, &timeout) <= 0) // Aguarda o recebimento de ACK
+                break;
+            nr = recvfrom(c->sockfd, &p, sizeof(pkt), 0, NULL, NULL); // Recebe o ACK
+            if (nr < 0)
+                break;
         }
+        state = rdt_receiver_input(r, fp, nr);
     }
     
-    fclose(fp);
-    printf("rdt_recv_file: Transferência concluída. Total de bytes recebidos: %d\n", totalBytes); // Exibe mensagem de sucesso
+    free(rx);
+    long totalBytes = rdt_receiver_close(r);
+    rdt_uring_close(c->uring);
+    c->uring = NULL;
+    if (totalBytes < 0)
+        return ERROR;
+    RDT_LOG(RDT_LOG_INFO, "rdt_recv_file: Transferência concluída. Total de bytes recebidos: %ld\n", totalBytes); // Exibe mensagem de sucesso
     return totalBytes;
-}
\ No newline at end of file
+
+fail:
+    free(rx);
+    rdt_receiver_close(r);
+    rdt_uring_close(c->uring);
+    c->uring = NULL;
+    return ERROR;
+}
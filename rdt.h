@@ -2,11 +2,20 @@
 #define RDT_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
+#include "rdt_log.h"
 
-// Tamanho máximo do payload de cada pacote.
-#define MAX_MSG_LEN 1024
+// Tamanho máximo do payload de cada pacote: um quadro jumbo de 9000 bytes menos os headers
+// IP (20), UDP (8) e RDT (14). O tamanho usado em cada conexão é negociado no PKT_START.
+#define MAX_MSG_LEN 8958
+// Payload padrão: cabe em um MTU de 1500 bytes, com folga para túneis.
+#define DEFAULT_MSG_LEN 1400
+
+// Versão do formato dos pacotes (campo version do header).
+#define RDT_VERSION 1
 
 // Definições de valores lógicos e de retorno.
 #define TRUE    1
@@ -19,18 +28,43 @@ typedef enum {
     PKT_DATA  = 0,   // Pacote de dados
     PKT_ACK   = 1,   // Acknowledgment
     PKT_FIN   = 2,   // Indica fim da transmissão do arquivo
-    PKT_START = 3    // Pacote de início, contendo metadados do arquivo
+    PKT_START = 3,   // Pacote de início, contendo metadados do arquivo
+    PKT_PROBE = 4,   // Sondagem do MTU do caminho (payload de preenchimento)
+    PKT_FEC   = 5,   // Paridade de um bloco de pacotes de dados (rdt_fec.h)
+    PKT_RESUME = 6,  // Consulta do checkpoint do receptor, na conexão da retomada (rdt_resume.h)
+    PKT_DELTA = 7    // Consulta das assinaturas dos blocos do receptor, na conexão (rdt_delta.h)
 } htype_t;
 
+// Flags do header.
+#define PKT_F_PROBE 0x0001 // ACK de um PKT_PROBE (seq = MTU sondado)
+#define PKT_F_FEC   0x0002 // PKT_START e seu ACK: FEC proposta / aceita; demais ACKs: os 2 últimos
+                           // bytes do payload trazem a perda medida pelo receptor (por mil, uint16_t)
+#define PKT_F_CUM   0x0004 // ACK do Selective Repeat que confirma todos os pacotes até seq
+#define PKT_F_RWND  0x0008 // ACK com a janela de recepção (uint16_t, pacotes além de seq) após os blocos SACK
+#define PKT_F_RESUME 0x0010 // PKT_START e seu ACK: retomada (intervalo gravado sem truncar o arquivo);
+                            // ACK de um PKT_RESUME: hashes dos blocos (resume_reply)
+#define PKT_F_COMPRESS 0x0020 // PKT_START e seu ACK: compressão do fluxo proposta / aceita (rdt_compress.h)
+#define PKT_F_DELTA 0x0040 // PKT_START e seu ACK: envio por diferença proposto / aceito;
+                           // ACK de um PKT_DELTA: assinaturas dos blocos (rdt_delta.h)
+
+// Algoritmos de verificação de integridade (checksum_algorithm).
+typedef enum {
+    CSUM_INET   = 0, // Soma de 16 bits em complemento de um (Internet checksum)
+    CSUM_CRC32C = 1  // CRC32C (Castagnoli)
+} csum_algo_t;
+
 // Definição do tipo de sequência.
 typedef uint32_t hseq_t;
 
-// Estrutura do header do pacote.
-typedef struct {
-    int    pkt_size;    // Tamanho total do pacote (header + payload)
-    unsigned short csum; // Checksum do pacote (para detecção de erros)
-    htype_t pkt_type;   // Tipo do pacote (DATA, ACK, FIN ou START)
-    hseq_t  pkt_seq;    // Número de sequência do pacote
+// Estrutura do header do pacote, no formato da rede: sem preenchimento entre os campos e com
+// os campos de mais de um byte na ordem de bytes da rede (use pkt_size e pkt_seq para lê-los).
+typedef struct __attribute__((packed)) {
+    uint8_t  version;   // Versão do formato (RDT_VERSION)
+    uint8_t  pkt_type;  // Tipo do pacote (DATA, ACK, FIN ou START)
+    uint16_t flags;     // Flags do pacote (PKT_F_*; ignoradas se desconhecidas)
+    uint16_t size;      // Tamanho total do pacote (header + payload)
+    uint32_t seq;       // Número de sequência do pacote
+    uint32_t csum;      // Checksum do pacote (para detecção de erros)
 } hdr;
 
 // Estrutura do pacote, com header e espaço para payload.
@@ -39,28 +73,164 @@ typedef struct {
     char msg[MAX_MSG_LEN];
 } pkt;
 
-// Estrutura para metadados do arquivo (usada no PKT_START)
+// Campos do header na ordem de bytes do host.
+static inline int pkt_size(const pkt *p) { return ntohs(p->h.size); }
+static inline hseq_t pkt_seq(const pkt *p) { return ntohl(p->h.seq); }
+
+// Número máximo de blocos SACK transportados no payload de um PKT_ACK.
+#define MAX_SACK_BLOCKS 8
+
+// Bloco SACK: intervalo [start, end] de pacotes recebidos acima do ACK cumulativo, no formato da rede.
+typedef struct {
+    hseq_t start;
+    hseq_t end;
+} sack_block;
+
+// Estrutura para metadados do arquivo (usada no PKT_START).
+// Um arquivo pode ser dividido em intervalos enviados por fluxos paralelos, cada um com
+// seu próprio PKT_START; o receptor grava cada intervalo na sua posição do arquivo.
+// rdt_start converte os campos para o formato da rede antes de enviá-los.
 typedef struct {
     char filename[256];
-    long fileSize;
+    long fileSize;      // Tamanho total do arquivo
+    long offset;        // Posição do primeiro byte enviado por este fluxo
+    long length;        // Bytes enviados por este fluxo
+    int stripe_index;   // Índice do fluxo (0 a stripe_count - 1)
+    int stripe_count;   // Número de fluxos paralelos (1 = arquivo inteiro em um fluxo)
 } file_meta;
 
+// Contexto de uma conexão: números de sequência, estimativa de RTT, janela, flags e gerador
+// aleatório. Cada transferência usa o seu, de modo que várias conexões podem ser conduzidas
+// em paralelo (inclusive em threads distintas) no mesmo processo.
+struct rdt_cc_ops;
+struct rdt_uring;
+typedef struct {
+    int sockfd;                 // Socket da conexão
+    struct sockaddr_in peer;    // Endereço do outro lado
+    hseq_t snd_seqnum;          // Próximo número de sequência a enviar
+    hseq_t rcv_seqnum;          // Próximo número de sequência esperado
+    // Estimativa do RTT e timeout (RFC 6298)
+    double estimate_rtt;        // EstimateRTT (0 = nenhuma amostra ainda)
+    double dev_rtt;             // DevRTT
+    double rto;                 // TimeoutInterval atual, com backoff (s)
+    double static_timeout;      // Timeout estático e espera pelos FINs (s)
+    int window_size;            // Janela de transmissão atual (pacotes)
+    int payload_size;           // Payload dos pacotes de dados (negociado no PKT_START e ajustado pelo PMTU)
+    int payload_max;            // Maior payload aceito pelo receptor
+    int pmtu_mode;              // Modo IP_MTU_DISCOVER usado nos pacotes de dados
+    hseq_t pmtu_fallback_end;   // Pacotes anteriores a este, maiores que o caminho, vão fragmentados
+    int pmtu_failed;            // Payload recusado pelo caminho desde a última sondagem periódica (0 = nenhum)
+    // Flags da conexão (os valores padrão são as variáveis globais de mesmo nome)
+    int biterror_inject;
+    int dynamic_window_enabled;
+    int dynamic_timeout_enabled;
+    int fast_retransmit_enabled;
+    int selective_repeat_enabled;
+    int sack_enabled;
+    int batch_io_enabled;
+    int udp_offload_enabled;
+    int direct_io_enabled;
+    int io_uring_enabled;
+    int pmtu_discovery_enabled;
+    int fec_enabled;            // Ativa só se o receptor aceitar no ACK do PKT_START
+    int delayed_ack_enabled;
+    int flow_control_enabled;
+    int pacing_enabled;
+    int resume_enabled;         // Propõe a retomada no PKT_START (rdt_resume.h)
+    int compress_enabled;       // Propõe a compressão no PKT_START; ativa só se o receptor aceitar
+    int compress_level;         // Aceleração do LZ4 proposta (rdt_compress.h)
+    int delta_enabled;          // Propõe o envio por diferença no PKT_START; ativa só se o receptor aceitar
+    int delta_block;            // Bloco das assinaturas (rdt_delta.h)
+    uint64_t delta_digest;      // Hash do arquivo enviado, conferido pelo receptor no FIN
+    int delayed_ack_count;      // Pacotes em ordem por ACK cumulativo
+    double delayed_ack_timeout; // Atraso máximo de um ACK (s)
+    int ack_unsent;             // Pacotes em ordem entregues ainda sem ACK (ACKs atrasados)
+    double ack_due;             // Vencimento do ACK atrasado
+    struct rdt_uring *uring;    // Anel io_uring em uso (NULL = select e sendmmsg / recvmmsg)
+    const struct rdt_cc_ops *cc_algorithm; // Controle de congestionamento (rdt_cc.h)
+    uint64_t rng;               // Estado do gerador aleatório da conexão
+    rdt_stats stats;            // Contadores (rdt_stats_get)
+    double stats_interval;      // Intervalo entre as impressões dos contadores (s, 0 = nenhuma)
+    double stats_next;          // Próxima impressão
+    const char *trace_path;     // Prefixo do arquivo do trace (NULL = desativado)
+    int trace_capacity;         // Eventos guardados no anel do trace
+    rdt_trace *trace;           // Anel do trace durante a transferência
+} rdt_conn;
+
 // Declaração das funções do protocolo.
-unsigned short checksum(unsigned short *buf, int nbytes);
+uint32_t checksum(const void *buf, int nbytes);
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len);
 int iscorrupted(pkt *pr);
 int make_pkt(pkt *p, htype_t type, hseq_t seqnum, void *msg, int msg_len);
-int rdt_send(int sockfd, void *buf, int buf_len, struct sockaddr_in *dst);
-int rdt_recv(int sockfd, void *buf, int buf_len, struct sockaddr_in *src);
-int rdt_close(int sockfd, struct sockaddr_in *dst, int snd_seqnum);
-int rdt_recv_file(int sockfd, const char *filename);
+void rdt_conn_init(rdt_conn *c, int sockfd, struct sockaddr_in *peer);
+int rdt_start(rdt_conn *c, file_meta *meta);
+int rdt_send(rdt_conn *c, void *buf, int buf_len);
+int rdt_recv(rdt_conn *c, void *buf, int buf_len);
+int rdt_close(rdt_conn *c);
+int rdt_start_ack(rdt_conn *c, hseq_t seqnum, int flags);
+long rdt_recv_file(rdt_conn *c, const char *filename);
+int rdt_probe_reply(int sockfd, struct sockaddr_in *dst, pkt *probe, int len);
+int rdt_resume_query(rdt_conn *c, long first, uint64_t *hashes);
+void rdt_stats_get(const rdt_conn *c, rdt_stats *out);
 
-// Variáveis globais para gerenciar a sequência.
-extern int biterror_inject;
-extern hseq_t _snd_seqnum;
-extern hseq_t _rcv_seqnum;
+// Fluxo de envio persistente: mantém janela, RTT e pacotes em trânsito entre as escritas.
+typedef struct rdt_stream rdt_stream;
+rdt_stream *rdt_stream_open(rdt_conn *c);
+int rdt_stream_write(rdt_stream *s, void *buf, int buf_len);
+int rdt_stream_write_zc(rdt_stream *s, const void *buf, long buf_len);
+int rdt_stream_flush(rdt_stream *s);
+int rdt_stream_close(rdt_stream *s);
 
-// Variáveis globais para a janela de transmissão dinâmica.
+// Receptor de arquivo por conexão: guarda o estado de uma transferência (sequência esperada,
+// buffer de reordenação, arquivo), permitindo atender vários remetentes no mesmo processo.
+typedef enum {
+    RDT_RX_OPEN     = 0,  // Recebendo dados
+    RDT_RX_FIN_WAIT = 1,  // FIN do cliente confirmado, aguardando ACK do FIN do servidor
+    RDT_RX_DONE     = 2   // Handshake de terminação concluído
+} rdt_rx_state;
+typedef struct rdt_receiver rdt_receiver;
+rdt_receiver *rdt_receiver_open(rdt_conn *c, pkt *start, int len);
+int rdt_receiver_input(rdt_receiver *r, pkt *p, int len);
+int rdt_receiver_flush(rdt_receiver *r);
+double rdt_receiver_ack_delay(rdt_receiver *r);
+int rdt_receiver_state(rdt_receiver *r);
+int rdt_receiver_accepted(rdt_receiver *r);
+long rdt_receiver_close(rdt_receiver *r);
+
+// E/S em lote: recebe até max datagramas (0 se o socket não bloqueante estiver vazio).
+int recv_pkts(rdt_conn *c, pkt *pkts, int *lens, struct sockaddr_in *srcs, int max);
+void enable_udp_gro(rdt_conn *c);
+
+// Valores padrão das flags copiadas por rdt_conn_init.
+extern int biterror_inject;
 extern int dynamic_window_enabled;  // 0 = janela estática, 1 = janela dinâmica
-extern int current_window_size;
+extern int dynamic_timeout_enabled;
+extern int current_timeout_sec;     // Timeout estático (s e us)
+extern int current_timeout_usec;
+extern int fast_retransmit_enabled;
+extern int selective_repeat_enabled;
+extern int sack_enabled;
+extern int batch_io_enabled;
+extern int udp_offload_enabled;
+extern int direct_io_enabled;
+extern int io_uring_enabled;
+extern int pmtu_discovery_enabled;
+extern int fec_enabled;
+extern int fec_block_size;          // Pacotes de dados por bloco da FEC (até FEC_MAX_DATA)
+extern int delayed_ack_enabled;
+extern int flow_control_enabled;
+extern int pacing_enabled;
+extern int resume_enabled;
+extern int compress_enabled;
+extern int compress_level;          // Aceleração do LZ4 (1 = mais compressão; maiores, mais velocidade)
+extern int delta_enabled;
+extern double stats_interval;       // Intervalo entre as impressões dos contadores (s, 0 = nenhuma)
+extern const char *trace_path;      // Prefixo dos arquivos do trace (NULL = desativado)
+extern int trace_capacity;          // Eventos guardados no anel do trace de cada conexão
+extern int delayed_ack_count;       // Pacotes em ordem por ACK cumulativo
+extern double delayed_ack_timeout;  // Atraso máximo de um ACK (s)
+extern int payload_size;            // Payload proposto no PKT_START (até MAX_MSG_LEN)
+extern int checksum_algorithm;      // CSUM_INET ou CSUM_CRC32C (global, não copiada para a conexão)
 
 #endif
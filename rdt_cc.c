@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <string.h>
+#include "rdt.h"
+#include "rdt_cc.h"
+
+// Parâmetros do CUBIC (RFC 8312).
+#define CUBIC_C    0.4
+#define CUBIC_BETA 0.7
+
+// Parâmetros do algoritmo baseado em atraso (estilo BBR).
+#define BBR_STARTUP     0
+#define BBR_DRAIN       1
+#define BBR_PROBE_BW    2
+#define BBR_HIGH_GAIN   2.885   // 2/ln(2): ganho da fase de STARTUP
+#define BBR_CWND_GAIN   2.0     // Janela = BBR_CWND_GAIN * BDP * ganho da fase
+#define BBR_CYCLE_LEN   8
+#define BBR_MIN_RTT_WIN 10.0    // Validade da medição de min_rtt (s)
+#define BBR_BW_ROUNDS   10      // Rodadas do filtro de máximo da banda
+
+static const double bbr_cycle_gain[BBR_CYCLE_LEN] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+
+// Algoritmo usado pelos novos fluxos de envio.
+const rdt_cc_ops *cc_algorithm = &rdt_cc_aimd;
+
+// Mantém a janela dentro dos limites configurados.
+static void clamp_cwnd(rdt_cc *cc) {
+    if (cc->cwnd < cc->min_cwnd)
+        cc->cwnd = cc->min_cwnd;
+    if (cc->cwnd > cc->max_cwnd)
+        cc->cwnd = cc->max_cwnd;
+}
+
+// Atualiza o RTT suavizado e o menor RTT observado (comum a todos os algoritmos).
+static void update_rtt(rdt_cc *cc, double rtt) {
+    cc->srtt = (cc->srtt == 0) ? rtt : 0.875 * cc->srtt + 0.125 * rtt;
+    if (cc->min_rtt == 0 || rtt < cc->min_rtt)
+        cc->min_rtt = rtt;
+}
+
+// Raiz cúbica por Newton, evitando a dependência da libm.
+static double cube_root(double x) {
+    if (x <= 0)
+        return 0;
+    double r = (x > 1) ? x : 1;
+    for (int i = 0; i < 40; i++)
+        r = r - (r * r * r - x) / (3 * r * r);
+    return r;
+}
+
+/* ---------- AIMD: aumento aditivo de 1 pacote por janela confirmada, redução pela metade ---------- */
+
+static void aimd_init(rdt_cc *cc) {
+    cc->acked_count = 0;
+}
+
+static void aimd_on_ack(rdt_cc *cc, int acked, double now) {
+    cc->acked_count += acked;
+    // Quando todos os ACKs da janela foram recebidos, a janela aumenta em 1.
+    if (cc->acked_count >= cc->cwnd && cc->cwnd < cc->max_cwnd) {
+        cc->acked_count -= cc->cwnd;
+        cc->cwnd += 1;
+        clamp_cwnd(cc);
+    }
+}
+
+static void aimd_on_loss(rdt_cc *cc, int is_timeout, double now) {
+    cc->cwnd = (int)(cc->cwnd / 2); // Divide a janela por 2
+    cc->acked_count = 0; // Contador recomeça a partir da janela diminuída
+    clamp_cwnd(cc);
+}
+
+static void aimd_on_rtt_sample(rdt_cc *cc, double rtt, double now) {
+    update_rtt(cc, rtt);
+}
+
+const rdt_cc_ops rdt_cc_aimd = {"aimd", aimd_init, aimd_on_ack, aimd_on_loss, aimd_on_rtt_sample};
+
+/* ---------- CUBIC: crescimento cúbico em função do tempo desde a última perda ---------- */
+
+static void cubic_init(rdt_cc *cc) {
+    cc->ssthresh = cc->max_cwnd; // Começa em slow start
+    cc->w_max = 0;
+    cc->epoch_start = 0;
+}
+
+static void cubic_on_ack(rdt_cc *cc, int acked, double now) {
+    if (cc->cwnd < cc->ssthresh) { // Slow start
+        cc->cwnd += acked;
+        clamp_cwnd(cc);
+        return;
+    }
+    if (cc->epoch_start == 0) { // Início de uma nova época após a perda
+        cc->epoch_start = now;
+        if (cc->cwnd < cc->w_max) {
+            cc->k = cube_root((cc->w_max - cc->cwnd) / CUBIC_C);
+        } else {
+            cc->k = 0;
+            cc->w_max = cc->cwnd;
+        }
+    }
+    double rtt = (cc->srtt > 0) ? cc->srtt : 0.1; // RTT usado para projetar a janela
+    double t = now - cc->epoch_start + rtt; // Tempo na época, um RTT à frente
+    double target = CUBIC_C * (t - cc->k) * (t - cc->k) * (t - cc->k) + cc->w_max; // W_cubic(t)
+    // Região "TCP-friendly": nunca cresce mais devagar que o AIMD padrão.
+    double w_est = cc->w_max * CUBIC_BETA + 3 * (1 - CUBIC_BETA) / (1 + CUBIC_BETA) * ((now - cc->epoch_start) / rtt);
+    if (target < w_est)
+        target = w_est;
+    if (target > cc->cwnd)
+        cc->cwnd += (target - cc->cwnd) / cc->cwnd * acked;
+    else
+        cc->cwnd += 0.01 * acked / cc->cwnd;
+    clamp_cwnd(cc);
+}
+
+static void cubic_on_loss(rdt_cc *cc, int is_timeout, double now) {
+    cc->epoch_start = 0;
+    // Convergência rápida: se a perda ocorreu abaixo do último máximo, libera banda para outros fluxos.
+    if (cc->cwnd < cc->w_max)
+        cc->w_max = cc->cwnd * (1 + CUBIC_BETA) / 2;
+    else
+        cc->w_max = cc->cwnd;
+    cc->cwnd *= CUBIC_BETA;
+    cc->ssthresh = cc->cwnd;
+    if (is_timeout) // Timeout: recomeça do mínimo em slow start até ssthresh
+        cc->cwnd = cc->min_cwnd;
+    clamp_cwnd(cc);
+    if (cc->ssthresh < cc->min_cwnd)
+        cc->ssthresh = cc->min_cwnd;
+}
+
+static void cubic_on_rtt_sample(rdt_cc *cc, double rtt, double now) {
+    update_rtt(cc, rtt);
+}
+
+const rdt_cc_ops rdt_cc_cubic = {"cubic", cubic_init, cubic_on_ack, cubic_on_loss, cubic_on_rtt_sample};
+
+/* ---------- BBR: janela a partir do modelo banda do gargalo x RTT mínimo ---------- */
+
+static void bbr_init(rdt_cc *cc) {
+    cc->bbr_state = BBR_STARTUP;
+    cc->btl_bw = 0;
+    cc->bw_stamp = 0;
+    cc->bw_delivered = 0;
+    cc->bw_rounds = 0;
+    cc->full_bw = 0;
+    cc->full_bw_count = 0;
+    cc->cycle_index = 0;
+}
+
+static void bbr_on_ack(rdt_cc *cc, int acked, double now) {
+    if (cc->bw_stamp == 0)
+        cc->bw_stamp = now;
+    cc->bw_delivered += acked;
+    
+    // Uma rodada dura ao menos min_rtt: fecha a amostra de taxa de entrega.
+    double interval = now - cc->bw_stamp;
+    if (cc->min_rtt > 0 && interval >= cc->min_rtt) {
+        double rate = cc->bw_delivered / interval; // Pacotes por segundo entregues na rodada
+        if (rate > cc->btl_bw || ++cc->bw_rounds >= BBR_BW_ROUNDS) { // Filtro de máximo com janela de BBR_BW_ROUNDS rodadas
+            cc->btl_bw = rate;
+            cc->bw_rounds = 0;
+        }
+        cc->bw_delivered = 0;
+        cc->bw_stamp = now;
+        
+        switch (cc->bbr_state) {
+        case BBR_STARTUP: // Sai da STARTUP após 3 rodadas sem crescimento de 25% na banda
+            if (cc->btl_bw >= cc->full_bw * 1.25) {
+                cc->full_bw = cc->btl_bw;
+                cc->full_bw_count = 0;
+            } else if (++cc->full_bw_count >= 3) {
+                cc->bbr_state = BBR_DRAIN;
+            }
+            break;
+        case BBR_DRAIN: // Uma rodada para esvaziar a fila criada na STARTUP
+            cc->bbr_state = BBR_PROBE_BW;
+            cc->cycle_index = 0;
+            break;
+        default: // PROBE_BW: avança o ciclo de ganhos a cada rodada
+            cc->cycle_index = (cc->cycle_index + 1) % BBR_CYCLE_LEN;
+            break;
+        }
+    }
+    
+    double bdp = cc->btl_bw * cc->min_rtt; // Produto banda x atraso (pacotes)
+    if (cc->bbr_state == BBR_STARTUP || bdp <= 0) {
+        cc->cwnd += acked; // Crescimento exponencial enquanto a banda aumenta
+    } else if (cc->bbr_state == BBR_DRAIN) {
+        cc->cwnd = bdp;
+    } else {
+        cc->cwnd = BBR_CWND_GAIN * bdp * bbr_cycle_gain[cc->cycle_index];
+    }
+    clamp_cwnd(cc);
+}
+
+static void bbr_on_loss(rdt_cc *cc, int is_timeout, double now) {
+    // Baseado em atraso: ACKs duplicados não reduzem a janela. Após um timeout a janela
+    // vai ao mínimo e é restaurada pelo modelo no próximo ACK.
+    if (is_timeout) {
+        cc->cwnd = cc->min_cwnd;
+        clamp_cwnd(cc);
+    }
+}
+
+static void bbr_on_rtt_sample(rdt_cc *cc, double rtt, double now) {
+    update_rtt(cc, rtt);
+    // min_rtt expira após BBR_MIN_RTT_WIN segundos para acompanhar mudanças de rota.
+    if (rtt <= cc->min_rtt || now - cc->min_rtt_stamp > BBR_MIN_RTT_WIN) {
+        cc->min_rtt = rtt;
+        cc->min_rtt_stamp = now;
+    }
+}
+
+const rdt_cc_ops rdt_cc_bbr = {"bbr", bbr_init, bbr_on_ack, bbr_on_loss, bbr_on_rtt_sample};
+
+/* ---------- Seleção e inicialização ---------- */
+
+int rdt_cc_select(const char *name) {
+    const rdt_cc_ops *all[] = {&rdt_cc_aimd, &rdt_cc_cubic, &rdt_cc_bbr};
+    for (int i = 0; i < (int)(sizeof(all) / sizeof(all[0])); i++) {
+        if (strcmp(name, all[i]->name) == 0) {
+            cc_algorithm = all[i];
+            return SUCCESS;
+        }
+    }
+    fprintf(stderr, "rdt_cc_select: algoritmo desconhecido '%s' (use aimd, cubic ou bbr)\n", name);
+    return ERROR;
+}
+
+void rdt_cc_init(rdt_cc *cc, const rdt_cc_ops *ops, double init_cwnd, double min_cwnd, double max_cwnd) {
+    memset(cc, 0, sizeof(rdt_cc));
+    cc->ops = ops;
+    cc->cwnd = init_cwnd;
+    cc->min_cwnd = min_cwnd;
+    cc->max_cwnd = max_cwnd;
+    clamp_cwnd(cc);
+    ops->init(cc);
+}
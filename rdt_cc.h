@@ -0,0 +1,58 @@
+#ifndef RDT_CC_H
+#define RDT_CC_H
+
+// Controle de congestionamento plugável.
+// Cada algoritmo é uma tabela de funções (rdt_cc_ops) chamada pelo remetente
+// a cada ACK, perda e amostra de RTT; a janela resultante fica em cwnd (em pacotes).
+
+typedef struct rdt_cc rdt_cc;
+
+typedef struct rdt_cc_ops {
+    const char *name;                                           // Nome usado na seleção em tempo de execução
+    void (*init)(rdt_cc *cc);                                   // Inicializa o estado do algoritmo
+    void (*on_ack)(rdt_cc *cc, int acked, double now);          // acked pacotes novos confirmados
+    void (*on_loss)(rdt_cc *cc, int is_timeout, double now);    // Perda por timeout (1) ou ACKs duplicados (0)
+    void (*on_rtt_sample)(rdt_cc *cc, double rtt, double now);  // Nova amostra de RTT em segundos
+} rdt_cc_ops;
+
+// Estado do controle de congestionamento de um fluxo de envio.
+struct rdt_cc {
+    const rdt_cc_ops *ops;  // Algoritmo em uso
+    double cwnd;            // Janela de congestionamento (pacotes)
+    double ssthresh;        // Limiar do slow start (pacotes)
+    double min_cwnd;        // Limites da janela
+    double max_cwnd;
+    double srtt;            // RTT suavizado (s)
+    double min_rtt;         // Menor RTT observado (s)
+    double acked_count;     // AIMD: ACKs acumulados desde o último incremento
+    // CUBIC
+    double w_max;           // Janela no momento da última perda
+    double k;               // Tempo até voltar a w_max (s)
+    double epoch_start;     // Início da época atual (s), 0 = nova época
+    // BBR
+    int bbr_state;          // STARTUP, DRAIN ou PROBE_BW
+    double btl_bw;          // Banda estimada do gargalo (pacotes/s)
+    double bw_stamp;        // Início da amostra de banda atual (s)
+    double bw_delivered;    // Pacotes entregues na amostra atual
+    int bw_rounds;          // Rodadas desde a renovação do filtro de banda
+    int full_bw_count;      // Rodadas sem crescimento de banda na STARTUP
+    double full_bw;         // Maior banda da STARTUP
+    int cycle_index;        // Fase do ciclo de ganhos em PROBE_BW
+    double cycle_stamp;     // Início da fase atual (s)
+    double min_rtt_stamp;   // Instante da medição de min_rtt (s)
+};
+
+extern const rdt_cc_ops rdt_cc_aimd;
+extern const rdt_cc_ops rdt_cc_cubic;
+extern const rdt_cc_ops rdt_cc_bbr;
+
+// Algoritmo copiado para as novas conexões por rdt_conn_init (padrão: AIMD).
+extern const rdt_cc_ops *cc_algorithm;
+
+// Seleciona o algoritmo pelo nome ("aimd", "cubic" ou "bbr"). Retorna SUCCESS ou ERROR.
+int rdt_cc_select(const char *name);
+
+// Inicializa cc com o algoritmo ops, janela inicial e limites em pacotes.
+void rdt_cc_init(rdt_cc *cc, const rdt_cc_ops *ops, double init_cwnd, double min_cwnd, double max_cwnd);
+
+#endif
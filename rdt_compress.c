@@ -0,0 +1,401 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <endian.h>
+#include <pthread.h>
+#include "rdt.h"
+#include "rdt_compress.h"
+
+// Formato de bloco do LZ4: sequências de [token][literais][offset][extensão do match]. O token
+// traz nos 4 bits altos o número de literais e nos 4 baixos o comprimento do match menos
+// MINMATCH; o valor 15 continua em bytes seguintes (255 = continua). A última sequência tem só
+// literais, e os últimos LASTLITERALS bytes do bloco são sempre literais.
+#define MINMATCH        4
+#define MFLIMIT         12      // Um match começa pelo menos MFLIMIT bytes antes do fim
+#define LASTLITERALS    5
+#define MAX_DISTANCE    65535   // Maior offset de um match
+#define HASH_LOG        12      // Posições na tabela de hash do compressor (2^HASH_LOG)
+#define SKIP_TRIGGER    6       // Falhas seguidas de busca antes de aumentar o salto
+
+static inline uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read64le(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+static inline uint32_t lz4_hash(uint32_t v) {
+    return (v * 2654435761u) >> (32 - HASH_LOG);
+}
+
+// Comprimento comum de p e ref, sem passar de limit (8 bytes por comparação).
+static inline int match_len(const uint8_t *p, const uint8_t *ref, const uint8_t *limit) {
+    const uint8_t *start = p;
+    while (p + 8 <= limit) {
+        uint64_t diff = read64le(p) ^ read64le(ref);
+        if (diff)
+            return p - start + (__builtin_ctzll(diff) >> 3);
+        p += 8;
+        ref += 8;
+    }
+    while (p < limit && *p == *ref) {
+        p++;
+        ref++;
+    }
+    return p - start;
+}
+
+// Escreve a continuação de um comprimento (valor - 15 em bytes de 255).
+static inline uint8_t *put_len(uint8_t *op, int len) {
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+int rdt_lz4_compress(const char *src, int len, char *dst, int cap, int accel) {
+    const uint8_t *base = (const uint8_t *)src, *ip = base, *anchor = base, *iend = base + len;
+    const uint8_t *mflimit = iend - MFLIMIT, *matchlimit = iend - LASTLITERALS;
+    uint8_t *op = (uint8_t *)dst, *oend = op + cap;
+    uint32_t table[1 << HASH_LOG]; // Última posição de cada hash de 4 bytes
+    if (accel < 1)
+        accel = 1;
+
+    if (len > MFLIMIT) {
+        memset(table, 0, sizeof(table)); // Posição 0: candidato falso, descartado na comparação
+        ip++;
+        unsigned search = (unsigned)accel << SKIP_TRIGGER; // Tentativas sem match (define o salto)
+        while (ip < mflimit) {
+            uint32_t seq = read32(ip); // 4 bytes a partir de ip
+            uint32_t h = lz4_hash(seq);
+            const uint8_t *ref = base + table[h]; // Candidato
+            table[h] = ip - base;
+            if (ref >= ip || ip - ref > MAX_DISTANCE || read32(ref) != seq) {
+                ip += search++ >> SKIP_TRIGGER;
+                continue;
+            }
+            search = (unsigned)accel << SKIP_TRIGGER;
+            while (ip > anchor && ref > base && ip[-1] == ref[-1]) { // Estende o match para trás
+                ip--;
+                ref--;
+            }
+            int mlen = MINMATCH + match_len(ip + MINMATCH, ref + MINMATCH, matchlimit); // Comprimento do match
+            int lit = ip - anchor; // Literais antes do match
+            if (op + 1 + lit + lit / 255 + 1 + 2 + (mlen - MINMATCH) / 255 + 1 > oend)
+                return 0;
+            uint8_t *token = op++;
+            *token = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+            if (lit >= 15)
+                op = put_len(op, lit - 15);
+            memcpy(op, anchor, lit);
+            op += lit;
+            uint16_t off = htole16((uint16_t)(ip - ref)); // Offset (little-endian)
+            memcpy(op, &off, sizeof(off));
+            op += sizeof(off);
+            int m = mlen - MINMATCH;
+            *token |= (uint8_t)(m >= 15 ? 15 : m);
+            if (m >= 15)
+                op = put_len(op, m - 15);
+            ip += mlen;
+            anchor = ip;
+            if (ip < mflimit) // Registra uma posição dentro do match para os seguintes
+                table[lz4_hash(read32(ip - 2))] = ip - 2 - base;
+        }
+    }
+
+    int lit = iend - anchor; // Literais finais
+    if (op + 1 + lit + lit / 255 + 1 > oend)
+        return 0;
+    *op++ = (uint8_t)((lit >= 15 ? 15 : lit) << 4);
+    if (lit >= 15)
+        op = put_len(op, lit - 15);
+    memcpy(op, anchor, lit);
+    op += lit;
+    return op - (uint8_t *)dst;
+}
+
+// Lê a continuação de um comprimento; ERROR se o bloco terminar antes.
+static inline int get_len(const uint8_t **ip, const uint8_t *iend, int len) {
+    uint8_t b;
+    do {
+        if (*ip >= iend)
+            return ERROR;
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255);
+    return len;
+}
+
+int rdt_lz4_decompress(const char *src, int len, char *dst, int raw_len) {
+    const uint8_t *ip = (const uint8_t *)src, *iend = ip + len;
+    uint8_t *op = (uint8_t *)dst, *oend = op + raw_len;
+    while (ip < iend) {
+        uint8_t token = *ip++;
+        int lit = token >> 4; // Literais
+        if (lit == 15 && (lit = get_len(&ip, iend, lit)) < 0)
+            return ERROR;
+        if (lit > iend - ip || lit > oend - op)
+            return ERROR;
+        memcpy(op, ip, lit);
+        op += lit;
+        ip += lit;
+        if (ip == iend) // Última sequência: só literais
+            break;
+        if (iend - ip < 2)
+            return ERROR;
+        int off = ip[0] | ip[1] << 8; // Offset do match
+        ip += 2;
+        int mlen = token & 15; // Comprimento do match
+        if (mlen == 15 && (mlen = get_len(&ip, iend, mlen)) < 0)
+            return ERROR;
+        mlen += MINMATCH;
+        if (off == 0 || off > op - (uint8_t *)dst || mlen > oend - op)
+            return ERROR;
+        const uint8_t *match = op - off;
+        if (off >= mlen) {
+            memcpy(op, match, mlen);
+        } else { // Match sobreposto (repetição de um trecho curto)
+            for (int i = 0; i < mlen; i++)
+                op[i] = match[i];
+        }
+        op += mlen;
+    }
+    return op == oend ? raw_len : ERROR;
+}
+
+int rdt_z_frame(const char *src, int len, char *out, int level, int try) {
+    z_hdr h; // Header do quadro
+    int data_len = try ? rdt_lz4_compress(src, len, out + sizeof(h), len - len / Z_MIN_GAIN, level) : 0;
+    if (data_len == 0) { // Sem ganho: quadro sem compressão
+        memcpy(out + sizeof(h), src, len);
+        data_len = len;
+    }
+    h.raw_len = htonl(len);
+    h.data_len = htonl(data_len);
+    memcpy(out, &h, sizeof(h));
+    return sizeof(h) + data_len;
+}
+
+struct rdt_zpipe {
+    int fd;                 // Arquivo de origem (lido com pread)
+    const char *map;        // Arquivo mapeado ou NULL
+    long offset;            // Próximo byte a comprimir
+    long end;               // Fim do intervalo
+    int level;              // Aceleração do LZ4
+    char *in;               // Trecho lido do arquivo (sem map)
+    char *slots[ZPIPE_DEPTH]; // Quadros (índice = número do quadro % ZPIPE_DEPTH)
+    int lens[ZPIPE_DEPTH];
+    long head;              // Quadros prontos
+    long tail;              // Quadros liberados pelo consumidor
+    int lent;               // O quadro tail foi entregue e ainda está em uso
+    int done;               // A thread terminou
+    int failed;             // A leitura do arquivo falhou
+    int stop;               // Pedido de parada
+    rdt_zstats st;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+};
+
+// Thread de compressão: lê e comprime os quadros enquanto houver slot livre. Depois de um
+// quadro sem ganho, os skip quadros seguintes vão sem compressão, com skip dobrando a cada
+// nova falha (até Z_SKIP_MAX): dados incompressíveis custam uma tentativa a cada Z_SKIP_MAX quadros.
+static void *zpipe_main(void *arg) {
+    rdt_zpipe *z = arg;
+    int skip = 0, skipped = 0; // Quadros a pular depois de uma falha e já pulados
+    while (z->offset < z->end) {
+        pthread_mutex_lock(&z->lock);
+        while (z->head - z->tail == ZPIPE_DEPTH && !z->stop)
+            pthread_cond_wait(&z->cond, &z->lock);
+        int stop = z->stop;
+        pthread_mutex_unlock(&z->lock);
+        if (stop)
+            break;
+
+        int len = z->end - z->offset < Z_FRAME ? z->end - z->offset : Z_FRAME; // Bytes do quadro
+        const char *src = z->map ? z->map + z->offset : z->in; // Dados do quadro
+        for (int got = 0; !z->map && got < len; ) {
+            ssize_t nr = pread(z->fd, z->in + got, len - got, z->offset + got);
+            if (nr <= 0) {
+                if (nr < 0 && errno == EINTR)
+                    continue;
+                perror("rdt_zpipe: pread");
+                z->failed = TRUE;
+                break;
+            }
+            got += nr;
+        }
+        if (z->failed)
+            break;
+        int try = skipped >= skip; // Tenta comprimir este quadro
+        char *out = z->slots[z->head % ZPIPE_DEPTH];
+        int n = rdt_z_frame(src, len, out, z->level, try);
+        if (!try) {
+            skipped++;
+        } else if (n - (int)sizeof(z_hdr) == len) { // Sem ganho
+            skip = skip ? (skip * 2 < Z_SKIP_MAX ? skip * 2 : Z_SKIP_MAX) : 1;
+            skipped = 0;
+        } else {
+            skip = skipped = 0;
+        }
+        z->st.raw_bytes += len;
+        z->st.frame_bytes += n;
+        z->st.frames++;
+        if (n - (int)sizeof(z_hdr) == len)
+            z->st.stored++;
+        z->offset += len;
+
+        pthread_mutex_lock(&z->lock);
+        z->lens[z->head % ZPIPE_DEPTH] = n;
+        z->head++;
+        pthread_cond_broadcast(&z->cond);
+        pthread_mutex_unlock(&z->lock);
+    }
+    pthread_mutex_lock(&z->lock);
+    z->done = TRUE;
+    pthread_cond_broadcast(&z->cond);
+    pthread_mutex_unlock(&z->lock);
+    return NULL;
+}
+
+static void zpipe_free(rdt_zpipe *z) {
+    for (int i = 0; i < ZPIPE_DEPTH; i++)
+        free(z->slots[i]);
+    free(z->in);
+    free(z);
+}
+
+rdt_zpipe *rdt_zpipe_open(int fd, const char *map, long offset, long length, int level) {
+    rdt_zpipe *z = calloc(1, sizeof(rdt_zpipe));
+    if (!z) {
+        perror("rdt_zpipe_open: calloc");
+        return NULL;
+    }
+    z->fd = fd;
+    z->map = map;
+    z->offset = offset;
+    z->end = offset + length;
+    z->level = level;
+    int ok = map || (z->in = malloc(Z_FRAME)) != NULL;
+    for (int i = 0; ok && i < ZPIPE_DEPTH; i++)
+        ok = (z->slots[i] = malloc(Z_FRAME_MAX)) != NULL;
+    if (!ok) {
+        perror("rdt_zpipe_open: malloc");
+        zpipe_free(z);
+        return NULL;
+    }
+    pthread_mutex_init(&z->lock, NULL);
+    pthread_cond_init(&z->cond, NULL);
+    if (pthread_create(&z->thread, NULL, zpipe_main, z) != 0) {
+        fprintf(stderr, "rdt_zpipe_open: pthread_create falhou.\n");
+        pthread_mutex_destroy(&z->lock);
+        pthread_cond_destroy(&z->cond);
+        zpipe_free(z);
+        return NULL;
+    }
+    return z;
+}
+
+int rdt_zpipe_next(rdt_zpipe *z, char **frame) {
+    pthread_mutex_lock(&z->lock);
+    if (z->lent) { // Libera o quadro anterior para a thread
+        z->tail++;
+        z->lent = FALSE;
+        pthread_cond_broadcast(&z->cond);
+    }
+    while (z->head == z->tail && !z->done)
+        pthread_cond_wait(&z->cond, &z->lock);
+    int n = z->failed ? ERROR : 0; // Fim do intervalo ou falha
+    if (z->head != z->tail) {
+        *frame = z->slots[z->tail % ZPIPE_DEPTH];
+        n = z->lens[z->tail % ZPIPE_DEPTH];
+        z->lent = TRUE;
+    }
+    pthread_mutex_unlock(&z->lock);
+    return n;
+}
+
+void rdt_zpipe_close(rdt_zpipe *z, rdt_zstats *st) {
+    if (!z)
+        return;
+    pthread_mutex_lock(&z->lock);
+    z->stop = TRUE;
+    pthread_cond_broadcast(&z->cond);
+    pthread_mutex_unlock(&z->lock);
+    pthread_join(z->thread, NULL);
+    if (st)
+        *st = z->st;
+    pthread_mutex_destroy(&z->lock);
+    pthread_cond_destroy(&z->cond);
+    zpipe_free(z);
+}
+
+struct rdt_zdec {
+    char in[Z_FRAME_MAX];   // Quadro em remontagem
+    int have;               // Bytes do quadro já recebidos
+    int need;               // Tamanho do quadro (conhecido depois do header)
+    char out[Z_FRAME];      // Quadro descomprimido
+};
+
+rdt_zdec *rdt_zdec_open(void) {
+    rdt_zdec *d = malloc(sizeof(rdt_zdec));
+    if (!d) {
+        perror("rdt_zdec_open: malloc");
+        return NULL;
+    }
+    d->have = 0;
+    d->need = sizeof(z_hdr);
+    return d;
+}
+
+int rdt_zdec_input(rdt_zdec *d, const char *buf, int len, const char **raw, int *raw_len) {
+    int used = 0; // Bytes consumidos
+    *raw_len = 0;
+    while (used < len) {
+        int n = d->need - d->have < len - used ? d->need - d->have : len - used; // Bytes copiados
+        memcpy(d->in + d->have, buf + used, n);
+        d->have += n;
+        used += n;
+        if (d->have < d->need)
+            break;
+        z_hdr h; // Header do quadro
+        memcpy(&h, d->in, sizeof(h));
+        int rlen = ntohl(h.raw_len), dlen = ntohl(h.data_len);
+        if (rlen < 1 || rlen > Z_FRAME || dlen < 1 || dlen > rlen) {
+            fprintf(stderr, "rdt_zdec: Quadro inválido (%d de %d bytes).\n", dlen, rlen);
+            return ERROR;
+        }
+        if (d->need == (int)sizeof(z_hdr)) { // Header completo: aguarda os dados
+            d->need += dlen;
+            continue;
+        }
+        if (dlen == rlen) { // Quadro sem compressão
+            *raw = d->in + sizeof(h);
+        } else if (rdt_lz4_decompress(d->in + sizeof(h), dlen, d->out, rlen) < 0) {
+            fprintf(stderr, "rdt_zdec: Falha ao descomprimir o quadro.\n");
+            return ERROR;
+        } else {
+            *raw = d->out;
+        }
+        *raw_len = rlen;
+        d->have = 0;
+        d->need = sizeof(z_hdr);
+        break;
+    }
+    return used;
+}
+
+int rdt_zdec_pending(rdt_zdec *d) {
+    return d->have;
+}
+
+void rdt_zdec_close(rdt_zdec *d) {
+    free(d);
+}
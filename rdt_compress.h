@@ -0,0 +1,70 @@
+#ifndef RDT_COMPRESS_H
+#define RDT_COMPRESS_H
+
+#include <stdint.h>
+#include "rdt.h"
+
+// Compressão do fluxo de dados, negociada no PKT_START (PKT_F_COMPRESS).
+// O remetente divide o intervalo do arquivo em quadros de até Z_FRAME bytes e os comprime em
+// uma thread própria (rdt_zpipe), alguns quadros à frente do envio; o fluxo de envio recebe os
+// quadros como bytes comuns. O receptor remonta cada quadro a partir dos payloads em ordem e o
+// descomprime antes do buffer de escrita (rdt_zdec). Um quadro que não diminui pelo menos
+// 1/Z_MIN_GAIN vai sem compressão, e o compressor deixa de tentar nos quadros seguintes.
+
+#define RDT_Z_LZ4       1           // LZ4, formato de bloco (único codec disponível)
+#define Z_FRAME         (64 << 10)  // Bytes do arquivo por quadro
+#define Z_MIN_GAIN      16          // Ganho mínimo de um quadro comprimido (1/16 do tamanho)
+#define Z_SKIP_MAX      64          // Máximo de quadros enviados sem tentar comprimir
+#define ZPIPE_DEPTH     8           // Quadros comprimidos à frente do envio
+
+// Header de cada quadro, no formato da rede, seguido de data_len bytes. data_len == raw_len
+// indica um quadro sem compressão; um quadro comprimido é sempre menor que o original.
+typedef struct __attribute__((packed)) {
+    uint32_t raw_len;       // Bytes do arquivo no quadro (1 a Z_FRAME)
+    uint32_t data_len;      // Bytes a seguir
+} z_hdr;
+
+#define Z_FRAME_MAX     ((int)sizeof(z_hdr) + Z_FRAME) // Maior quadro no fluxo
+
+// Comprime len bytes de src em dst no formato de bloco do LZ4. accel >= 1 troca compressão por
+// velocidade (saltos maiores nas regiões sem repetição). Retorna o tamanho comprimido, ou 0 se
+// não couber em cap bytes.
+int rdt_lz4_compress(const char *src, int len, char *dst, int cap, int accel);
+// Descomprime um bloco LZ4 de len bytes em exatamente raw_len bytes de dst, validando cada
+// sequência. Retorna raw_len ou ERROR.
+int rdt_lz4_decompress(const char *src, int len, char *dst, int raw_len);
+
+// Monta em out (Z_FRAME_MAX bytes) o quadro de len bytes de src, comprimido se try for 1 e o
+// ganho for suficiente. Retorna o tamanho do quadro.
+int rdt_z_frame(const char *src, int len, char *out, int level, int try);
+
+// Totais da compressão de um intervalo.
+typedef struct {
+    long raw_bytes;         // Bytes do arquivo
+    long frame_bytes;       // Bytes dos quadros (enviados no fluxo)
+    long frames;            // Quadros
+    long stored;            // Quadros sem compressão
+} rdt_zstats;
+
+// Remetente: comprime [offset, offset + length) de fd (ou de map, se não for NULL) em uma thread
+// própria, até ZPIPE_DEPTH quadros à frente do consumidor.
+typedef struct rdt_zpipe rdt_zpipe;
+rdt_zpipe *rdt_zpipe_open(int fd, const char *map, long offset, long length, int level);
+// Próximo quadro, esperando a thread se ainda não estiver pronto; *frame vale até a próxima
+// chamada. Retorna o tamanho do quadro, 0 no fim do intervalo ou ERROR se a leitura falhar.
+int rdt_zpipe_next(rdt_zpipe *z, char **frame);
+// Para a thread, preenche *st (se não for NULL) e libera o compressor.
+void rdt_zpipe_close(rdt_zpipe *z, rdt_zstats *st);
+
+// Receptor: remonta e descomprime os quadros a partir dos bytes do fluxo.
+typedef struct rdt_zdec rdt_zdec;
+rdt_zdec *rdt_zdec_open(void);
+// Consome até len bytes de buf e retorna quantos, ou ERROR se o quadro for inválido. Se um
+// quadro terminar neles, para logo depois dele e aponta *raw para os seus *raw_len bytes
+// (válidos até a próxima chamada); senão, *raw_len = 0.
+int rdt_zdec_input(rdt_zdec *d, const char *buf, int len, const char **raw, int *raw_len);
+// Bytes de um quadro incompleto (diferente de 0 no fim do fluxo indica um fluxo truncado).
+int rdt_zdec_pending(rdt_zdec *d);
+void rdt_zdec_close(rdt_zdec *d);
+
+#endif
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/select.h>
+#include "rdt.h"
+#include "rdt_resume.h"
+#include "rdt_delta.h"
+
+#define DELTA_MAX_WAIT  10.0    // Maior espera por uma rodada de respostas (s)
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+uint32_t rdt_weak_sum(const unsigned char *buf, int len) {
+    uint32_t a = 0, b = 0; // Somas módulo 2^32 (só os 16 bits baixos importam)
+    for (int i = 0; i < len; i++) {
+        a += buf[i];
+        b += (uint32_t)(len - i) * buf[i];
+    }
+    return (b << 16) | (a & 0xffff);
+}
+
+int rdt_delta_block_size(long file_size) {
+    long b = DELTA_MIN_BLOCK; // Raiz quadrada do tamanho, arredondada para cima em múltiplos de 1 KB
+    while (b < DELTA_MAX_BLOCK && b * b < file_size)
+        b += 1024;
+    return b;
+}
+
+int rdt_delta_sigs(int fd, long file_size, int block_size, uint32_t first, delta_sig *sigs, int max) {
+    long nblocks = (file_size + block_size - 1) / block_size;
+    int n = first < nblocks ? (nblocks - first < max ? nblocks - first : max) : 0; // Assinaturas pedidas
+    unsigned char *buf = n > 0 ? malloc(block_size) : NULL;
+    if (n > 0 && !buf) {
+        perror("rdt_delta_sigs: malloc");
+        n = 0;
+    }
+    for (int i = 0; i < n; i++) {
+        long off = (first + i) * (long)block_size;
+        int len = off + block_size < file_size ? block_size : file_size - off; // O último bloco pode ser menor
+        if (pread(fd, buf, len, off) != len) {
+            perror("rdt_delta_sigs: pread");
+            n = i;
+            break;
+        }
+        sigs[i].weak = rdt_weak_sum(buf, len);
+        sigs[i].strong = rdt_hash64(buf, len, 0);
+    }
+    free(buf);
+    return n;
+}
+
+// Envia a consulta da página de assinaturas que começa no bloco first.
+static int fetch_send(rdt_conn *c, delta_query *dq, long first) {
+    pkt q; // Consulta
+    dq->first = htonl(first);
+    if (make_pkt(&q, PKT_DELTA, first, dq, sizeof(*dq)) < 0) // O seq identifica a página
+        return ERROR;
+    if (sendto(c->sockfd, &q, pkt_size(&q), 0, (struct sockaddr *)&c->peer, sizeof(struct sockaddr_in)) < 0) {
+        perror("rdt_delta_fetch: sendto(PKT_DELTA)");
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+long rdt_delta_fetch(rdt_conn *c, int block_size, delta_sig **sigs, long *base_size) {
+    delta_query dq; // Consulta no formato da rede
+    *sigs = NULL;
+    *base_size = -1;
+    long nblocks = -1, npages = 1, received = 0; // Blocos e páginas da cópia do receptor, páginas recebidas
+    char *got = NULL; // Páginas recebidas
+    int stalls = 0; // Rodadas seguidas sem resposta
+
+    // Em cada rodada, consulta até DELTA_INFLIGHT páginas que faltam (só a primeira, até saber o
+    // tamanho da cópia) e espera as respostas: uma rodada custa um RTT, e não um por página.
+    while (nblocks < 0 || received < npages) {
+        int sent = 0; // Consultas da rodada
+        for (long p = 0; p < npages && sent < DELTA_INFLIGHT; p++) {
+            if (got && got[p])
+                continue;
+            if (fetch_send(c, &dq, p * DELTA_PAGE) < 0)
+                goto fail;
+            sent++;
+        }
+        double wait_s = c->rto * (1 << stalls); // Backoff exponencial entre as rodadas sem resposta
+        double deadline = now_sec() + (wait_s < DELTA_MAX_WAIT ? wait_s : DELTA_MAX_WAIT);
+        long before = received;
+        for (int answered = 0; answered < sent; ) {
+            double left = deadline - now_sec(); // Tempo restante da rodada
+            if (left <= 0)
+                break;
+            struct timeval timeout = {(long)left, (long)((left - (long)left) * 1000000)};
+            fd_set readfds; // Conjunto de descritores de arquivo para select
+            FD_ZERO(&readfds);
+            FD_SET(c->sockfd, &readfds);
+            if (select(c->sockfd + 1, &readfds, NULL, NULL, &timeout) <= 0)
+                break;
+            pkt ack; // Resposta
+            int nr = recvfrom(c->sockfd, &ack, sizeof(pkt), 0, NULL, NULL);
+            if (nr < 0) {
+                perror("rdt_delta_fetch: recvfrom");
+                goto fail;
+            }
+            int len = pkt_size(&ack) - (int)sizeof(hdr); // Tamanho do payload
+            if (nr < (int)sizeof(hdr) || iscorrupted(&ack) || ack.h.pkt_type != PKT_ACK
+                || !(ack.h.flags & htons(PKT_F_DELTA)) || len < (int)sizeof(delta_reply))
+                continue;
+            delta_reply rr; // Resposta no formato da rede
+            memcpy(&rr, ack.msg, sizeof(rr));
+            uint64_t fsize = be64toh(rr.file_size);
+            long first = ntohl(rr.first);
+            int count = ntohs(rr.count); // Assinaturas na resposta
+            if (pkt_seq(&ack) != (hseq_t)first || count > DELTA_PAGE || len < (int)(sizeof(rr) + count * sizeof(delta_sig)))
+                continue;
+            if (nblocks < 0) { // Primeira resposta: tamanho da cópia do receptor
+                *base_size = fsize;
+                if (fsize == 0) // Cópia vazia: nada a aproveitar
+                    return 0;
+                nblocks = (*base_size + block_size - 1) / block_size;
+                npages = (nblocks + DELTA_PAGE - 1) / DELTA_PAGE;
+                *sigs = malloc((nblocks > 0 ? nblocks : 1) * sizeof(delta_sig));
+                got = calloc(npages > 0 ? npages : 1, 1);
+                if (!*sigs || !got) {
+                    perror("rdt_delta_fetch: malloc");
+                    goto fail;
+                }
+            } else if (fsize != (uint64_t)*base_size) { // Resposta inconsistente
+                continue;
+            }
+            long page = first / DELTA_PAGE; // Página da resposta
+            if (first % DELTA_PAGE != 0 || page >= npages || got[page]
+                || count != (nblocks - first < DELTA_PAGE ? nblocks - first : DELTA_PAGE))
+                continue;
+            for (int i = 0; i < count; i++) {
+                delta_sig s; // Assinatura no formato da rede
+                memcpy(&s, ack.msg + sizeof(rr) + i * sizeof(s), sizeof(s));
+                (*sigs)[first + i].weak = ntohl(s.weak);
+                (*sigs)[first + i].strong = be64toh(s.strong);
+            }
+            got[page] = TRUE;
+            received++;
+            answered++;
+        }
+        if (received > before) {
+            stalls = 0;
+        } else if (++stalls == DELTA_RETRIES) {
+            RDT_LOG(RDT_LOG_INFO, "rdt_delta_fetch: Receptor não respondeu à consulta das assinaturas.\n");
+            goto fail;
+        } else {
+            RDT_LOG(RDT_LOG_DEBUG, "rdt_delta_fetch: Timeout aguardando as assinaturas (%ld de %ld páginas).\n",
+                    received, npages);
+        }
+    }
+    free(got);
+    return nblocks;
+
+fail:
+    free(got);
+    free(*sigs);
+    *sigs = NULL;
+    return ERROR;
+}
+
+// Saída do codificador: monta as instruções em trechos de até DELTA_CHUNK bytes.
+typedef struct {
+    char *buf;              // Trecho em montagem
+    int len;
+    long copy_first;        // Cópia pendente: blocos consecutivos viram uma única instrução
+    long copy_count;
+    long copy_max;          // Blocos por instrução (DELTA_COPY_MAX bytes)
+    int (*out)(void *arg, const char *buf, int len);
+    void *arg;
+    rdt_dstats *st;
+} enc_out;
+
+static int enc_flush(enc_out *e) {
+    if (e->len > 0 && e->out(e->arg, e->buf, e->len) < 0)
+        return ERROR;
+    e->st->stream_bytes += e->len;
+    e->len = 0;
+    return SUCCESS;
+}
+
+static int enc_op(enc_out *e, int type, uint32_t arg, uint32_t count) {
+    if (e->len + (int)sizeof(delta_op) > DELTA_CHUNK && enc_flush(e) < 0)
+        return ERROR;
+    delta_op op = {type, htonl(arg), htonl(count)};
+    memcpy(e->buf + e->len, &op, sizeof(op));
+    e->len += sizeof(op);
+    return SUCCESS;
+}
+
+static int enc_copy_flush(enc_out *e) {
+    if (e->copy_count == 0)
+        return SUCCESS;
+    e->st->copies++;
+    int rv = enc_op(e, DELTA_COPY, e->copy_first, e->copy_count);
+    e->copy_count = 0;
+    return rv;
+}
+
+static int enc_literal(enc_out *e, const char *p, long len) {
+    if (len > 0 && enc_copy_flush(e) < 0)
+        return ERROR;
+    while (len > 0) {
+        int room = DELTA_CHUNK - e->len - (int)sizeof(delta_op); // Literais que cabem no trecho
+        if (room <= 0) {
+            if (enc_flush(e) < 0)
+                return ERROR;
+            continue;
+        }
+        int n = len < room ? len : room;
+        if (enc_op(e, DELTA_LITERAL, n, 0) < 0)
+            return ERROR;
+        memcpy(e->buf + e->len, p, n);
+        e->len += n;
+        e->st->literal_bytes += n;
+        p += n;
+        len -= n;
+    }
+    return SUCCESS;
+}
+
+static int enc_copy(enc_out *e, long block, long len) {
+    e->st->copied_bytes += len;
+    if (e->copy_count > 0 && e->copy_first + e->copy_count == block && e->copy_count < e->copy_max) {
+        e->copy_count++;
+        return SUCCESS;
+    }
+    if (enc_copy_flush(e) < 0)
+        return ERROR;
+    e->copy_first = block;
+    e->copy_count = 1;
+    return SUCCESS;
+}
+
+static inline uint32_t sig_slot(uint32_t weak, int bits) {
+    return (weak * 2654435761u) >> (32 - bits);
+}
+
+int rdt_delta_encode(const char *data, long size, const delta_sig *sigs, long nsigs, int block_size,
+                     long base_size, int (*out)(void *arg, const char *buf, int len), void *arg, rdt_dstats *st) {
+    const unsigned char *p = (const unsigned char *)data;
+    const long B = block_size;
+    long nfull = base_size / B; // Blocos inteiros da cópia do receptor
+    int tail_len = nsigs > nfull ? base_size - nfull * B : 0; // Último bloco, menor
+    memset(st, 0, sizeof(*st));
+    enc_out e = {.buf = malloc(DELTA_CHUNK), .copy_max = DELTA_COPY_MAX / block_size, .out = out, .arg = arg, .st = st};
+    int bits = 10; // Tabela de hash das somas fracas: 2^bits posições, pelo menos o dobro dos blocos
+    while ((1L << bits) < 2 * nfull && bits < 30)
+        bits++;
+    int32_t *head = malloc(sizeof(int32_t) << bits); // Primeiro bloco de cada posição
+    int32_t *next = malloc((nfull > 0 ? nfull : 1) * sizeof(int32_t)); // Próximo bloco com a mesma posição
+    if (!e.buf || !head || !next) {
+        perror("rdt_delta_encode: malloc");
+        free(e.buf);
+        free(head);
+        free(next);
+        return ERROR;
+    }
+    memset(head, 0xff, sizeof(int32_t) << bits);
+    for (long i = nfull - 1; i >= 0; i--) { // As listas ficam em ordem crescente de bloco
+        uint32_t s = sig_slot(sigs[i].weak, bits);
+        next[i] = head[s];
+        head[s] = i;
+    }
+
+    int rv = SUCCESS;
+    long pos = 0, lit = 0; // Início da janela e dos literais pendentes
+    long expect = -1; // Bloco seguinte à última cópia, preferido entre os candidatos
+    uint32_t a = 0, b = 0; // Somas da janela [pos, pos + B)
+    if (nfull > 0 && size >= B) {
+        uint32_t w = rdt_weak_sum(p, B);
+        a = w & 0xffff;
+        b = w >> 16;
+    }
+    while (nfull > 0 && pos + B <= size && rv == SUCCESS) {
+        uint32_t weak = (b << 16) | (a & 0xffff);
+        long match = -1; // Bloco igual à janela
+        uint64_t strong = 0; // Hash forte da janela, calculado no primeiro candidato
+        int hashed = FALSE;
+        for (int32_t i = head[sig_slot(weak, bits)]; i >= 0; i = next[i]) {
+            if (sigs[i].weak != weak)
+                continue;
+            if (!hashed) {
+                strong = rdt_hash64(p + pos, B, 0);
+                hashed = TRUE;
+            }
+            if (sigs[i].strong == strong) {
+                match = i;
+                if (i == expect)
+                    break;
+            }
+        }
+        if (match >= 0) {
+            rv = enc_literal(&e, data + lit, pos - lit);
+            if (rv == SUCCESS)
+                rv = enc_copy(&e, match, B);
+            expect = match + 1;
+            pos += B;
+            lit = pos;
+            if (pos + B <= size) {
+                uint32_t w = rdt_weak_sum(p + pos, B);
+                a = w & 0xffff;
+                b = w >> 16;
+            }
+            continue;
+        }
+        if (pos + B < size) { // Desloca a janela um byte
+            a += p[pos + B] - p[pos];
+            b += a - (uint32_t)B * p[pos];
+        }
+        pos++;
+    }
+    // O último bloco da cópia do receptor, menor que os demais, só pode coincidir com o fim do arquivo.
+    long tail = size - tail_len; // Início do trecho final
+    if (rv == SUCCESS && tail_len > 0 && tail >= lit && rdt_weak_sum(p + tail, tail_len) == sigs[nfull].weak
+        && rdt_hash64(p + tail, tail_len, 0) == sigs[nfull].strong) {
+        rv = enc_literal(&e, data + lit, tail - lit);
+        if (rv == SUCCESS)
+            rv = enc_copy(&e, nfull, tail_len);
+        lit = size;
+    }
+    if (rv == SUCCESS)
+        rv = enc_literal(&e, data + lit, size - lit);
+    if (rv == SUCCESS)
+        rv = enc_copy_flush(&e);
+    if (rv == SUCCESS)
+        rv = enc_flush(&e);
+    free(e.buf);
+    free(head);
+    free(next);
+    return rv;
+}
+
+struct rdt_delta_dec {
+    int fd;                 // Cópia antiga do receptor
+    long base_size;
+    int block_size;
+    char *in;               // Fila de bytes do fluxo ainda não executados
+    int in_off;             // Início da fila em in
+    int in_len;             // Bytes na fila
+    int in_cap;
+    long literal;           // Bytes literais restantes da instrução atual
+    long copy_off;          // Trecho da cópia antiga ainda não entregue da instrução DELTA_COPY atual
+    long copy_end;
+    char *buf;              // Trecho copiado da cópia antiga (DELTA_CHUNK bytes)
+    char *hbuf;             // Trecho incompleto do hash (RESUME_CHUNK bytes)
+    int hlen;
+    uint64_t hash;          // Hash encadeado dos trechos completos
+};
+
+rdt_delta_dec *rdt_delta_dec_open(int base_fd, long base_size, int block_size) {
+    rdt_delta_dec *d = calloc(1, sizeof(rdt_delta_dec));
+    if (!d || !(d->buf = malloc(DELTA_CHUNK)) || !(d->hbuf = malloc(RESUME_CHUNK))) {
+        perror("rdt_delta_dec_open: malloc");
+        if (d)
+            free(d->buf);
+        free(d);
+        return NULL;
+    }
+    d->fd = base_fd;
+    d->base_size = base_size;
+    d->block_size = block_size;
+    return d;
+}
+
+int rdt_delta_dec_input(rdt_delta_dec *d, const char *buf, int len) {
+    if (d->in_off > 0 && d->in_off + d->in_len + len > d->in_cap) { // Move a fila para o início
+        memmove(d->in, d->in + d->in_off, d->in_len);
+        d->in_off = 0;
+    }
+    if (d->in_len + len > d->in_cap) {
+        int cap = d->in_cap ? d->in_cap : DELTA_CHUNK; // Novo tamanho da fila
+        while (cap < d->in_len + len)
+            cap *= 2;
+        char *in = realloc(d->in, cap);
+        if (!in) {
+            perror("rdt_delta_dec_input: realloc");
+            return ERROR;
+        }
+        d->in = in;
+        d->in_cap = cap;
+    }
+    memcpy(d->in + d->in_off + d->in_len, buf, len);
+    d->in_len += len;
+    return SUCCESS;
+}
+
+// Entrega len bytes do novo arquivo a emit, acumulando o hash em trechos de RESUME_CHUNK bytes,
+// como rdt_block_hash.
+static int dec_emit(rdt_delta_dec *d, const char *p, int len,
+                    int (*emit)(void *arg, const char *buf, int len), void *arg) {
+    if (emit(arg, p, len) < 0)
+        return ERROR;
+    while (len > 0) {
+        int n = RESUME_CHUNK - d->hlen < len ? RESUME_CHUNK - d->hlen : len; // Bytes do trecho atual
+        memcpy(d->hbuf + d->hlen, p, n);
+        d->hlen += n;
+        p += n;
+        len -= n;
+        if (d->hlen == RESUME_CHUNK) {
+            d->hash = rdt_hash64(d->hbuf, RESUME_CHUNK, d->hash);
+            d->hlen = 0;
+        }
+    }
+    return SUCCESS;
+}
+
+// Inicia a cópia dos blocos [first, first + count) da cópia antiga.
+static int dec_copy(rdt_delta_dec *d, long first, long count) {
+    long nblocks = (d->base_size + d->block_size - 1) / d->block_size;
+    if (count < 1 || first >= nblocks || count > nblocks - first || count > DELTA_COPY_MAX / d->block_size) {
+        fprintf(stderr, "rdt_delta: Cópia dos blocos %ld a %ld fora da cópia antiga (%ld blocos) ou maior que %d bytes.\n",
+                first, first + count - 1, nblocks, DELTA_COPY_MAX);
+        return ERROR;
+    }
+    d->copy_off = first * d->block_size;
+    d->copy_end = (first + count) * d->block_size < d->base_size ? (first + count) * d->block_size : d->base_size;
+    return SUCCESS;
+}
+
+int rdt_delta_dec_run(rdt_delta_dec *d, long budget, int (*emit)(void *arg, const char *buf, int len), void *arg) {
+    while (budget > 0) {
+        if (d->copy_off < d->copy_end) { // Cópia em andamento
+            long left = d->copy_end - d->copy_off < budget ? d->copy_end - d->copy_off : budget;
+            int len = left < DELTA_CHUNK ? left : DELTA_CHUNK; // Bytes do trecho
+            ssize_t nr = pread(d->fd, d->buf, len, d->copy_off);
+            if (nr < 0 && errno == EINTR)
+                continue;
+            if (nr <= 0) {
+                perror("rdt_delta: pread");
+                return ERROR;
+            }
+            if (dec_emit(d, d->buf, nr, emit, arg) < 0)
+                return ERROR;
+            d->copy_off += nr;
+            budget -= nr;
+            continue;
+        }
+        const char *p = d->in + d->in_off; // Início da fila
+        if (d->literal > 0) { // Bytes literais da instrução atual
+            long left = d->literal < budget ? d->literal : budget;
+            int n = d->in_len < left ? d->in_len : left;
+            if (n == 0)
+                break;
+            if (dec_emit(d, p, n, emit, arg) < 0)
+                return ERROR;
+            d->literal -= n;
+            d->in_off += n;
+            d->in_len -= n;
+            budget -= n;
+            continue;
+        }
+        if (d->in_len < (int)sizeof(delta_op)) // Instrução incompleta: aguarda o próximo pacote
+            break;
+        delta_op op; // Instrução no formato da rede
+        memcpy(&op, p, sizeof(op));
+        d->in_off += sizeof(op);
+        d->in_len -= sizeof(op);
+        if (op.op == DELTA_LITERAL && ntohl(op.arg) > 0) {
+            d->literal = ntohl(op.arg);
+        } else if (op.op == DELTA_COPY) {
+            if (dec_copy(d, ntohl(op.arg), ntohl(op.count)) < 0)
+                return ERROR;
+        } else {
+            fprintf(stderr, "rdt_delta: Instrução inválida (%d).\n", op.op);
+            return ERROR;
+        }
+    }
+    if (d->in_len == 0)
+        d->in_off = 0;
+    return SUCCESS;
+}
+
+long rdt_delta_dec_backlog(rdt_delta_dec *d) {
+    int ready = d->copy_off < d->copy_end || (d->literal > 0 ? d->in_len > 0 : d->in_len >= (int)sizeof(delta_op)); // Há o que executar
+    return ready ? d->copy_end - d->copy_off + d->in_len : 0;
+}
+
+int rdt_delta_dec_pending(rdt_delta_dec *d) {
+    return d->in_len > 0 || d->literal > 0 || d->copy_off < d->copy_end;
+}
+
+uint64_t rdt_delta_dec_digest(rdt_delta_dec *d) {
+    uint64_t h = d->hlen > 0 ? rdt_hash64(d->hbuf, d->hlen, d->hash) : d->hash; // Inclui o trecho incompleto
+    return h ? h : 1;
+}
+
+void rdt_delta_dec_close(rdt_delta_dec *d) {
+    if (!d)
+        return;
+    free(d->in);
+    free(d->buf);
+    free(d->hbuf);
+    free(d);
+}
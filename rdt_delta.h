@@ -0,0 +1,111 @@
+#ifndef RDT_DELTA_H
+#define RDT_DELTA_H
+
+#include <stdint.h>
+#include "rdt.h"
+
+// Envio por diferença (como o rsync), negociado no PKT_START (PKT_F_DELTA).
+// O receptor que aceita abre a cópia do arquivo em receive/. Na conexão, antes dos dados, o
+// remetente consulta (PKT_DELTA) as assinaturas dos blocos de block_size bytes dessa cópia: uma
+// soma fraca, que pode ser deslocada byte a byte, e um hash forte (XXH64). Ele desliza uma
+// janela de block_size bytes sobre o arquivo local e, a cada posição cuja soma fraca coincide
+// com a de um bloco do receptor e cujo hash forte confirma, envia uma referência ao bloco em vez
+// dos dados. O fluxo de dados passa a levar instruções (delta_op): trechos literais e cópias de
+// blocos da cópia antiga, com os quais o receptor monta o novo arquivo em um arquivo temporário.
+// No FIN, o temporário só substitui o antigo se o seu hash for o do arquivo do remetente,
+// enviado no PKT_START: uma cópia alterada durante a transferência não corrompe o arquivo.
+
+#define DELTA_MIN_BLOCK     2048        // Menor bloco das assinaturas
+#define DELTA_MAX_BLOCK     (64 << 10)  // Maior bloco das assinaturas
+#define DELTA_PAGE          100         // Assinaturas por resposta a um PKT_DELTA
+#define DELTA_INFLIGHT      32          // Consultas PKT_DELTA em trânsito
+#define DELTA_RETRIES       8           // Rodadas de consultas sem resposta antes de desistir
+#define DELTA_CHUNK         (64 << 10)  // Trecho de instruções entregue ao fluxo / copiado da cópia antiga
+#define DELTA_COPY_MAX      (1 << 20)   // Maior trecho de uma instrução DELTA_COPY (bytes)
+#define DELTA_QUEUE_MAX     (4 << 20)   // Maior atraso do receptor na execução das instruções (bytes)
+#define DELTA_SUFFIX        ".rdtdelta" // Sufixo do arquivo temporário do receptor
+
+// Consulta do remetente (payload de um PKT_DELTA, com seq = first), no formato da rede.
+typedef struct __attribute__((packed)) {
+    uint32_t first;         // Primeiro bloco pedido
+} delta_query;
+
+// Resposta do receptor (payload do ACK, marcado com PKT_F_DELTA), seguida de count assinaturas.
+typedef struct __attribute__((packed)) {
+    uint64_t file_size;     // Tamanho da cópia do receptor
+    uint32_t first;
+    uint16_t count;
+} delta_reply;
+
+// Assinatura de um bloco (no formato da rede dentro da resposta). O último bloco pode ser menor.
+typedef struct __attribute__((packed)) {
+    uint32_t weak;          // rdt_weak_sum
+    uint64_t strong;        // rdt_hash64 com semente 0
+} delta_sig;
+
+// Instrução do fluxo por diferença, no formato da rede.
+// DELTA_LITERAL: arg bytes literais a seguir. DELTA_COPY: count blocos da cópia antiga a partir
+// do bloco arg, no máximo DELTA_COPY_MAX bytes.
+typedef enum {
+    DELTA_LITERAL = 1,
+    DELTA_COPY    = 2
+} delta_op_type;
+
+typedef struct __attribute__((packed)) {
+    uint8_t op;             // delta_op_type
+    uint32_t arg;           // Bytes literais ou primeiro bloco
+    uint32_t count;         // Blocos copiados (0 em DELTA_LITERAL)
+} delta_op;
+
+// Soma fraca de len bytes (a do rsync): a = soma dos bytes, b = soma de (len - i) * byte[i],
+// ambas módulo 2^16, em (b << 16) | a.
+uint32_t rdt_weak_sum(const unsigned char *buf, int len);
+
+// Tamanho do bloco para um arquivo de file_size bytes: perto da raiz quadrada do tamanho,
+// múltiplo de 1 KB, entre DELTA_MIN_BLOCK e DELTA_MAX_BLOCK.
+int rdt_delta_block_size(long file_size);
+
+// Receptor: calcula até max assinaturas dos blocos do arquivo fd (file_size bytes) a partir do
+// bloco first. Retorna quantas.
+int rdt_delta_sigs(int fd, long file_size, int block_size, uint32_t first, delta_sig *sigs, int max);
+
+// Remetente: na conexão c, com o envio por diferença aceito, consulta as assinaturas da cópia
+// do receptor, com até DELTA_INFLIGHT consultas em trânsito, e as grava em *sigs (alocado com
+// malloc, na ordem do host). Informa o tamanho da cópia em *base_size. Retorna o número de
+// assinaturas ou ERROR se o receptor não responder.
+long rdt_delta_fetch(rdt_conn *c, int block_size, delta_sig **sigs, long *base_size);
+
+// Totais de uma codificação.
+typedef struct {
+    long literal_bytes;     // Bytes enviados como literais
+    long copied_bytes;      // Bytes referenciados na cópia do receptor
+    long copies;            // Instruções DELTA_COPY
+    long stream_bytes;      // Bytes do fluxo de instruções
+} rdt_dstats;
+
+// Remetente: codifica os size bytes de data contra as nsigs assinaturas da cópia do receptor
+// (base_size bytes) e entrega o fluxo de instruções a out em trechos de até DELTA_CHUNK bytes.
+// Retorna SUCCESS, ou ERROR se out falhar.
+int rdt_delta_encode(const char *data, long size, const delta_sig *sigs, long nsigs, int block_size,
+                     long base_size, int (*out)(void *arg, const char *buf, int len), void *arg, rdt_dstats *st);
+
+// Receptor: executa as instruções a partir dos bytes do fluxo, lendo as cópias de base_fd
+// (base_size bytes), e entrega os bytes do novo arquivo a emit, em ordem. A entrada fica em uma
+// fila e é executada aos poucos, para que uma cópia grande não segure o laço de recepção.
+typedef struct rdt_delta_dec rdt_delta_dec;
+rdt_delta_dec *rdt_delta_dec_open(int base_fd, long base_size, int block_size);
+// Acrescenta len bytes de buf à fila. Retorna SUCCESS, ou ERROR se faltar memória.
+int rdt_delta_dec_input(rdt_delta_dec *d, const char *buf, int len);
+// Executa as instruções da fila até entregar budget bytes a emit. Retorna SUCCESS, ou ERROR se
+// uma instrução for inválida ou emit falhar.
+int rdt_delta_dec_run(rdt_delta_dec *d, long budget, int (*emit)(void *arg, const char *buf, int len), void *arg);
+// Bytes que rdt_delta_dec_run ainda pode executar sem nova entrada (cópia em andamento e fila).
+long rdt_delta_dec_backlog(rdt_delta_dec *d);
+// Há uma instrução incompleta (no fim do fluxo, indica um fluxo truncado).
+int rdt_delta_dec_pending(rdt_delta_dec *d);
+// Hash dos bytes entregues até aqui, igual ao de rdt_block_hash sobre o arquivo montado.
+uint64_t rdt_delta_dec_digest(rdt_delta_dec *d);
+// Libera o decodificador (base_fd continua aberto).
+void rdt_delta_dec_close(rdt_delta_dec *d);
+
+#endif
@@ -0,0 +1,408 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "rdt.h"
+#include "rdt_fec.h"
+
+#define GF_POLY        0x11d  // Polinômio primitivo de GF(2^8): x^8 + x^4 + x^3 + x^2 + 1
+#define FEC_TARGET     0.01   // Probabilidade aceitável de um bloco não poder ser reconstruído
+#define FEC_MAX_LOSS   0.5    // Perda máxima considerada na escolha de M
+#define FEC_DATA_RING  128    // Pacotes de dados guardados pelo receptor: a janela de recepção e o bloco anterior a ela
+#define FEC_BLOCKS     8      // Blocos com paridade guardados pelo receptor
+
+static uint8_t gf_exp[512];             // Potências do gerador (duplicada para dispensar o módulo)
+static uint8_t gf_log[256];             // Logaritmo na base do gerador
+static uint8_t gf_mul_table[256][256];  // Produto de quaisquer dois elementos
+static uint8_t gf_nib_lo[256][16];      // c * x para os 16 valores do nibble baixo de x
+static uint8_t gf_nib_hi[256][16];      // c * (x << 4) para os 16 valores do nibble alto de x
+static uint8_t fec_coef[FEC_MAX_PARITY][FEC_MAX_DATA]; // Matriz de Cauchy: paridade j, pacote i
+static void (*gf_muladd_impl)(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len); // Implementação escolhida
+
+uint8_t gf_mul(uint8_t a, uint8_t b) {
+    return gf_mul_table[a][b];
+}
+
+uint8_t gf_inv(uint8_t a) {
+    return a == 0 ? 0 : gf_exp[255 - gf_log[a]];
+}
+
+// dst ^= c * src, um byte por vez pela tabela de produtos.
+static void gf_muladd_table(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+    const uint8_t *row = gf_mul_table[c]; // Produtos por c
+    for (size_t i = 0; i < len; i++)
+        dst[i] ^= row[src[i]];
+}
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+// dst ^= c * src com o pshufb do SSSE3, 16 bytes por iteração: o produto é linear, então
+// c * x = c * (nibble baixo) ^ c * (nibble alto << 4), e cada metade é uma consulta de 16 entradas.
+__attribute__((target("ssse3")))
+static void gf_muladd_ssse3(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+    __m128i lo = _mm_loadu_si128((const __m128i *)gf_nib_lo[c]);
+    __m128i hi = _mm_loadu_si128((const __m128i *)gf_nib_hi[c]);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i p = _mm_xor_si128(_mm_shuffle_epi8(lo, _mm_and_si128(s, mask)),
+                                  _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, p));
+    }
+    gf_muladd_table(dst + i, src + i, c, len - i);
+}
+
+// O mesmo com o vpshufb do AVX2, 32 bytes por iteração.
+__attribute__((target("avx2")))
+static void gf_muladd_avx2(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+    __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)gf_nib_lo[c]));
+    __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)gf_nib_hi[c]));
+    __m256i mask = _mm256_set1_epi8(0x0f);
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i p = _mm256_xor_si256(_mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask)),
+                                     _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, p));
+    }
+    gf_muladd_table(dst + i, src + i, c, len - i);
+}
+#endif
+
+// Monta as tabelas de GF(2^8) e a matriz de Cauchy e escolhe a implementação de gf_muladd ao
+// carregar o programa, antes de qualquer thread usá-las.
+__attribute__((constructor))
+static void gf_init(void) {
+    int x = 1;
+    for (int i = 0; i < 255; i++) {
+        gf_exp[i] = gf_exp[i + 255] = x;
+        gf_log[x] = i;
+        x <<= 1;
+        if (x & 0x100)
+            x ^= GF_POLY;
+    }
+    for (int a = 1; a < 256; a++)
+        for (int b = 1; b < 256; b++)
+            gf_mul_table[a][b] = gf_exp[gf_log[a] + gf_log[b]];
+    for (int c = 0; c < 256; c++) {
+        for (int n = 0; n < 16; n++) {
+            gf_nib_lo[c][n] = gf_mul_table[c][n];
+            gf_nib_hi[c][n] = gf_mul_table[c][n << 4];
+        }
+    }
+    // Cauchy: 1 / (x_j ^ y_i), com x_j = j e y_i = FEC_MAX_PARITY + i todos distintos; toda
+    // submatriz quadrada é inversível, então quaisquer M perdas do bloco têm solução.
+    for (int j = 0; j < FEC_MAX_PARITY; j++)
+        for (int i = 0; i < FEC_MAX_DATA; i++)
+            fec_coef[j][i] = gf_inv(j ^ (FEC_MAX_PARITY + i));
+    gf_muladd_impl = gf_muladd_table;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        gf_muladd_impl = gf_muladd_avx2;
+    else if (__builtin_cpu_supports("ssse3"))
+        gf_muladd_impl = gf_muladd_ssse3;
+#endif
+}
+
+void gf_muladd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+    if (c != 0)
+        gf_muladd_impl(dst, src, c, len);
+}
+
+void gf_muladd_sw(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len) {
+    gf_muladd_table(dst, src, c, len);
+}
+
+// Soma c * símbolo de um pacote de dados (tamanho e payload) ao símbolo sym.
+static void sym_muladd(uint8_t *sym, const void *payload, int len, uint8_t c) {
+    uint16_t prefix = htons(len); // Tamanho do payload, primeiro campo do símbolo
+    gf_muladd(sym, (const uint8_t *)&prefix, c, sizeof(prefix));
+    gf_muladd(sym + sizeof(prefix), payload, c, len);
+}
+
+/* ---------- Codificador ---------- */
+
+struct rdt_fec_enc {
+    int k;                      // Máximo de pacotes de dados por bloco
+    double loss;                // Perda informada pelo receptor
+    int block_k;                // Pacotes de dados do bloco atual
+    int block_m;                // Paridades do bloco atual
+    int count;                  // Pacotes de dados no bloco atual
+    hseq_t start;               // seq do primeiro pacote do bloco
+    int len;                    // Maior símbolo do bloco (bytes)
+    uint8_t acc[FEC_MAX_PARITY][MAX_MSG_LEN]; // Payload de cada PKT_FEC: fec_hdr e paridade acumulada
+    pkt out[FEC_MAX_PARITY];    // PKT_FEC do último bloco encerrado
+};
+
+// Menor M para o qual a chance de mais de M perdas entre os k + M pacotes do bloco (perdas
+// independentes com probabilidade p) fica abaixo de FEC_TARGET.
+static int choose_parity(int k, double p) {
+    if (p > FEC_MAX_LOSS)
+        p = FEC_MAX_LOSS;
+    for (int m = 1; m < FEC_MAX_PARITY; m++) {
+        int n = k + m; // Pacotes do bloco
+        double term = 1; // P(X = 0) = (1 - p)^n
+        for (int i = 0; i < n; i++)
+            term *= 1 - p;
+        double cdf = term; // P(X <= x)
+        for (int x = 0; x < m; x++) {
+            term *= (double)(n - x) / (x + 1) * p / (1 - p);
+            cdf += term;
+        }
+        if (1 - cdf <= FEC_TARGET)
+            return m;
+    }
+    return FEC_MAX_PARITY;
+}
+
+// Cria o codificador com blocos de k pacotes de dados (limitado a FEC_MAX_DATA).
+rdt_fec_enc *rdt_fec_enc_open(int k) {
+    rdt_fec_enc *e = calloc(1, sizeof(rdt_fec_enc));
+    if (!e) {
+        perror("rdt_fec_enc_open: calloc");
+        return NULL;
+    }
+    e->k = k < 1 ? 1 : k > FEC_MAX_DATA ? FEC_MAX_DATA : k;
+    return e;
+}
+
+void rdt_fec_enc_close(rdt_fec_enc *e) {
+    free(e);
+}
+
+int rdt_fec_enc_add(rdt_fec_enc *e, hseq_t seq, const void *payload, int len, int window) {
+    if (len > MAX_MSG_LEN - FEC_OVERHEAD) // Não caberia em um PKT_FEC
+        len = MAX_MSG_LEN - FEC_OVERHEAD;
+    if (e->count == 0) { // Novo bloco
+        e->start = seq;
+        e->block_k = window < 1 ? 1 : window < e->k ? window : e->k;
+        e->block_m = choose_parity(e->block_k, e->loss);
+        e->len = 0;
+    }
+    int sym_len = (int)sizeof(uint16_t) + len; // Tamanho do símbolo deste pacote
+    if (sym_len > e->len) { // Completa com zeros a paridade dos símbolos anteriores, mais curtos
+        for (int j = 0; j < e->block_m; j++)
+            memset(e->acc[j] + sizeof(fec_hdr) + e->len, 0, sym_len - e->len);
+        e->len = sym_len;
+    }
+    for (int j = 0; j < e->block_m; j++)
+        sym_muladd(e->acc[j] + sizeof(fec_hdr), payload, len, fec_coef[j][e->count]);
+    e->count++;
+    return e->count == e->block_k;
+}
+
+int rdt_fec_enc_finish(rdt_fec_enc *e, pkt **out) {
+    if (e->count == 0)
+        return 0;
+    for (int j = 0; j < e->block_m; j++) {
+        fec_hdr *fh = (fec_hdr *)e->acc[j]; // Header FEC
+        fh->k = e->count;
+        fh->index = j;
+        if (make_pkt(&e->out[j], PKT_FEC, e->start, e->acc[j], sizeof(fec_hdr) + e->len) < 0)
+            return ERROR;
+        out[j] = &e->out[j];
+    }
+    e->count = 0;
+    return e->block_m;
+}
+
+void rdt_fec_enc_report(rdt_fec_enc *e, int loss_permille) {
+    double loss = loss_permille / 1000.0; // Perda informada
+    int m = choose_parity(e->k, loss); // Paridades de um bloco completo
+    if (m != choose_parity(e->k, e->loss))
+        RDT_LOG(RDT_LOG_DEBUG, "rdt_send: Perda de %.1f%% informada pelo receptor, FEC com %d paridades a cada %d pacotes.\n",
+                loss_permille / 10.0, m, e->k);
+    e->loss = loss;
+}
+
+/* ---------- Decodificador ---------- */
+
+// Paridade recebida de um bloco.
+typedef struct {
+    hseq_t start;               // seq do primeiro pacote de dados (0 = slot livre)
+    int k;                      // Pacotes de dados no bloco
+    int len;                    // Tamanho dos símbolos
+    int done;                   // Bloco completo: nada a reconstruir
+    int nparity;                // Paridades guardadas
+    uint8_t index[FEC_MAX_PARITY];          // Índice de cada paridade guardada
+    uint8_t sym[FEC_MAX_PARITY][MAX_MSG_LEN]; // Paridades guardadas
+} fec_block;
+
+struct rdt_fec_dec {
+    pkt data[FEC_DATA_RING];    // Pacotes de dados recebidos (índice = seq % FEC_DATA_RING; pkt_size == 0 indica slot vazio)
+    fec_block blocks[FEC_BLOCKS];
+    uint8_t work[FEC_MAX_PARITY][MAX_MSG_LEN]; // Paridades descontadas dos pacotes presentes
+    uint8_t sym[MAX_MSG_LEN];   // Símbolo reconstruído
+    double loss;                // Fração de pacotes de dados perdidos (média móvel)
+};
+
+rdt_fec_dec *rdt_fec_dec_open(void) {
+    rdt_fec_dec *d = calloc(1, sizeof(rdt_fec_dec));
+    if (!d)
+        perror("rdt_fec_dec_open: calloc");
+    return d;
+}
+
+void rdt_fec_dec_close(rdt_fec_dec *d) {
+    free(d);
+}
+
+int rdt_fec_dec_loss(rdt_fec_dec *d) {
+    return (int)(d->loss * 1000 + 0.5);
+}
+
+// Pacote de dados seq guardado, ou NULL.
+static pkt *dec_data(rdt_fec_dec *d, hseq_t seq) {
+    pkt *p = &d->data[seq % FEC_DATA_RING];
+    return (pkt_size(p) != 0 && pkt_seq(p) == seq) ? p : NULL;
+}
+
+// Inverte a matriz n x n a em GF(2^8) (Gauss-Jordan), em inv. Retorna ERROR se for singular.
+static int gf_invert(uint8_t a[FEC_MAX_PARITY][FEC_MAX_PARITY], uint8_t inv[FEC_MAX_PARITY][FEC_MAX_PARITY], int n) {
+    for (int r = 0; r < n; r++)
+        for (int col = 0; col < n; col++)
+            inv[r][col] = (r == col);
+    for (int col = 0; col < n; col++) {
+        int piv = col; // Linha do pivô
+        while (piv < n && a[piv][col] == 0)
+            piv++;
+        if (piv == n)
+            return ERROR;
+        for (int t = 0; t < n; t++) { // Troca as linhas
+            uint8_t v = a[col][t]; a[col][t] = a[piv][t]; a[piv][t] = v;
+            v = inv[col][t]; inv[col][t] = inv[piv][t]; inv[piv][t] = v;
+        }
+        uint8_t f = gf_inv(a[col][col]); // Normaliza o pivô
+        for (int t = 0; t < n; t++) {
+            a[col][t] = gf_mul(a[col][t], f);
+            inv[col][t] = gf_mul(inv[col][t], f);
+        }
+        for (int r = 0; r < n; r++) { // Zera a coluna nas demais linhas
+            uint8_t g = a[r][col];
+            if (r == col || g == 0)
+                continue;
+            for (int t = 0; t < n; t++) {
+                a[r][t] ^= gf_mul(g, a[col][t]);
+                inv[r][t] ^= gf_mul(g, inv[col][t]);
+            }
+        }
+    }
+    return SUCCESS;
+}
+
+// Reconstrói os pacotes que faltam no bloco b, se houver paridades suficientes.
+// Retorna o número de pacotes reconstruídos em out.
+static int dec_recover(rdt_fec_dec *d, fec_block *b, pkt *out) {
+    int miss[FEC_MAX_DATA]; // Posições dos pacotes que faltam
+    int e = 0;
+    for (int i = 0; i < b->k; i++)
+        if (!dec_data(d, b->start + i))
+            miss[e++] = i;
+    if (e == 0)
+        b->done = TRUE;
+    if (e == 0 || e > b->nparity)
+        return 0;
+
+    // Desconta de e paridades a contribuição dos pacotes presentes: resta, em cada uma, a
+    // soma dos símbolos perdidos multiplicados pelos coeficientes da linha.
+    uint8_t a[FEC_MAX_PARITY][FEC_MAX_PARITY], inv[FEC_MAX_PARITY][FEC_MAX_PARITY]; // Sistema e x e e sua inversa
+    for (int r = 0; r < e; r++) {
+        memcpy(d->work[r], b->sym[r], b->len);
+        for (int t = 0; t < e; t++)
+            a[r][t] = fec_coef[b->index[r]][miss[t]];
+    }
+    for (int i = 0; i < b->k; i++) {
+        pkt *p = dec_data(d, b->start + i);
+        int plen = p ? pkt_size(p) - (int)sizeof(hdr) : 0; // Payload do pacote presente
+        if (!p)
+            continue;
+        if ((int)sizeof(uint16_t) + plen > b->len) // Maior que a paridade: não pertence a este bloco
+            return 0;
+        for (int r = 0; r < e; r++)
+            sym_muladd(d->work[r], p->msg, plen, fec_coef[b->index[r]][i]);
+    }
+    if (gf_invert(a, inv, e) < 0)
+        return 0;
+
+    // Cada símbolo perdido é a combinação das paridades descontadas pela linha da inversa.
+    int n = 0; // Pacotes reconstruídos
+    for (int t = 0; t < e; t++) {
+        memset(d->sym, 0, b->len);
+        for (int r = 0; r < e; r++)
+            gf_muladd(d->sym, d->work[r], inv[t][r], b->len);
+        uint16_t len; // Tamanho do payload reconstruído
+        memcpy(&len, d->sym, sizeof(len));
+        len = ntohs(len);
+        if ((int)sizeof(len) + len > b->len) // Inconsistente: descarta
+            continue;
+        if (make_pkt(&out[n], PKT_DATA, b->start + miss[t], d->sym + sizeof(len), len) < 0)
+            continue;
+        memcpy(&d->data[(b->start + miss[t]) % FEC_DATA_RING], &out[n], pkt_size(&out[n]));
+        n++;
+    }
+    b->done = TRUE;
+    return n;
+}
+
+// Bloco de start, criado se ainda não existir (no lugar do mais antigo).
+static fec_block *dec_block(rdt_fec_dec *d, hseq_t start, int k, int len) {
+    fec_block *b = NULL; // Bloco encontrado ou substituído
+    for (int i = 0; i < FEC_BLOCKS; i++) {
+        if (d->blocks[i].start == start && d->blocks[i].k == k)
+            return &d->blocks[i];
+        if (!b || d->blocks[i].start < b->start)
+            b = &d->blocks[i];
+    }
+    b->start = start;
+    b->k = k;
+    b->len = len;
+    b->done = FALSE;
+    b->nparity = 0;
+
+    // A paridade segue os dados do bloco: os pacotes que ainda faltam foram perdidos.
+    int lost = 0;
+    for (int i = 0; i < k; i++)
+        if (!dec_data(d, start + i))
+            lost++;
+    d->loss = 0.875 * d->loss + 0.125 * lost / k;
+    return b;
+}
+
+int rdt_fec_dec_input(rdt_fec_dec *d, pkt *p, pkt *out) {
+    hseq_t seq = pkt_seq(p); // Número de sequência
+    int size = pkt_size(p); // Tamanho do pacote
+    if (p->h.pkt_type == PKT_DATA) {
+        if (dec_data(d, seq))
+            return 0;
+        memcpy(&d->data[seq % FEC_DATA_RING], p, size);
+        // Um pacote atrasado pode completar um bloco que ainda não tinha paridades suficientes.
+        for (int i = 0; i < FEC_BLOCKS; i++) {
+            fec_block *b = &d->blocks[i];
+            if (b->start != 0 && !b->done && seq - b->start < (hseq_t)b->k)
+                return dec_recover(d, b, out);
+        }
+        return 0;
+    }
+
+    if (p->h.pkt_type != PKT_FEC || size < (int)(sizeof(hdr) + sizeof(fec_hdr) + sizeof(uint16_t)))
+        return 0;
+    fec_hdr fh; // Header FEC
+    memcpy(&fh, p->msg, sizeof(fh));
+    int len = size - (int)(sizeof(hdr) + sizeof(fec_hdr)); // Tamanho da paridade
+    if (seq == 0 || fh.k < 1 || fh.k > FEC_MAX_DATA || fh.index >= FEC_MAX_PARITY)
+        return 0;
+    fec_block *b = dec_block(d, seq, fh.k, len);
+    if (b->done || b->len != len)
+        return 0;
+    for (int r = 0; r < b->nparity; r++)
+        if (b->index[r] == fh.index) // Paridade repetida
+            return 0;
+    b->index[b->nparity] = fh.index;
+    memcpy(b->sym[b->nparity], p->msg + sizeof(fec_hdr), len);
+    b->nparity++;
+    return dec_recover(d, b, out);
+}
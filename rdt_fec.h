@@ -0,0 +1,67 @@
+#ifndef RDT_FEC_H
+#define RDT_FEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rdt.h"
+
+// Correção antecipada de erros (FEC) por blocos.
+// A cada bloco de K pacotes de dados consecutivos, o remetente envia M pacotes de paridade
+// (PKT_FEC) de um código de Reed-Solomon sistemático sobre GF(2^8), com matriz de Cauchy: o
+// receptor reconstrói quaisquer até M pacotes perdidos do bloco sem retransmissão.
+// Cada pacote de dados entra no código como um símbolo [tamanho (uint16_t, ordem da rede)][payload],
+// completado com zeros até o maior símbolo do bloco; a paridade j é a soma, em GF(2^8), dos
+// símbolos multiplicados pelos coeficientes da linha j da matriz. Os coeficientes dependem só
+// da posição do pacote no bloco e do índice da paridade, o que permite variar K e M a cada bloco.
+
+#define FEC_MAX_DATA   16   // Máximo de pacotes de dados por bloco (K)
+#define FEC_MAX_PARITY 8    // Máximo de pacotes de paridade por bloco (M)
+
+// Bytes que um PKT_FEC tem a mais que o maior pacote de dados do bloco: o header FEC e o
+// tamanho do símbolo. Os pacotes de dados são limitados a payload_size - FEC_OVERHEAD para
+// que a paridade caiba no mesmo datagrama.
+#define FEC_OVERHEAD   4
+
+// Header do payload de um PKT_FEC, seguido da paridade. O seq do pacote é o do primeiro
+// pacote de dados do bloco.
+typedef struct __attribute__((packed)) {
+    uint8_t k;          // Pacotes de dados no bloco
+    uint8_t index;      // Índice da paridade (linha da matriz de Cauchy)
+} fec_hdr;
+
+// Aritmética de GF(2^8) (polinômio 0x11d) usada pelo código. gf_muladd faz dst ^= c * src
+// com a implementação mais rápida disponível (AVX2, SSSE3 ou tabela); gf_muladd_sw usa
+// sempre a tabela.
+uint8_t gf_mul(uint8_t a, uint8_t b);
+uint8_t gf_inv(uint8_t a);
+void gf_muladd(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len);
+void gf_muladd_sw(uint8_t *dst, const uint8_t *src, uint8_t c, size_t len);
+
+// Codificador do remetente: acumula a paridade do bloco atual à medida que os pacotes de
+// dados são transmitidos pela primeira vez.
+typedef struct rdt_fec_enc rdt_fec_enc;
+rdt_fec_enc *rdt_fec_enc_open(int k);
+void rdt_fec_enc_close(rdt_fec_enc *e);
+// Acrescenta ao bloco o pacote de dados seq (payload de len bytes). Um bloco novo tem até
+// min(k, window) pacotes: com a janela menor que k, um bloco maior não caberia nela, e a
+// paridade só sairia depois de confirmada a base, que pode ser justamente o pacote perdido.
+// Retorna TRUE se o bloco ficou completo e a paridade deve ser enviada (rdt_fec_enc_finish).
+int rdt_fec_enc_add(rdt_fec_enc *e, hseq_t seq, const void *payload, int len, int window);
+// Encerra o bloco atual, mesmo incompleto, e preenche out (FEC_MAX_PARITY posições) com os
+// seus pacotes de paridade, que valem até o próximo rdt_fec_enc_add. Retorna o número de
+// pacotes (0 se o bloco estiver vazio).
+int rdt_fec_enc_finish(rdt_fec_enc *e, pkt **out);
+// Perda medida pelo receptor (por mil pacotes de dados): define M para os próximos blocos.
+void rdt_fec_enc_report(rdt_fec_enc *e, int loss_permille);
+
+// Decodificador do receptor: guarda os pacotes de dados e a paridade dos blocos recentes.
+typedef struct rdt_fec_dec rdt_fec_dec;
+rdt_fec_dec *rdt_fec_dec_open(void);
+void rdt_fec_dec_close(rdt_fec_dec *d);
+// Processa um pacote de dados ou PKT_FEC íntegro. Se o bloco dele puder ser completado,
+// reconstrói os pacotes de dados que faltam em out (até FEC_MAX_PARITY) e retorna quantos.
+int rdt_fec_dec_input(rdt_fec_dec *d, pkt *p, pkt *out);
+// Perda medida nos blocos recebidos (por mil pacotes de dados), informada nos ACKs.
+int rdt_fec_dec_loss(rdt_fec_dec *d);
+
+#endif
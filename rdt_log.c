@@ -0,0 +1,114 @@
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <time.h>
+#include "rdt.h"
+#include "rdt_log.h"
+
+// Nível de log em tempo de execução: as mensagens por pacote (RDT_LOG_TRACE) custam mais
+// CPU que o próprio protocolo em enlaces rápidos e ficam desligadas por padrão.
+int log_level = RDT_LOG_INFO;
+
+// Escreve os baldes não vazios de um histograma como limite:contagem, separados por vírgula.
+static void dump_hist(FILE *f, const char *name, const uint64_t *hist) {
+    const char *sep = ""; // Separador antes do próximo balde
+    fprintf(f, " %s=", name);
+    for (int b = 0; b < RDT_HIST_BUCKETS; b++) {
+        if (!hist[b])
+            continue;
+        if (b == RDT_HIST_BUCKETS - 1) // O último balde não tem limite superior
+            fprintf(f, "%s>=%d:%llu", sep, 1 << (b - 1), (unsigned long long)hist[b]);
+        else
+            fprintf(f, "%s<%d:%llu", sep, 1 << b, (unsigned long long)hist[b]);
+        sep = ",";
+    }
+}
+
+void rdt_stats_dump(FILE *f, const char *prefix, const rdt_stats *st) {
+    static const struct {
+        const char *name;
+        size_t off;
+    } fields[] = {
+#define F(x) {#x, offsetof(rdt_stats, x)}
+        F(segments_sent), F(bytes_sent), F(retransmits), F(acks_received), F(dup_acks),
+        F(fast_retransmits), F(timeouts), F(segments_received), F(bytes_delivered),
+        F(acks_sent), F(duplicates), F(out_of_order), F(corrupted), F(fec_recovered),
+#undef F
+    };
+    fprintf(f, "%s", prefix);
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        uint64_t v = *(const uint64_t *)((const char *)st + fields[i].off);
+        if (v)
+            fprintf(f, " %s=%llu", fields[i].name, (unsigned long long)v);
+    }
+    if (st->acks_received) {
+        dump_hist(f, "cwnd_hist", st->cwnd_hist);
+        dump_hist(f, "rto_ms_hist", st->rto_hist);
+    }
+    fprintf(f, "\n");
+}
+
+struct rdt_trace {
+    rdt_event *ring;    // Eventos (índice = posição % capacidade)
+    uint32_t mask;      // Capacidade - 1
+    uint64_t head;      // Eventos já registrados
+};
+
+rdt_trace *rdt_trace_open(int capacity) {
+    uint32_t cap = 1; // Potência de 2, para o índice por máscara
+    while (cap < (uint32_t)capacity && cap < (1u << 30))
+        cap <<= 1;
+    rdt_trace *t = calloc(1, sizeof(rdt_trace));
+    if (t)
+        t->ring = malloc(cap * sizeof(rdt_event));
+    if (!t || !t->ring) {
+        perror("rdt_trace_open: malloc");
+        free(t);
+        return NULL;
+    }
+    t->mask = cap - 1;
+    return t;
+}
+
+void rdt_trace_add(rdt_trace *t, int type, uint32_t seq, int cwnd, double rto, double rtt) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    rdt_event *e = &t->ring[t->head++ & t->mask];
+    e->t_ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    e->seq = seq;
+    e->type = type;
+    e->cwnd = cwnd > UINT16_MAX ? UINT16_MAX : cwnd;
+    e->rto_us = (uint32_t)(rto * 1e6);
+    e->rtt_us = (uint32_t)(rtt * 1e6);
+}
+
+int rdt_trace_write(rdt_trace *t, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror("rdt_trace_write: fopen");
+        return ERROR;
+    }
+    uint64_t cap = (uint64_t)t->mask + 1;
+    uint64_t count = t->head < cap ? t->head : cap; // Eventos presentes no anel
+    rdt_trace_hdr h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, RDT_TRACE_MAGIC, sizeof(h.magic));
+    h.version = 1;
+    h.count = (uint32_t)count;
+    h.dropped = t->head - count;
+    int ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (uint64_t i = t->head - count; ok && i < t->head; i++) // Do mais antigo ao mais recente
+        ok = fwrite(&t->ring[i & t->mask], sizeof(rdt_event), 1, f) == 1;
+    if (fclose(f) != 0 || !ok) {
+        perror("rdt_trace_write: fwrite");
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+void rdt_trace_close(rdt_trace *t) {
+    if (!t)
+        return;
+    free(t->ring);
+    free(t);
+}
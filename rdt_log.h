@@ -0,0 +1,105 @@
+#ifndef RDT_LOG_H
+#define RDT_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Log por níveis, contadores por conexão e trace binário de eventos.
+
+// Níveis de log. As mensagens acima de RDT_LOG_MAX são removidas na compilação
+// (ex.: make CFLAGS="-O2 -Wall -DRDT_LOG_MAX=RDT_LOG_INFO"); as demais são filtradas em
+// tempo de execução por log_level.
+#define RDT_LOG_INFO   1   // Início e fim de conexões, funcionalidades indisponíveis
+#define RDT_LOG_DEBUG  2   // Perdas, retransmissões, mudanças de janela e de timeout
+#define RDT_LOG_TRACE  3   // Um evento por pacote enviado, confirmado ou recebido
+#ifndef RDT_LOG_MAX
+#define RDT_LOG_MAX    RDT_LOG_TRACE
+#endif
+
+extern int log_level;   // Nível em tempo de execução (padrão RDT_LOG_INFO; 0 = nenhum)
+
+#define RDT_LOG(level, ...) do {                                   \
+        if ((level) <= RDT_LOG_MAX && (level) <= log_level)        \
+            printf(__VA_ARGS__);                                   \
+    } while (0)
+
+// Histogramas em potências de 2: o balde 0 conta os valores menores que 1 e o balde i
+// (1 a RDT_HIST_BUCKETS - 1), os valores em [2^(i-1), 2^i); o último também acumula os maiores.
+#define RDT_HIST_BUCKETS 16
+
+static inline void rdt_hist_add(uint64_t *hist, double v) {
+    int b = 0; // Balde
+    while (v >= 1 && b < RDT_HIST_BUCKETS - 1) {
+        v /= 2;
+        b++;
+    }
+    hist[b]++;
+}
+
+// Contadores de uma conexão, mantidos em rdt_conn (rdt_stats_get). O remetente atualiza os
+// primeiros; o receptor, os do segundo grupo.
+typedef struct {
+    // Remetente
+    uint64_t segments_sent;     // Pacotes de dados enviados, com as retransmissões
+    uint64_t bytes_sent;        // Payload enviado, com as retransmissões
+    uint64_t retransmits;       // Retransmissões (timeout, fast retransmit, volta para a base)
+    uint64_t acks_received;     // ACKs válidos recebidos
+    uint64_t dup_acks;          // ACKs duplicados
+    uint64_t fast_retransmits;  // Fast retransmits disparados
+    uint64_t timeouts;          // Vencimentos do timer com retransmissão
+    uint64_t cwnd_hist[RDT_HIST_BUCKETS];  // Janela (pacotes) a cada ACK
+    uint64_t rto_hist[RDT_HIST_BUCKETS];   // RTO (ms) a cada ACK
+    // Receptor
+    uint64_t segments_received; // Pacotes de dados íntegros recebidos
+    uint64_t bytes_delivered;   // Bytes entregues em ordem ao arquivo
+    uint64_t acks_sent;         // ACKs enviados
+    uint64_t duplicates;        // Pacotes duplicados
+    uint64_t out_of_order;      // Pacotes fora de ordem (guardados ou descartados)
+    uint64_t corrupted;         // Pacotes corrompidos
+    uint64_t fec_recovered;     // Pacotes reconstruídos pela FEC
+} rdt_stats;
+
+// Escreve os contadores diferentes de zero em uma linha de f, precedida de prefix.
+void rdt_stats_dump(FILE *f, const char *prefix, const rdt_stats *st);
+
+// Trace binário: um anel com os últimos eventos da conexão, gravado em arquivo ao fim da
+// transferência para análise da janela e do RTT. O arquivo tem um rdt_trace_hdr seguido de
+// count registros rdt_event, do mais antigo para o mais recente, na ordem de bytes do host.
+typedef enum {
+    RDT_EV_SEND      = 1,   // Pacote de dados enviado pela primeira vez
+    RDT_EV_RETX      = 2,   // Pacote de dados retransmitido
+    RDT_EV_ACK       = 3,   // ACK recebido (seq = número confirmado)
+    RDT_EV_DUPACK    = 4,   // ACK duplicado
+    RDT_EV_TIMEOUT   = 5,   // Vencimento do timer (seq = base)
+    RDT_EV_FAST_RETX = 6,   // Fast retransmit (seq = base)
+    RDT_EV_RTT       = 7,   // Amostra de RTT (rtt_us = amostra)
+    RDT_EV_RECV      = 8,   // Pacote de dados recebido
+    RDT_EV_ACK_SENT  = 9    // ACK enviado pelo receptor
+} rdt_event_type;
+
+typedef struct {
+    uint64_t t_ns;      // Instante (CLOCK_MONOTONIC, ns)
+    uint32_t seq;       // Número de sequência
+    uint16_t type;      // rdt_event_type
+    uint16_t cwnd;      // Janela do remetente (pacotes)
+    uint32_t rto_us;    // RTO do remetente (us)
+    uint32_t rtt_us;    // EstimateRTT do remetente ou a amostra (RDT_EV_RTT) (us)
+} rdt_event;
+
+#define RDT_TRACE_MAGIC "RDTTRACE"
+typedef struct {
+    char magic[8];      // RDT_TRACE_MAGIC
+    uint32_t version;   // 1
+    uint32_t count;     // Registros a seguir
+    uint64_t dropped;   // Eventos mais antigos sobrescritos no anel
+} rdt_trace_hdr;
+
+typedef struct rdt_trace rdt_trace;
+// Cria um anel com capacidade para capacity eventos (arredondada para uma potência de 2).
+rdt_trace *rdt_trace_open(int capacity);
+void rdt_trace_add(rdt_trace *t, int type, uint32_t seq, int cwnd, double rto, double rtt);
+// Grava os eventos em path. Retorna 0 ou -1.
+int rdt_trace_write(rdt_trace *t, const char *path);
+void rdt_trace_close(rdt_trace *t);
+
+#endif
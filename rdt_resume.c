@@ -0,0 +1,291 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <endian.h>
+#include <sys/file.h>
+#include "rdt.h"
+#include "rdt_resume.h"
+
+#define CKPT_MAGIC      "RDTCKPT1"
+#define CKPT_SYNC       16      // Blocos acumulados antes de sincronizar os dados e gravar os hashes
+
+// Header do arquivo de checkpoint, seguido de um hash (uint64_t, ordem do host) por bloco.
+// O arquivo é esparso: os blocos nunca gravados ficam com hash 0.
+typedef struct {
+    char magic[8];          // CKPT_MAGIC
+    uint64_t file_size;     // Tamanho do arquivo
+    uint32_t block_size;    // RESUME_BLOCK
+    uint32_t nblocks;       // Blocos do arquivo
+} ckpt_hdr;
+
+struct rdt_ckpt {
+    int fd;                 // Arquivo de checkpoint
+    int rfd;                // Arquivo de dados (leitura dos blocos gravados)
+    long file_size;         // Tamanho do arquivo
+    long next;              // Início do próximo bloco a registrar
+    long end;               // Fim do intervalo da transferência
+    uint64_t pend[CKPT_SYNC]; // Hashes calculados e ainda não gravados
+    long pend_first;        // Bloco do primeiro hash pendente
+    int npend;
+    char *buf;              // Trecho lido do arquivo de dados (RESUME_CHUNK bytes)
+};
+
+#define PRIME64_1 0x9E3779B185EBCA87ULL
+#define PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define PRIME64_3 0x165667B19E3779F9ULL
+#define PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return le64toh(v);
+}
+
+static inline uint32_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return le32toh(v);
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    acc += input * PRIME64_2;
+    return rotl64(acc, 31) * PRIME64_1;
+}
+
+static inline uint64_t xxh_merge(uint64_t acc, uint64_t v) {
+    acc ^= xxh_round(0, v);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+uint64_t rdt_hash64(const void *buf, size_t len, uint64_t seed) {
+    const unsigned char *p = buf, *end = p + len;
+    uint64_t h;
+    if (len >= 32) { // Quatro acumuladores independentes, 32 bytes por iteração
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2, v2 = seed + PRIME64_2, v3 = seed, v4 = seed - PRIME64_1;
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+        }
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxh_merge(h, v1);
+        h = xxh_merge(h, v2);
+        h = xxh_merge(h, v3);
+        h = xxh_merge(h, v4);
+    } else {
+        h = seed + PRIME64_5;
+    }
+    h += len;
+    for (; p + 8 <= end; p += 8)
+        h = rotl64(h ^ xxh_round(0, read64(p)), 27) * PRIME64_1 + PRIME64_4;
+    if (p + 4 <= end) {
+        h = rotl64(h ^ (uint64_t)read32(p) * PRIME64_1, 23) * PRIME64_2 + PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl64(h ^ *p * PRIME64_5, 11) * PRIME64_1;
+    h ^= h >> 33; // Avalanche
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t rdt_block_hash(int fd, const char *map, long off, long len, char *buf) {
+    uint64_t h = 0; // Semente do trecho
+    for (long done = 0; done < len; ) {
+        long n = len - done < RESUME_CHUNK ? len - done : RESUME_CHUNK; // Bytes do trecho
+        const char *p = map ? map + off + done : buf; // Trecho
+        for (long got = 0; !map && got < n; ) {
+            ssize_t nr = pread(fd, buf + got, n - got, off + done + got);
+            if (nr < 0 && errno == EINTR)
+                continue;
+            if (nr <= 0)
+                return 0;
+            got += nr;
+        }
+        h = rdt_hash64(p, n, h);
+        done += n;
+    }
+    return h ? h : 1; // 0 indica bloco não gravado
+}
+
+static void ckpt_path(char *out, size_t size, const char *path) {
+    snprintf(out, size, "%s%s", path, RESUME_SUFFIX);
+}
+
+// Lê e confere o header do checkpoint aberto em fd.
+static int ckpt_valid(int fd, long file_size, uint32_t block_size) {
+    ckpt_hdr h;
+    return pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) && memcmp(h.magic, CKPT_MAGIC, sizeof(h.magic)) == 0
+           && h.file_size == (uint64_t)file_size && h.block_size == block_size
+           && h.nblocks == (uint32_t)((file_size + block_size - 1) / block_size);
+}
+
+rdt_ckpt *rdt_ckpt_open(const char *path, long file_size, long offset, long length) {
+    char cpath[4096]; // Caminho do checkpoint
+    ckpt_path(cpath, sizeof(cpath), path);
+    rdt_ckpt *k = calloc(1, sizeof(rdt_ckpt));
+    if (!k || !(k->buf = malloc(RESUME_CHUNK))) {
+        perror("rdt_ckpt_open: malloc");
+        free(k);
+        return NULL;
+    }
+    k->fd = open(cpath, O_RDWR | O_CREAT, 0644);
+    k->rfd = open(path, O_RDONLY);
+    if (k->fd < 0 || k->rfd < 0) {
+        perror("rdt_ckpt_open: open");
+        goto fail;
+    }
+    k->file_size = file_size;
+    k->next = (offset + RESUME_BLOCK - 1) / RESUME_BLOCK * RESUME_BLOCK; // Primeiro bloco inteiro do intervalo
+    k->end = offset + length;
+    k->pend_first = k->next / RESUME_BLOCK;
+
+    // Os fluxos paralelos de um arquivo abrem o checkpoint ao mesmo tempo: o primeiro o recria
+    // se for de outra versão do arquivo, e cada um zera os hashes dos blocos do seu intervalo.
+    flock(k->fd, LOCK_EX);
+    int ok = TRUE;
+    if (!ckpt_valid(k->fd, file_size, RESUME_BLOCK)) {
+        ckpt_hdr h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, CKPT_MAGIC, sizeof(h.magic));
+        h.file_size = file_size;
+        h.block_size = RESUME_BLOCK;
+        h.nblocks = (file_size + RESUME_BLOCK - 1) / RESUME_BLOCK;
+        ok = ftruncate(k->fd, 0) == 0 && pwrite(k->fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+    }
+    static const uint64_t zeros[RESUME_PAGE]; // Hashes apagados
+    for (long b = offset / RESUME_BLOCK; ok && b * RESUME_BLOCK < k->end; b += RESUME_PAGE) {
+        long n = (k->end + RESUME_BLOCK - 1) / RESUME_BLOCK - b; // Blocos restantes do intervalo
+        n = n < RESUME_PAGE ? n : RESUME_PAGE;
+        ok = pwrite(k->fd, zeros, n * sizeof(uint64_t), sizeof(ckpt_hdr) + b * sizeof(uint64_t)) == (ssize_t)(n * sizeof(uint64_t));
+    }
+    // Os hashes apagados chegam ao disco antes dos novos dados do intervalo.
+    ok = ok && fdatasync(k->fd) == 0;
+    flock(k->fd, LOCK_UN);
+    if (!ok) {
+        perror("rdt_ckpt_open: write");
+        goto fail;
+    }
+    return k;
+
+fail:
+    if (k->fd >= 0)
+        close(k->fd);
+    if (k->rfd >= 0)
+        close(k->rfd);
+    free(k->buf);
+    free(k);
+    return NULL;
+}
+
+// Sincroniza os dados dos blocos pendentes e só então grava os seus hashes: o checkpoint
+// nunca indica um bloco que uma queda do sistema possa ter perdido.
+void rdt_ckpt_flush(rdt_ckpt *k) {
+    if (k->npend == 0)
+        return;
+    size_t len = k->npend * sizeof(uint64_t);
+    if (fdatasync(k->rfd) < 0
+        || pwrite(k->fd, k->pend, len, sizeof(ckpt_hdr) + k->pend_first * sizeof(uint64_t)) != (ssize_t)len)
+        perror("rdt_ckpt: write");
+    k->pend_first += k->npend;
+    k->npend = 0;
+}
+
+void rdt_ckpt_advance(rdt_ckpt *k, long written) {
+    while (k->next < k->end) {
+        long bend = k->next + RESUME_BLOCK < k->file_size ? k->next + RESUME_BLOCK : k->file_size; // Fim do bloco
+        if (bend > written || bend > k->end) // Incompleto, ou só em parte neste intervalo
+            return;
+        uint64_t h = rdt_block_hash(k->rfd, NULL, k->next, bend - k->next, k->buf);
+        if (h == 0)
+            return;
+        k->pend[k->npend++] = h;
+        k->next = bend;
+        if (k->npend == CKPT_SYNC)
+            rdt_ckpt_flush(k);
+    }
+}
+
+void rdt_ckpt_close(rdt_ckpt *k) {
+    if (!k)
+        return;
+    rdt_ckpt_flush(k);
+    close(k->fd);
+    close(k->rfd);
+    free(k->buf);
+    free(k);
+}
+
+void rdt_ckpt_remove(const char *path) {
+    char cpath[4096]; // Caminho do checkpoint
+    ckpt_path(cpath, sizeof(cpath), path);
+    if (unlink(cpath) < 0 && errno != ENOENT)
+        perror("rdt_ckpt_remove: unlink");
+}
+
+int rdt_ckpt_lookup(rdt_ckpt *k, uint32_t block_size, uint32_t first, uint64_t *hashes, int max) {
+    if (!k || !ckpt_valid(k->fd, k->file_size, block_size))
+        return 0;
+    long nblocks = (k->file_size + block_size - 1) / block_size;
+    int n = first < nblocks ? (nblocks - first < max ? nblocks - first : max) : 0; // Hashes lidos
+    ssize_t nr = pread(k->fd, hashes, n * sizeof(uint64_t), sizeof(ckpt_hdr) + first * sizeof(uint64_t));
+    if (nr < 0)
+        nr = 0;
+    memset((char *)hashes + nr, 0, n * sizeof(uint64_t) - nr); // Fim do arquivo esparso
+    return n;
+}
+
+int rdt_resume_plan(rdt_conn *c, int fd, const char *map, long file_size, rdt_range **out) {
+    long nblocks = (file_size + RESUME_BLOCK - 1) / RESUME_BLOCK;
+    *out = malloc((nblocks / 2 + 1) * sizeof(rdt_range)); // No máximo um intervalo a cada dois blocos
+    char *buf = map ? NULL : malloc(RESUME_CHUNK);
+    if (!*out || (!map && !buf)) {
+        perror("rdt_resume_plan: malloc");
+        free(*out);
+        free(buf);
+        return ERROR;
+    }
+    int n = 0; // Intervalos
+    long kept = 0; // Blocos que não precisam ser enviados
+    uint64_t hashes[RESUME_PAGE]; // Hashes do receptor
+    for (long first = 0; first < nblocks; ) {
+        int count = rdt_resume_query(c, first, hashes);
+        if (count <= 0) { // Sem checkpoint: envia o restante
+            if (count < 0)
+                RDT_LOG(RDT_LOG_INFO, "rdt_resume_plan: Receptor não respondeu à consulta, enviando o arquivo.\n");
+            count = nblocks - first;
+            memset(hashes, 0, sizeof(hashes));
+        }
+        for (long b = first; b < first + count; b++) {
+            long off = b * RESUME_BLOCK, len = off + RESUME_BLOCK < file_size ? RESUME_BLOCK : file_size - off;
+            uint64_t h = b - first < RESUME_PAGE ? hashes[b - first] : 0; // Hash do receptor
+            if (h != 0 && h == rdt_block_hash(fd, map, off, len, buf)) {
+                kept++;
+                continue;
+            }
+            if (n > 0 && (*out)[n - 1].offset + (*out)[n - 1].length == off)
+                (*out)[n - 1].length += len;
+            else
+                (*out)[n++] = (rdt_range){off, len};
+        }
+        first += count;
+    }
+    free(buf);
+    if (nblocks == 0) // Arquivo vazio: um intervalo vazio cria o arquivo no receptor
+        (*out)[n++] = (rdt_range){0, 0};
+    RDT_LOG(RDT_LOG_INFO, "rdt_resume_plan: %ld de %ld blocos já estão no receptor; %d intervalos a enviar.\n",
+            kept, nblocks, n);
+    return n;
+}
@@ -0,0 +1,74 @@
+#ifndef RDT_RESUME_H
+#define RDT_RESUME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "rdt.h"
+
+// Retomada de transferências interrompidas.
+// O receptor mantém, ao lado de receive/<arquivo>, um checkpoint (receive/<arquivo>.rdtck) com o
+// hash de cada bloco de RESUME_BLOCK bytes já gravado em disco. Antes de enviar, o remetente
+// abre uma conexão com um PKT_START marcado com PKT_F_RESUME e um intervalo vazio, consulta nela
+// esses hashes (PKT_RESUME), compara-os com os do arquivo local e envia, cada um com o seu
+// PKT_START marcado com PKT_F_RESUME, apenas os intervalos de blocos que faltam ou que diferem.
+// Os intervalos de uma retomada não truncam o arquivo do receptor.
+
+#define RESUME_BLOCK        (1 << 20)   // Bloco do checkpoint (bytes)
+#define RESUME_CHUNK        (64 << 10)  // Trecho de leitura no cálculo do hash de um bloco
+#define RESUME_PAGE         128         // Hashes por resposta a um PKT_RESUME
+#define RESUME_SUFFIX       ".rdtck"    // Sufixo do arquivo de checkpoint
+
+// Consulta do remetente (payload de um PKT_RESUME, com seq = first), no formato da rede. O
+// arquivo é o do PKT_START da conexão.
+typedef struct __attribute__((packed)) {
+    uint32_t block_size;    // RESUME_BLOCK do remetente
+    uint32_t first;         // Primeiro bloco pedido
+} resume_query;
+
+// Resposta do receptor (payload do ACK, marcado com PKT_F_RESUME), seguida de count hashes
+// (uint64_t, ordem da rede; 0 = bloco não gravado). count = 0 se não houver checkpoint
+// compatível com o bloco pedido.
+typedef struct __attribute__((packed)) {
+    uint32_t first;
+    uint16_t count;
+} resume_reply;
+
+// Hash XXH64 (xxHash de 64 bits) de len bytes; o resultado não depende da ordem de bytes do host.
+uint64_t rdt_hash64(const void *buf, size_t len, uint64_t seed);
+
+// Hash de um bloco do checkpoint: XXH64 encadeado a cada RESUME_CHUNK bytes (a semente de
+// cada trecho é o hash do anterior), para que o receptor o calcule em trechos; nunca é 0.
+// Com map NULL, lê o intervalo [off, off + len) de fd. Retorna 0 se a leitura falhar.
+uint64_t rdt_block_hash(int fd, const char *map, long off, long len, char *buf);
+
+// Checkpoint do receptor para uma transferência do intervalo [offset, offset + length) do
+// arquivo path: zera os hashes dos blocos do intervalo, que serão regravados, e registra
+// cada bloco completo à medida que os dados chegam ao disco.
+typedef struct rdt_ckpt rdt_ckpt;
+rdt_ckpt *rdt_ckpt_open(const char *path, long file_size, long offset, long length);
+// Os bytes do arquivo anteriores a written estão gravados: calcula o hash dos blocos do
+// intervalo que terminam até lá, lendo-os de volta do arquivo.
+void rdt_ckpt_advance(rdt_ckpt *k, long written);
+// Sincroniza os dados e grava os hashes pendentes.
+void rdt_ckpt_flush(rdt_ckpt *k);
+// Grava os hashes pendentes e libera o checkpoint.
+void rdt_ckpt_close(rdt_ckpt *k);
+// Remove o checkpoint de path (o arquivo vai ser substituído por uma transferência sem retomada).
+void rdt_ckpt_remove(const char *path);
+// Lê até max hashes gravados no checkpoint a partir do bloco first. Retorna quantos (0 se o
+// bloco do checkpoint não for block_size).
+int rdt_ckpt_lookup(rdt_ckpt *k, uint32_t block_size, uint32_t first, uint64_t *hashes, int max);
+
+// Intervalo [offset, offset + length) de um arquivo.
+typedef struct {
+    long offset;
+    long length;
+} rdt_range;
+
+// Remetente: consulta o checkpoint na conexão c, aberta com PKT_F_RESUME para o arquivo, e
+// preenche *out (alocado com malloc) com os intervalos de [0, file_size) a enviar: os blocos não
+// gravados ou com hash diferente do arquivo local (fd, ou map se não for NULL). Sem resposta do
+// receptor, o arquivo inteiro. Retorna o número de intervalos ou ERROR.
+int rdt_resume_plan(rdt_conn *c, int fd, const char *map, long file_size, rdt_range **out);
+
+#endif
@@ -0,0 +1,412 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include "rdt.h"
+#include "rdt_server.h"
+#include "rdt_uring.h"
+
+#define CONN_BUCKETS     1024   // Buckets da tabela de conexões de cada thread
+#define WHEEL_SLOTS      256    // Slots da roda de temporizadores
+#define WHEEL_TICK_MS    100    // Resolução da roda de temporizadores (ms)
+#define IDLE_TIMEOUT_MS  30000  // Conexão sem tráfego é abortada após este tempo (ms)
+#define FIN_WAIT_MS      2000   // Espera pelo ACK do FIN do servidor (ms)
+#define TOMB_MS          10000  // Tempo em que uma conexão concluída ainda confirma PKT_STARTs atrasados (ms)
+#define RX_BATCH         64     // Datagramas por chamada de recv_pkts
+#define RX_BATCHES       16     // Lotes recebidos por evento antes de voltar ao epoll
+#define MAX_THREADS      64
+
+// Conexão: uma transferência em andamento, identificada pelo endereço (IP e porta) do remetente.
+// Concluída, a conexão vira uma lápide (rx == NULL) por TOMB_MS: uma cópia atrasada ou duplicada
+// do mesmo PKT_START é confirmada de novo, sem reabrir (e truncar) o arquivo já recebido.
+typedef struct conn {
+    rdt_conn rc;                // Contexto da conexão (remetente em rc.peer)
+    rdt_receiver *rx;           // Estado da transferência (NULL na lápide)
+    hseq_t start_seq;           // Número de sequência do PKT_START
+    uint32_t start_csum;        // Checksum do PKT_START, que distingue uma cópia de um novo PKT_START
+    int start_flags;            // Funcionalidades aceitas no ACK do PKT_START
+    int error;                  // Erro no lote atual: a conexão é encerrada ao fim do lote
+    struct conn *next;          // Próxima conexão no mesmo bucket
+    struct conn *t_prev;        // Lista do slot da roda de temporizadores
+    struct conn *t_next;
+    uint64_t expire;            // Tick de expiração do temporizador
+    struct conn *dirty_next;    // Lista de conexões com ACKs pendentes no lote atual
+    int dirty;
+    struct conn *delack_next;   // Lista de conexões com um ACK atrasado pendente
+    int delack;
+} conn;
+
+// Estado de uma thread do servidor.
+typedef struct {
+    int id;                     // Índice da thread
+    rdt_conn io;                // Contexto do socket da thread (porta compartilhada por SO_REUSEPORT)
+    int epfd;                   // Instância epoll
+    conn *buckets[CONN_BUCKETS]; // Tabela de conexões
+    conn *wheel[WHEEL_SLOTS];   // Roda de temporizadores: listas de conexões por tick de expiração
+    conn *delack;               // Conexões com um ACK atrasado pendente (o timer é mais curto que um tick)
+    uint64_t tick;              // Último tick processado
+    double start;               // Instante de referência dos ticks (s)
+    int nconns;                 // Conexões ativas
+} worker;
+
+// Instante atual em segundos (relógio monotônico).
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Tick atual da roda de temporizadores.
+static uint64_t current_tick(worker *w) {
+    return (uint64_t)((now_sec() - w->start) * 1000 / WHEEL_TICK_MS);
+}
+
+static unsigned conn_hash(struct sockaddr_in *addr) {
+    uint32_t h = addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port * 40503u;
+    return (h ^ (h >> 16)) % CONN_BUCKETS;
+}
+
+static conn *conn_lookup(worker *w, struct sockaddr_in *addr) {
+    for (conn *c = w->buckets[conn_hash(addr)]; c != NULL; c = c->next) {
+        if (c->rc.peer.sin_addr.s_addr == addr->sin_addr.s_addr && c->rc.peer.sin_port == addr->sin_port)
+            return c;
+    }
+    return NULL;
+}
+
+// Remove a conexão da roda de temporizadores.
+static void timer_cancel(worker *w, conn *c) {
+    if (c->t_prev)
+        c->t_prev->t_next = c->t_next;
+    else if (w->wheel[c->expire % WHEEL_SLOTS] == c)
+        w->wheel[c->expire % WHEEL_SLOTS] = c->t_next;
+    if (c->t_next)
+        c->t_next->t_prev = c->t_prev;
+    c->t_prev = c->t_next = NULL;
+}
+
+// (Re)arma o temporizador da conexão para daqui a ms milissegundos.
+static void timer_set(worker *w, conn *c, int ms) {
+    timer_cancel(w, c);
+    c->expire = current_tick(w) + (ms + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    if (c->expire <= w->tick) // O slot do tick atual já foi processado
+        c->expire = w->tick + 1;
+    conn **slot = &w->wheel[c->expire % WHEEL_SLOTS];
+    c->t_next = *slot;
+    if (*slot)
+        (*slot)->t_prev = c;
+    *slot = c;
+}
+
+// Remove a conexão (ou a lápide) da tabela e libera o estado.
+static void conn_free(worker *w, conn *c) {
+    conn **pp = &w->buckets[conn_hash(&c->rc.peer)];
+    while (*pp != c)
+        pp = &(*pp)->next;
+    *pp = c->next;
+    timer_cancel(w, c);
+    free(c);
+}
+
+// Encerra a conexão: fecha o arquivo e, se a transferência foi concluída, mantém a lápide.
+static void conn_close(worker *w, conn *c) {
+    if (c->delack) {
+        conn **dp = &w->delack;
+        while (*dp != c)
+            dp = &(*dp)->delack_next;
+        *dp = c->delack_next;
+    }
+    int state = rdt_receiver_state(c->rx);
+    c->start_flags = rdt_receiver_accepted(c->rx);
+    long totalBytes = rdt_receiver_close(c->rx);
+    w->nconns--;
+    RDT_LOG(RDT_LOG_INFO, "server[%d]: Conexão %s:%d %s. Total de bytes recebidos: %ld (%d conexões ativas)\n", w->id,
+            inet_ntoa(c->rc.peer.sin_addr), ntohs(c->rc.peer.sin_port),
+            state == RDT_RX_OPEN ? "abortada por inatividade" : "concluída", totalBytes, w->nconns);
+    if (RDT_LOG_INFO <= log_level) {
+        char prefix[64]; // Origem da linha
+        snprintf(prefix, sizeof(prefix), "server[%d]: Contadores:", w->id);
+        rdt_stats_dump(stdout, prefix, &c->rc.stats);
+    }
+    c->rx = NULL;
+    if (state == RDT_RX_OPEN || c->error) { // Abortada: um novo PKT_START abre outra transferência
+        conn_free(w, c);
+        return;
+    }
+    c->delack = FALSE;
+    timer_set(w, c, TOMB_MS);
+}
+
+// Cria uma conexão a partir de um PKT_START.
+static conn *conn_open(worker *w, struct sockaddr_in *addr, pkt *start, int len) {
+    conn *c = calloc(1, sizeof(conn));
+    if (!c) {
+        perror("server: calloc");
+        return NULL;
+    }
+    rdt_conn_init(&c->rc, w->io.sockfd, addr);
+    c->rc.uring = w->io.uring; // ACKs e escritas de todas as conexões da thread vão ao mesmo anel
+    c->rc.io_uring_enabled = (w->io.uring != NULL);
+    c->rx = rdt_receiver_open(&c->rc, start, len);
+    if (!c->rx) {
+        free(c);
+        return NULL;
+    }
+    c->start_seq = pkt_seq(start);
+    c->start_csum = start->h.csum;
+    unsigned b = conn_hash(addr);
+    c->next = w->buckets[b];
+    w->buckets[b] = c;
+    w->nconns++;
+    RDT_LOG(RDT_LOG_INFO, "server[%d]: Nova conexão de %s:%d (%d conexões ativas)\n", w->id,
+            inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), w->nconns);
+    timer_set(w, c, IDLE_TIMEOUT_MS);
+    return c;
+}
+
+// Avança a roda até o tick atual, encerrando as conexões expiradas: transferências ociosas
+// são abortadas, as que aguardam o ACK do FIN do servidor são concluídas e as lápides, liberadas.
+static void wheel_advance(worker *w) {
+    uint64_t now = current_tick(w);
+    while (w->tick < now) {
+        w->tick++;
+        conn *c = w->wheel[w->tick % WHEEL_SLOTS];
+        while (c != NULL) {
+            conn *next = c->t_next;
+            if (c->expire <= w->tick && c->rx == NULL) // Entradas de voltas futuras da roda permanecem
+                conn_free(w, c);
+            else if (c->expire <= w->tick)
+                conn_close(w, c);
+            c = next;
+        }
+    }
+}
+
+// Responde a um remetente sem conexão: às sondagens do PMTU que precedem o PKT_START e aos
+// FINs retransmitidos após o encerramento, para que o cliente possa terminar.
+static void ack_stray(worker *w, pkt *p, int len, struct sockaddr_in *addr) {
+    pkt ack;
+    if (rdt_probe_reply(w->io.sockfd, addr, p, len) == SUCCESS)
+        return;
+    if (len < (int)sizeof(hdr) || iscorrupted(p) || p->h.pkt_type != PKT_FIN)
+        return;
+    if (make_pkt(&ack, PKT_ACK, pkt_seq(p), NULL, 0) < 0)
+        return;
+    sendto(w->io.sockfd, &ack, pkt_size(&ack), 0, (struct sockaddr *)addr, sizeof(struct sockaddr_in));
+}
+
+// Processa um lote de datagramas, que pode misturar vários remetentes. Os ACKs de cada
+// conexão são enviados juntos ao fim do lote.
+static void handle_batch(worker *w, pkt **rx, int *rx_len, struct sockaddr_in *rx_src, int n) {
+    conn *dirty = NULL; // Conexões com ACKs pendentes
+    for (int i = 0; i < n; i++) {
+        conn *c = conn_lookup(w, &rx_src[i]);
+        int start = rx_len[i] >= (int)sizeof(hdr) && rx[i]->h.pkt_type == PKT_START && !iscorrupted(rx[i]);
+        if (c != NULL && c->rx == NULL) { // Lápide de uma transferência concluída
+            if (!start) {
+                ack_stray(w, rx[i], rx_len[i], &rx_src[i]);
+                continue;
+            }
+            if (pkt_seq(rx[i]) == c->start_seq && rx[i]->h.csum == c->start_csum) {
+                rdt_start_ack(&c->rc, c->start_seq, c->start_flags);
+                continue;
+            }
+            conn_free(w, c); // Novo PKT_START do mesmo endereço: nova transferência
+            c = NULL;
+        }
+        if (c == NULL) {
+            if (start)
+                conn_open(w, &rx_src[i], rx[i], rx_len[i]);
+            else
+                ack_stray(w, rx[i], rx_len[i], &rx_src[i]);
+            continue;
+        }
+        if (c->error) // Já encerrada neste lote
+            continue;
+        // Em caso de erro, a conexão pode já estar na lista do lote: é encerrada junto com as demais.
+        c->error = rdt_receiver_input(c->rx, rx[i], rx_len[i]) == ERROR;
+        if (!c->dirty) {
+            c->dirty = TRUE;
+            c->dirty_next = dirty;
+            dirty = c;
+        }
+    }
+    
+    while (dirty != NULL) {
+        conn *c = dirty;
+        dirty = c->dirty_next;
+        c->dirty = FALSE;
+        if (!c->error && rdt_receiver_flush(c->rx) < 0)
+            c->error = TRUE;
+        int state = c->error ? ERROR : rdt_receiver_state(c->rx);
+        if (state == ERROR || state == RDT_RX_DONE) {
+            conn_close(w, c);
+            continue;
+        }
+        timer_set(w, c, state == RDT_RX_FIN_WAIT ? FIN_WAIT_MS : IDLE_TIMEOUT_MS);
+        if (!c->delack && rdt_receiver_ack_delay(c->rx) >= 0) {
+            c->delack = TRUE;
+            c->delack_next = w->delack;
+            w->delack = c;
+        }
+    }
+}
+
+// Envia os ACKs atrasados vencidos e retorna o tempo (ms) até o próximo vencimento, ou -1.
+static int delack_run(worker *w) {
+    int next_ms = -1; // Próximo vencimento
+    conn **dp = &w->delack;
+    while (*dp != NULL) {
+        conn *c = *dp;
+        if (rdt_receiver_ack_delay(c->rx) == 0 && rdt_receiver_flush(c->rx) < 0) {
+            c->error = TRUE;
+            conn_close(w, c); // Remove c da lista
+            continue;
+        }
+        double delay = rdt_receiver_ack_delay(c->rx); // Tempo até o vencimento (-1 = ACK enviado)
+        if (delay < 0) {
+            c->delack = FALSE;
+            *dp = c->delack_next;
+            continue;
+        }
+        int ms = (int)(delay * 1000) + 1;
+        if (next_ms < 0 || ms < next_ms)
+            next_ms = ms;
+        dp = &c->delack_next;
+    }
+    return next_ms;
+}
+
+// Laço de eventos de uma thread.
+static void *worker_main(void *arg) {
+    worker *w = arg;
+    // Com payloads grandes o lote passa de meio megabyte: fica no heap, e não na pilha da thread.
+    pkt *rx = malloc(RX_BATCH * sizeof(pkt)); // Pacotes do lote
+    pkt *rxp[RX_BATCH]; // Pacotes do lote (em rx ou nos buffers do anel)
+    int rx_len[RX_BATCH]; // Tamanho de cada datagrama
+    struct sockaddr_in rx_src[RX_BATCH]; // Origem de cada datagrama
+    if (!rx) {
+        perror("server: malloc");
+        return NULL;
+    }
+    for (int i = 0; i < RX_BATCH; i++)
+        rxp[i] = &rx[i];
+    
+    while (1) {
+        // Dorme até o próximo tick da roda, o próximo ACK atrasado ou até chegar um datagrama.
+        double next_tick = w->start + (w->tick + 1) * WHEEL_TICK_MS / 1000.0;
+        int wait_ms = (int)((next_tick - now_sec()) * 1000) + 1;
+        int delack_ms = delack_run(w);
+        if (delack_ms >= 0 && delack_ms < wait_ms)
+            wait_ms = delack_ms;
+        if (w->io.uring) {
+            // io_uring: o anel entrega os datagramas, envia os ACKs e grava os arquivos; a
+            // espera termina no próximo tick da roda por uma operação de timeout.
+            int n = rdt_uring_recv(w->io.uring, rxp, rx_len, rx_src, RX_BATCH, wait_ms > 0 ? wait_ms / 1000.0 : 0);
+            if (n < 0)
+                break;
+            if (n > 0)
+                handle_batch(w, rxp, rx_len, rx_src, n);
+            wheel_advance(w);
+            continue;
+        }
+        struct epoll_event ev;
+        int nev = epoll_wait(w->epfd, &ev, 1, wait_ms > 0 ? wait_ms : 0);
+        if (nev < 0 && errno != EINTR) {
+            perror("server: epoll_wait");
+            break;
+        }
+        for (int b = 0; nev > 0 && b < RX_BATCHES; b++) {
+            int n = recv_pkts(&w->io, rx, rx_len, rx_src, RX_BATCH); // Socket não bloqueante
+            if (n <= 0)
+                break;
+            handle_batch(w, rxp, rx_len, rx_src, n);
+        }
+        wheel_advance(w);
+    }
+    free(rx);
+    return NULL;
+}
+
+// Cria o socket de uma thread, não bloqueante e associado à porta compartilhada.
+static int open_socket(worker *w, int port) {
+    int one = 1;
+    int sockfd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    if (sockfd < 0) {
+        perror("server: socket");
+        return ERROR;
+    }
+    if (setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("server: setsockopt(SO_REUSEPORT)");
+        close(sockfd);
+        return ERROR;
+    }
+    struct sockaddr_in addr; // Endereço do servidor
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY; // Aceita conexões de qualquer endereço
+    if (bind(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("server: bind");
+        close(sockfd);
+        return ERROR;
+    }
+    rdt_conn_init(&w->io, sockfd, NULL);
+    if (w->io.io_uring_enabled) {
+        w->io.uring = rdt_uring_open(sockfd);
+        if (!w->io.uring) {
+            RDT_LOG(RDT_LOG_INFO, "server: io_uring indisponível, usando epoll.\n");
+            w->io.io_uring_enabled = FALSE;
+        }
+    }
+    if (!w->io.uring) // O anel recebe datagramas de até um pkt, sem coalescência
+        enable_udp_gro(&w->io);
+    return sockfd;
+}
+
+// Executa o servidor: o kernel distribui os remetentes entre os sockets das threads pelo
+// hash do endereço de origem, de modo que cada conexão é tratada sempre pela mesma thread
+// e as tabelas de conexões não precisam de travas.
+int rdt_server_run(int port, int nthreads) {
+    if (nthreads < 1)
+        nthreads = 1;
+    if (nthreads > MAX_THREADS)
+        nthreads = MAX_THREADS;
+    worker *workers = calloc(nthreads, sizeof(worker));
+    pthread_t threads[MAX_THREADS];
+    if (!workers) {
+        perror("server: calloc");
+        return ERROR;
+    }
+    for (int i = 0; i < nthreads; i++) {
+        worker *w = &workers[i];
+        w->id = i;
+        w->start = now_sec();
+        if (open_socket(w, port) < 0)
+            return ERROR;
+        w->epfd = epoll_create1(0);
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = w};
+        if (w->epfd < 0 || epoll_ctl(w->epfd, EPOLL_CTL_ADD, w->io.sockfd, &ev) < 0) {
+            perror("server: epoll");
+            return ERROR;
+        }
+    }
+    RDT_LOG(RDT_LOG_INFO, "server: Escutando na porta %d com %d threads.\n", port, nthreads);
+    fflush(stdout);
+    for (int i = 1; i < nthreads; i++) {
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "server: pthread_create falhou.\n");
+            return ERROR;
+        }
+    }
+    worker_main(&workers[0]); // A thread principal atende o primeiro socket
+    return ERROR;
+}
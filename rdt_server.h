@@ -0,0 +1,11 @@
+#ifndef RDT_SERVER_H
+#define RDT_SERVER_H
+
+// Servidor multi-cliente: recebe arquivos de vários remetentes ao mesmo tempo na mesma porta UDP.
+// Cada thread tem um socket próprio (SO_REUSEPORT), um laço de eventos epoll, uma tabela de
+// conexões indexada pelo endereço de origem e uma roda de temporizadores para timeouts.
+
+// Executa o servidor na porta indicada com nthreads threads. Só retorna em caso de erro.
+int rdt_server_run(int port, int nthreads);
+
+#endif
@@ -0,0 +1,448 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include "rdt.h"
+#include "rdt_uring.h"
+
+// Sem liburing: o anel é criado e mapeado diretamente com as chamadas de sistema.
+
+#define RING_ENTRIES  256   // Entradas da fila de submissão
+#define CQ_ENTRIES    1024  // Entradas da fila de conclusão
+#define RECV_BUFS     256   // Buffers fornecidos ao recvmsg multishot (potência de 2)
+#define RECV_BGID     0     // Grupo dos buffers fornecidos
+#define SEND_SLOTS    RING_ENTRIES // Envios em andamento
+// Layout de cada buffer de recepção: io_uring_recvmsg_out, endereço de origem e datagrama.
+#define RECV_NAME_OFF sizeof(struct io_uring_recvmsg_out)
+#define RECV_PKT_OFF  (RECV_NAME_OFF + sizeof(struct sockaddr_in))
+#define RECV_BUF_SIZE (RECV_PKT_OFF + sizeof(pkt))
+
+// Tipo da operação nos bits altos de user_data; os bits baixos identificam a operação.
+#define OP_RECV    1ull
+#define OP_SEND    2ull
+#define OP_WRITE   3ull
+#define OP_TIMEOUT 4ull
+#define OP_CANCEL  5ull
+#define OP_SHIFT   56
+#define USER_DATA(op, v) (((op) << OP_SHIFT) | (uint64_t)(v))
+
+// Envio em andamento: a mensagem precisa existir até o kernel consumi-la.
+typedef struct {
+    struct msghdr msg;
+    struct iovec iov[2];        // Header e payload
+    struct sockaddr_in dst;     // Destino
+    pkt copy;                   // Cópia do datagrama (envios com copy = 1)
+    int busy;                   // Aguardando conclusão
+} send_slot;
+
+struct rdt_uring {
+    int fd;                     // Descritor do anel
+    int sockfd;                 // Socket da conexão
+    // Fila de submissão
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned sq_entries;
+    unsigned sq_local_tail;     // Próxima entrada a preencher
+    unsigned sq_submitted;      // Entradas já entregues ao kernel
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    // Fila de conclusão
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+    // Buffers fornecidos ao recvmsg multishot
+    struct io_uring_buf_ring *br;
+    size_t br_size;
+    char *bufs;
+    unsigned short br_tail;
+    struct msghdr rmsg;         // Modelo do recvmsg: só o espaço do endereço de origem
+    int recv_armed;             // recvmsg multishot ativo
+    int ready_bid[RECV_BUFS];   // Buffers com datagramas ainda não entregues
+    unsigned ready_head, ready_count;
+    int lent[RECV_BUFS];        // Buffers entregues na última rdt_uring_recv
+    int nlent;
+    // Envios e escritas
+    send_slot *slots;
+    unsigned next_slot;
+    int sends_pending;
+    int writes_pending;
+    // Timeout da espera
+    struct __kernel_timespec ts;
+    unsigned timeout_gen;       // Identifica o timeout atual
+    int timed_out;
+    int write_done;             // Uma escrita terminou durante a espera
+    int error;                  // Uma operação falhou
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Entrega ao kernel as entradas preenchidas e, se min_complete > 0, espera por conclusões.
+static int uring_enter(rdt_uring *u, unsigned min_complete) {
+    __atomic_store_n(u->sq_tail, u->sq_local_tail, __ATOMIC_RELEASE);
+    unsigned to_submit = u->sq_local_tail - u->sq_submitted;
+    int rv = syscall(__NR_io_uring_enter, u->fd, to_submit, min_complete,
+                     min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (rv < 0) {
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) // Tenta de novo após consumir conclusões
+            return SUCCESS;
+        perror("rdt_uring: io_uring_enter");
+        return ERROR;
+    }
+    u->sq_submitted += rv;
+    return SUCCESS;
+}
+
+// Próxima entrada livre da fila de submissão (submete as pendentes se estiver cheia).
+static struct io_uring_sqe *uring_sqe(rdt_uring *u) {
+    if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+        if (uring_enter(u, 0) < 0)
+            return NULL;
+        if (u->sq_local_tail - __atomic_load_n(u->sq_head, __ATOMIC_ACQUIRE) >= u->sq_entries) {
+            fprintf(stderr, "rdt_uring: fila de submissão cheia.\n");
+            return NULL;
+        }
+    }
+    unsigned idx = u->sq_local_tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    u->sq_array[idx] = idx;
+    u->sq_local_tail++;
+    return sqe;
+}
+
+// Devolve um buffer ao kernel.
+static void uring_recycle(rdt_uring *u, int bid) {
+    struct io_uring_buf *b = &u->br->bufs[u->br_tail & (RECV_BUFS - 1)];
+    b->addr = (uint64_t)(uintptr_t)(u->bufs + (size_t)bid * RECV_BUF_SIZE);
+    b->len = RECV_BUF_SIZE;
+    b->bid = bid;
+    u->br_tail++;
+    __atomic_store_n(&u->br->tail, u->br_tail, __ATOMIC_RELEASE);
+}
+
+// Arma o recvmsg multishot: cada datagrama gera uma conclusão em um buffer do grupo RECV_BGID,
+// até os buffers acabarem (então é armado de novo na próxima espera).
+static int uring_arm_recv(rdt_uring *u) {
+    struct io_uring_sqe *sqe = uring_sqe(u);
+    if (!sqe)
+        return ERROR;
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = u->sockfd;
+    sqe->addr = (uint64_t)(uintptr_t)&u->rmsg;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BGID;
+    sqe->user_data = USER_DATA(OP_RECV, 0);
+    u->recv_armed = TRUE;
+    return SUCCESS;
+}
+
+// Consome as conclusões disponíveis, sem chamada de sistema.
+static void uring_reap(rdt_uring *u) {
+    unsigned head = *u->cq_head;
+    unsigned tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++) {
+        struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        unsigned op = cqe->user_data >> OP_SHIFT; // Tipo da operação
+        unsigned v = cqe->user_data & ((1ull << OP_SHIFT) - 1); // Identificador
+        switch (op) {
+        case OP_RECV:
+            if (!(cqe->flags & IORING_CQE_F_MORE)) // O multishot terminou (por exemplo, sem buffers)
+                u->recv_armed = FALSE;
+            if (cqe->res >= 0 && (cqe->flags & IORING_CQE_F_BUFFER)) {
+                unsigned slot = (u->ready_head + u->ready_count++) % RECV_BUFS;
+                u->ready_bid[slot] = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            } else if (cqe->res < 0 && cqe->res != -ENOBUFS && cqe->res != -ECANCELED) {
+                fprintf(stderr, "rdt_uring: recvmsg: %s\n", strerror(-cqe->res));
+                u->error = TRUE;
+            }
+            break;
+        case OP_SEND:
+            u->slots[v].busy = FALSE;
+            u->sends_pending--;
+            // Um datagrama que não pôde ser enviado (fila cheia, ou cancelado porque o anterior
+            // da cadeia falhou) é tratado como perdido na rede: o protocolo o retransmite.
+            if (cqe->res < 0 && cqe->res != -EAGAIN && cqe->res != -ENOBUFS && cqe->res != -ECANCELED)
+                fprintf(stderr, "rdt_uring: sendmsg: %s\n", strerror(-cqe->res));
+            break;
+        case OP_WRITE:
+            u->writes_pending--;
+            u->write_done = TRUE;
+            if (cqe->res != (int)v) { // Escrita com erro ou incompleta
+                fprintf(stderr, "rdt_uring: write: %s\n", cqe->res < 0 ? strerror(-cqe->res) : "escrita incompleta");
+                u->error = TRUE;
+            }
+            break;
+        case OP_TIMEOUT:
+            if (v == u->timeout_gen && cqe->res == -ETIME)
+                u->timed_out = TRUE;
+            break;
+        }
+    }
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+}
+
+rdt_uring *rdt_uring_open(int sockfd) {
+    rdt_uring *u = calloc(1, sizeof(rdt_uring));
+    if (!u) {
+        perror("rdt_uring: calloc");
+        return NULL;
+    }
+    u->sockfd = sockfd;
+    u->sq_ring = u->cq_ring = u->sqes = MAP_FAILED;
+    u->br = MAP_FAILED;
+
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = CQ_ENTRIES;
+    u->fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &p);
+    if (u->fd < 0) {
+        RDT_LOG(RDT_LOG_INFO, "rdt_uring: io_uring indisponível (%s).\n", strerror(errno));
+        free(u);
+        return NULL;
+    }
+
+    // Mapeia as filas de submissão e de conclusão (uma única região, se o kernel permitir).
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_ring_size > u->sq_ring_size)
+            u->sq_ring_size = u->cq_ring_size;
+        u->cq_ring_size = 0;
+    }
+    u->sq_ring = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED)
+        goto fail;
+    if (u->cq_ring_size > 0) {
+        u->cq_ring = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED)
+            goto fail;
+    }
+    char *cq = u->cq_ring_size > 0 ? u->cq_ring : u->sq_ring;
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED)
+        goto fail;
+    u->sq_head = (unsigned *)((char *)u->sq_ring + p.sq_off.head);
+    u->sq_tail = (unsigned *)((char *)u->sq_ring + p.sq_off.tail);
+    u->sq_mask = (unsigned *)((char *)u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((char *)u->sq_ring + p.sq_off.array);
+    u->sq_entries = p.sq_entries;
+    u->sq_local_tail = u->sq_submitted = *u->sq_tail;
+    u->cq_head = (unsigned *)(cq + p.cq_off.head);
+    u->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    u->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+    // Registra os buffers de recepção (buffer ring).
+    u->br_size = RECV_BUFS * sizeof(struct io_uring_buf);
+    u->br = mmap(NULL, u->br_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    u->bufs = malloc((size_t)RECV_BUFS * RECV_BUF_SIZE);
+    u->slots = calloc(SEND_SLOTS, sizeof(send_slot));
+    if (u->br == MAP_FAILED || !u->bufs || !u->slots)
+        goto fail;
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)u->br;
+    reg.ring_entries = RECV_BUFS;
+    reg.bgid = RECV_BGID;
+    if (syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        RDT_LOG(RDT_LOG_INFO, "rdt_uring: buffer ring indisponível (%s).\n", strerror(errno));
+        goto fail_quiet;
+    }
+    for (int bid = 0; bid < RECV_BUFS; bid++)
+        uring_recycle(u, bid);
+    u->rmsg.msg_namelen = sizeof(struct sockaddr_in);
+    return u;
+
+fail:
+    perror("rdt_uring: mmap");
+fail_quiet:
+    rdt_uring_close(u);
+    return NULL;
+}
+
+// Cancela o recvmsg multishot e espera o fim das operações antes de liberar os buffers; o
+// socket volta a ser lido normalmente.
+void rdt_uring_close(rdt_uring *u) {
+    if (!u)
+        return;
+    if (u->sq_ring != MAP_FAILED && u->sqes != MAP_FAILED) {
+        rdt_uring_drain(u);
+        if (u->recv_armed) {
+            struct io_uring_sqe *sqe = uring_sqe(u);
+            if (sqe) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->addr = USER_DATA(OP_RECV, 0);
+                sqe->user_data = USER_DATA(OP_CANCEL, 0);
+                while (u->recv_armed && uring_enter(u, 1) == SUCCESS)
+                    uring_reap(u);
+            }
+        }
+    }
+    if (u->sqes != MAP_FAILED)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != MAP_FAILED)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring != MAP_FAILED)
+        munmap(u->sq_ring, u->sq_ring_size);
+    close(u->fd);
+    if (u->br != MAP_FAILED)
+        munmap(u->br, u->br_size);
+    free(u->bufs);
+    free(u->slots);
+    free(u);
+}
+
+// Os datagramas da rajada formam uma cadeia (IOSQE_IO_LINK): o kernel os envia em ordem,
+// e uma única io_uring_enter submete a rajada inteira.
+int rdt_uring_send(rdt_uring *u, struct sockaddr_in *dst, struct iovec *iov, int n, int copy) {
+    for (int i = 0; i < n; i++) {
+        unsigned idx = u->next_slot % SEND_SLOTS; // Slot do envio
+        send_slot *sl = &u->slots[idx];
+        while (sl->busy) { // Todos os slots em uso: espera o envio mais antigo
+            uring_reap(u);
+            if (sl->busy && uring_enter(u, 1) < 0)
+                return ERROR;
+        }
+        struct io_uring_sqe *sqe = uring_sqe(u);
+        if (!sqe)
+            return ERROR;
+        sl->dst = *dst;
+        memset(&sl->msg, 0, sizeof(sl->msg));
+        sl->msg.msg_name = &sl->dst;
+        sl->msg.msg_namelen = sizeof(struct sockaddr_in);
+        sl->msg.msg_iov = sl->iov;
+        if (copy) {
+            memcpy(&sl->copy, iov[2 * i].iov_base, iov[2 * i].iov_len);
+            memcpy((char *)&sl->copy + iov[2 * i].iov_len, iov[2 * i + 1].iov_base, iov[2 * i + 1].iov_len);
+            sl->iov[0].iov_base = &sl->copy;
+            sl->iov[0].iov_len = iov[2 * i].iov_len + iov[2 * i + 1].iov_len;
+            sl->msg.msg_iovlen = 1;
+        } else {
+            sl->iov[0] = iov[2 * i];
+            sl->iov[1] = iov[2 * i + 1];
+            sl->msg.msg_iovlen = 2;
+        }
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = u->sockfd;
+        sqe->addr = (uint64_t)(uintptr_t)&sl->msg;
+        sqe->len = 1;
+        if (i < n - 1)
+            sqe->flags = IOSQE_IO_LINK;
+        sqe->user_data = USER_DATA(OP_SEND, idx);
+        sl->busy = TRUE;
+        u->sends_pending++;
+        u->next_slot++;
+    }
+    return n;
+}
+
+int rdt_uring_write(rdt_uring *u, int fd, const void *buf, unsigned len, long off) {
+    struct io_uring_sqe *sqe = uring_sqe(u);
+    if (!sqe)
+        return ERROR;
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = USER_DATA(OP_WRITE, len);
+    u->writes_pending++;
+    return SUCCESS;
+}
+
+int rdt_uring_submit(rdt_uring *u) {
+    if (u->sq_local_tail == u->sq_submitted)
+        return SUCCESS;
+    return uring_enter(u, 0);
+}
+
+int rdt_uring_drain(rdt_uring *u) {
+    uring_reap(u);
+    while (u->sends_pending > 0 || u->writes_pending > 0) {
+        if (uring_enter(u, 1) < 0)
+            return ERROR;
+        uring_reap(u);
+    }
+    return u->error ? ERROR : SUCCESS;
+}
+
+int rdt_uring_writing(rdt_uring *u) {
+    uring_reap(u);
+    return u->writes_pending > 0;
+}
+
+// Sem datagramas prontos, uma única io_uring_enter submete os envios pendentes, um timeout
+// (IORING_OP_TIMEOUT, que também termina na primeira conclusão de outra operação) e espera.
+// O fim de uma escrita também encerra a espera: o receptor pode então gravar o próximo buffer.
+int rdt_uring_recv(rdt_uring *u, pkt **pkts, int *lens, struct sockaddr_in *srcs, int max, double timeout) {
+    for (int i = 0; i < u->nlent; i++) // Os buffers da chamada anterior voltam ao kernel
+        uring_recycle(u, u->lent[i]);
+    u->nlent = 0;
+
+    double deadline = now_sec() + timeout; // Fim da espera
+    uring_reap(u);
+    u->write_done = FALSE;
+    while (u->ready_count == 0) {
+        if (u->error)
+            return ERROR;
+        if (!u->recv_armed && uring_arm_recv(u) < 0)
+            return ERROR;
+        if (timeout >= 0) {
+            double left = deadline - now_sec(); // Tempo restante
+            if (left <= 0) // Prazo vencido: só entrega os envios pendentes
+                return rdt_uring_submit(u) < 0 ? ERROR : 0;
+            struct io_uring_sqe *sqe = uring_sqe(u);
+            if (!sqe)
+                return ERROR;
+            u->ts.tv_sec = (long)left;
+            u->ts.tv_nsec = (long)((left - (long)left) * 1e9);
+            sqe->opcode = IORING_OP_TIMEOUT;
+            sqe->addr = (uint64_t)(uintptr_t)&u->ts;
+            sqe->len = 1;
+            sqe->off = 1; // Termina antes se outra operação concluir
+            sqe->user_data = USER_DATA(OP_TIMEOUT, ++u->timeout_gen);
+            u->timed_out = FALSE;
+        }
+        if (uring_enter(u, 1) < 0)
+            return ERROR;
+        uring_reap(u);
+        if ((u->timed_out || u->write_done) && u->ready_count == 0)
+            return 0;
+    }
+    if (u->error)
+        return ERROR;
+
+    int n = 0; // Datagramas entregues
+    while (n < max && u->ready_count > 0) {
+        int bid = u->ready_bid[u->ready_head]; // Buffer do datagrama
+        char *buf = u->bufs + (size_t)bid * RECV_BUF_SIZE;
+        struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)buf;
+        u->ready_head = (u->ready_head + 1) % RECV_BUFS;
+        u->ready_count--;
+        pkts[n] = (pkt *)(buf + RECV_PKT_OFF);
+        lens[n] = out->payloadlen < sizeof(pkt) ? (int)out->payloadlen : (int)sizeof(pkt); // Datagrama maior que um pkt é truncado
+        if (srcs)
+            memcpy(&srcs[n], buf + RECV_NAME_OFF, sizeof(struct sockaddr_in));
+        u->lent[u->nlent++] = bid;
+        n++;
+    }
+    return n;
+}
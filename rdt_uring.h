@@ -0,0 +1,45 @@
+#ifndef RDT_URING_H
+#define RDT_URING_H
+
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include "rdt.h"
+
+// Motor de eventos io_uring (Linux) para o socket e o arquivo de uma conexão.
+// O anel recebe os datagramas com um recvmsg multishot em buffers fornecidos ao kernel
+// (buffer ring), envia cada rajada como uma cadeia de sendmsg ligados, grava o arquivo com
+// operações de escrita no mesmo anel e espera com operações de timeout no lugar do select.
+// As conclusões são lidas da memória compartilhada com o kernel: uma espera colhe de uma vez
+// todos os datagramas, envios e escritas concluídos, sem uma chamada por evento.
+
+typedef struct rdt_uring rdt_uring;
+
+// Cria o anel para o socket sockfd. Retorna NULL se o kernel não suportar io_uring.
+rdt_uring *rdt_uring_open(int sockfd);
+void rdt_uring_close(rdt_uring *u);
+
+// Enfileira n datagramas para dst, cada um descrito por dois iovecs (header e payload) em iov.
+// Os envios são submetidos na próxima espera (ou em rdt_uring_submit). Se copy for 1, os
+// dados são copiados para o anel; caso contrário, devem permanecer válidos até a conclusão.
+int rdt_uring_send(rdt_uring *u, struct sockaddr_in *dst, struct iovec *iov, int n, int copy);
+
+// Enfileira a escrita de len bytes de buf na posição off de fd. buf deve permanecer válido
+// até rdt_uring_drain.
+int rdt_uring_write(rdt_uring *u, int fd, const void *buf, unsigned len, long off);
+
+// Submete as operações enfileiradas sem esperar.
+int rdt_uring_submit(rdt_uring *u);
+
+// Aguarda a conclusão de todos os envios e escritas submetidos.
+int rdt_uring_drain(rdt_uring *u);
+
+// Informa se alguma escrita submetida ainda não terminou, sem esperar.
+int rdt_uring_writing(rdt_uring *u);
+
+// Recebe até max datagramas, esperando até timeout segundos (negativo = sem limite).
+// pkts[i] aponta para o buffer do anel e vale até a próxima chamada; lens[i] recebe o tamanho
+// e srcs[i] (se srcs não for NULL) a origem. Retorna o número de datagramas, 0 no timeout (ou
+// quando uma escrita termina sem que haja datagramas) ou ERROR.
+int rdt_uring_recv(rdt_uring *u, pkt **pkts, int *lens, struct sockaddr_in *srcs, int max, double timeout);
+
+#endif